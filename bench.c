@@ -0,0 +1,1427 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+    #include <sys/prctl.h>
+#endif /* defined(__linux__) */
+
+#include "dedup_sink.h"
+#include "example.h"
+#include "fd_sink.h"
+#include "lz4_sink.h"
+#include "parse_printf.h"
+#include "parse_scanf.h"
+#include "pingpong_sink.h"
+
+// Compare the parsed and compiled formats explicitly, below.
+#define PRINTF_COMPILED_NO_ROUTING
+#include "printf_compiled.h"
+#include "printf_string.h"
+#include "printf_table.h"
+#include "printf_token.h"
+#include "ring_sink.h"
+#include "tee_sink.h"
+
+#define BENCH_ITERATIONS 2000000
+
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void
+print_result(const char *const name,
+             const uint64_t elapsed_ns,
+             const uint64_t iterations)
+{
+    printf("%-40s %8.2f ns/op\n",
+           name,
+           (double)elapsed_ns / (double)iterations);
+}
+
+// Keep the compiler from optimizing away the formatted output.
+static volatile char bench_sink;
+
+static void bench_integers(void) {
+    char buffer[128];
+    uint64_t value = 0x9E3779B97F4A7C15ull;
+
+    uint64_t start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        value ^= value << 13;
+        value ^= value >> 7;
+        value ^= value << 17;
+
+        format_to_buffer(buffer,
+                         sizeof(buffer),
+                         "%llu %lld %u",
+                         (unsigned long long)value,
+                         (long long)value,
+                         (unsigned)value);
+        bench_sink = buffer[0];
+    }
+
+    print_result("format_to_buffer %llu %lld %u",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+
+    start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        value ^= value << 13;
+        value ^= value >> 7;
+        value ^= value << 17;
+
+        snprintf(buffer,
+                 sizeof(buffer),
+                 "%llu %lld %u",
+                 (unsigned long long)value,
+                 (long long)value,
+                 (unsigned)value);
+        bench_sink = buffer[0];
+    }
+
+    print_result("snprintf %llu %lld %u",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+
+    start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        value ^= value << 13;
+        value ^= value >> 7;
+        value ^= value << 17;
+
+        format_to_buffer(buffer,
+                         sizeof(buffer),
+                         "%llx %llo %llX",
+                         (unsigned long long)value,
+                         (unsigned long long)value,
+                         (unsigned long long)value);
+        bench_sink = buffer[0];
+    }
+
+    print_result("format_to_buffer %llx %llo %llX",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+
+    start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        value ^= value << 13;
+        value ^= value >> 7;
+        value ^= value << 17;
+
+        format_to_buffer(buffer,
+                         sizeof(buffer),
+                         "%#010x %-+8.4d %05u",
+                         (unsigned)value,
+                         (int)(value >> 48),
+                         (unsigned)(value >> 52));
+        bench_sink = buffer[0];
+    }
+
+    print_result("format_to_buffer %#010x %-+8.4d %05u",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+}
+
+static void bench_positional(void) {
+    char buffer[128];
+    const char *const format = "%3$s: %1$d of %2$d";
+
+    uint64_t start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        format_to_buffer(buffer, sizeof(buffer), format, i, 100, "item");
+        bench_sink = buffer[0];
+    }
+
+    print_result("format_to_buffer positional",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+
+    struct printf_arg_table table;
+    printf_arg_table_init(&table, format);
+
+    start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        format_to_buffer_with_arg_table(buffer,
+                                        sizeof(buffer),
+                                        &table,
+                                        format,
+                                        i,
+                                        100,
+                                        "item");
+        bench_sink = buffer[0];
+    }
+
+    print_result("format_to_buffer positional (cached)",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+
+    start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        format_to_buffer(buffer,
+                         sizeof(buffer),
+                         "%s: %d of %d",
+                         "item",
+                         i,
+                         100);
+        bench_sink = buffer[0];
+    }
+
+    print_result("format_to_buffer sequential",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+}
+
+static void bench_timestamps(void) {
+    char buffer[128];
+    const uint64_t base_ns = 1700000000000000000ull;
+
+    uint64_t start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        // Advance ~10us per line, like a busy logger.
+        const uint64_t now_ns = base_ns + (uint64_t)i * 10000;
+        const time_t seconds = (time_t)(now_ns / 1000000000ull);
+
+        struct tm tm;
+        gmtime_r(&seconds, &tm);
+
+        char date[32];
+        strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &tm);
+
+        format_to_buffer(buffer,
+                         sizeof(buffer),
+                         "%s.%06uZ msg",
+                         date,
+                         (unsigned)(now_ns % 1000000000ull) / 1000);
+        bench_sink = buffer[0];
+    }
+
+    print_result("gmtime_r + strftime + format_to_buffer",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat"
+#pragma GCC diagnostic ignored "-Wformat-extra-args"
+    start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        const uint64_t now_ns = base_ns + (uint64_t)i * 10000;
+
+        format_to_buffer(buffer, sizeof(buffer), "%.6T msg", (int64_t)now_ns);
+        bench_sink = buffer[0];
+    }
+#pragma GCC diagnostic pop
+
+    print_result("format_to_buffer %.6T",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+}
+
+#define BENCH_LOG_FORMAT "INFO request id=%u path=%s took=%uus\n"
+
+static void
+bench_fd_sink_policy(const char *const name,
+                     const int fd,
+                     const enum fd_sink_flush_policy policy)
+{
+    char sink_buffer[4096];
+    struct fd_sink sink;
+
+    fd_sink_init(&sink, fd, sink_buffer, sizeof(sink_buffer), policy);
+
+    const uint64_t start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        fd_sink_format(&sink, BENCH_LOG_FORMAT, i, "/api/v1/items", i % 977);
+    }
+
+    fd_sink_flush(&sink);
+    print_result(name, get_time_ns() - start, BENCH_ITERATIONS);
+
+    printf("%-40s %8.4f syscalls/line\n",
+           "",
+           (double)sink.syscall_count / BENCH_ITERATIONS);
+}
+
+static void
+bench_fprintf(const char *const name, const int fd, const int mode) {
+    FILE *const file = fdopen(dup(fd), "w");
+    if (file == NULL) {
+        return;
+    }
+
+    setvbuf(file, NULL, mode, BUFSIZ);
+
+    const uint64_t start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        fprintf(file, BENCH_LOG_FORMAT, i, "/api/v1/items", i % 977);
+    }
+
+    fflush(file);
+    print_result(name, get_time_ns() - start, BENCH_ITERATIONS);
+
+    fclose(file);
+}
+
+static void bench_fd_sink(void) {
+    const int fd = open("/dev/null", O_WRONLY);
+    if (fd < 0) {
+        return;
+    }
+
+    bench_fd_sink_policy("fd_sink (flush on newline)",
+                         fd,
+                         FD_SINK_FLUSH_ON_NEWLINE);
+    bench_fd_sink_policy("fd_sink (flush on full)", fd, FD_SINK_FLUSH_ON_FULL);
+
+    bench_fprintf("fprintf (fully buffered)", fd, _IOFBF);
+    bench_fprintf("fprintf (line buffered)", fd, _IOLBF);
+
+    close(fd);
+}
+
+static uint32_t
+discard_ch_callback(struct printf_spec_info *const spec_info,
+                    void *const info,
+                    const char ch,
+                    const uint32_t times,
+                    bool *const should_continue_out)
+{
+    (void)spec_info;
+    (void)info;
+    (void)ch;
+    (void)should_continue_out;
+
+    return times;
+}
+
+static uint32_t
+discard_string_callback(struct printf_spec_info *const spec_info,
+                        void *const info,
+                        const char *const string,
+                        const uint32_t length,
+                        bool *const should_continue_out)
+{
+    (void)spec_info;
+    (void)info;
+    (void)string;
+    (void)should_continue_out;
+
+    return length;
+}
+
+static void bench_lz4_sink(void) {
+    static struct lz4_sink sink;
+    lz4_sink_init(&sink, discard_string_callback, NULL);
+
+    static const char *const paths[] = {
+        "/api/v1/items",
+        "/api/v1/users/profile",
+        "/health",
+        "/static/app.js"
+    };
+
+    const uint64_t base_ns = 1700000000000000000ull;
+    const uint64_t start = get_time_ns();
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat"
+#pragma GCC diagnostic ignored "-Wformat-extra-args"
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        lz4_sink_format(&sink,
+                        "%.6T INFO request id=%u path=%s status=%d took=%uus\n",
+                        (int64_t)(base_ns + (uint64_t)i * 10000),
+                        i,
+                        paths[i % 4],
+                        (i % 50) == 0 ? 500 : 200,
+                        (i * 7919) % 10007);
+    }
+#pragma GCC diagnostic pop
+
+    lz4_sink_flush(&sink);
+
+    const uint64_t elapsed_ns = get_time_ns() - start;
+    print_result("lz4_sink log lines", elapsed_ns, BENCH_ITERATIONS);
+
+    printf("%-40s %8.2f MB/s formatted, ratio %.2fx\n",
+           "",
+           (double)sink.bytes_in * 1000.0 / (double)elapsed_ns,
+           (double)sink.bytes_in / (double)sink.bytes_out);
+}
+
+#define TEE_DESTINATIONS 3
+
+__attribute__((format(printf, 1, 2)))
+static uint32_t discard_format(const char *const format, ...) {
+    va_list list;
+    va_start(list, format);
+
+    const uint32_t result =
+        parse_printf_format(discard_ch_callback,
+                            NULL,
+                            discard_string_callback,
+                            NULL,
+                            format,
+                            list);
+
+    va_end(list);
+    return result;
+}
+
+static void bench_tee_sink(void) {
+    uint64_t start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        for (uint32_t j = 0; j != TEE_DESTINATIONS; j++) {
+            discard_format("id=%u temp=%d name=%s ratio=%08x\n",
+                           i,
+                           (int)(i % 200) - 100,
+                           "sensor",
+                           i * 7919);
+        }
+    }
+
+    print_result("format once per destination (x3)",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+
+    struct tee_sink sink;
+    tee_sink_init(&sink);
+
+    for (uint32_t j = 0; j != TEE_DESTINATIONS; j++) {
+        tee_sink_add(&sink,
+                     discard_ch_callback,
+                     NULL,
+                     discard_string_callback,
+                     NULL);
+    }
+
+    start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        tee_sink_format(&sink,
+                        "id=%u temp=%d name=%s ratio=%08x\n",
+                        i,
+                        (int)(i % 200) - 100,
+                        "sensor",
+                        i * 7919);
+    }
+
+    print_result("tee_sink (x3)", get_time_ns() - start, BENCH_ITERATIONS);
+}
+
+#define RING_BENCH_SLOTS 1024
+
+static void bench_ring_sink(void) {
+    // The usual approach: format to a stack buffer, then copy it into a
+    // mutex-protected ring.
+    static char ring[RING_BENCH_SLOTS][RING_SINK_SLOT_SIZE];
+    static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+    uint32_t ring_head = 0;
+
+    uint64_t start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        char buffer[RING_SINK_SLOT_SIZE];
+        const uint32_t length =
+            format_to_buffer(buffer,
+                             sizeof(buffer),
+                             "req=%u state=%s retries=%d\n",
+                             i,
+                             "open",
+                             (int)(i % 5));
+
+        pthread_mutex_lock(&ring_lock);
+        memcpy(ring[ring_head % RING_BENCH_SLOTS], buffer, length);
+        ring_head++;
+        pthread_mutex_unlock(&ring_lock);
+    }
+
+    print_result("format_to_buffer + locked ring memcpy",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+
+    static struct ring_sink_slot slots[RING_BENCH_SLOTS];
+    struct ring_sink sink;
+    ring_sink_init(&sink, slots, sizeof(slots));
+
+    start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        ring_sink_format(&sink,
+                         "req=%u state=%s retries=%d\n",
+                         i,
+                         "open",
+                         (int)(i % 5));
+    }
+
+    print_result("ring_sink", get_time_ns() - start, BENCH_ITERATIONS);
+    bench_sink = ring[0][0];
+}
+
+static void
+bench_dedup_sink_stream(const char *const name, const uint32_t distinct) {
+    static struct dedup_sink sink;
+    dedup_sink_init(&sink,
+                    discard_string_callback,
+                    NULL,
+                    /*window_count=*/10000,
+                    /*window_ns=*/0);
+
+    const uint64_t start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        // Every line repeats the previous one unless it's a new group.
+        dedup_sink_format(&sink,
+                          "upstream %s failed: code=%d attempt=%u\n",
+                          "db-primary",
+                          -110,
+                          (i / (BENCH_ITERATIONS / distinct)));
+    }
+
+    dedup_sink_flush(&sink);
+
+    const uint64_t elapsed_ns = get_time_ns() - start;
+    print_result(name, elapsed_ns, BENCH_ITERATIONS);
+
+    printf("%-40s %8.2f%% suppressed\n",
+           "",
+           (double)sink.lines_suppressed * 100.0 / (double)sink.lines_in);
+}
+
+static void bench_dedup_sink(void) {
+    bench_dedup_sink_stream("dedup_sink duplicate-heavy", 100);
+    bench_dedup_sink_stream("dedup_sink unique-heavy", BENCH_ITERATIONS);
+}
+
+static void bench_tokenize(void) {
+    char text[128];
+    uint64_t text_bytes = 0;
+
+    uint64_t start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        text_bytes +=
+            format_to_buffer(text,
+                             sizeof(text),
+                             "motor %d: rpm=%u current=%dmA state=%s\n",
+                             (int)(i % 4),
+                             1200 + (i % 300),
+                             (int)(i % 2000) - 1000,
+                             "running");
+        bench_sink = text[0];
+    }
+
+    print_result("format_to_buffer (text)",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+
+    uint8_t record[PRINTF_TOKEN_MAX_RECORD_SIZE];
+    uint64_t record_bytes = 0;
+
+    start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        record_bytes +=
+            PRINTF_TOKENIZE_TO_BUFFER(record,
+                                      sizeof(record),
+                                      "motor %d: rpm=%u current=%dmA "
+                                      "state=%s\n",
+                                      (int)(i % 4),
+                                      1200 + (i % 300),
+                                      (int)(i % 2000) - 1000,
+                                      "running");
+        bench_sink = (char)record[4];
+    }
+
+    print_result("PRINTF_TOKENIZE_TO_BUFFER",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+
+    printf("%-40s %8.2f bytes/line text, %.2f bytes/line tokenized\n",
+           "",
+           (double)text_bytes / BENCH_ITERATIONS,
+           (double)record_bytes / BENCH_ITERATIONS);
+}
+
+#define SCANF_BENCH_LINES 256
+
+static void bench_scanf(void) {
+    static char lines[SCANF_BENCH_LINES][128];
+    static uint32_t lengths[SCANF_BENCH_LINES];
+
+    uint64_t value = 0x9E3779B97F4A7C15ull;
+    for (uint32_t i = 0; i != SCANF_BENCH_LINES; i++) {
+        value ^= value << 13;
+        value ^= value >> 7;
+        value ^= value << 17;
+
+        lengths[i] = format_to_buffer(lines[i],
+                                      sizeof(lines[i]),
+                                      "rx %zu bytes from %#x, %-6s|%5d took "
+                                      "%lluns",
+                                      (size_t)(value % 65536),
+                                      (unsigned)value,
+                                      i % 2 ? "eth0" : "wlan0",
+                                      (int)(value % 2000) - 1000,
+                                      (unsigned long long)(value >> 20));
+    }
+
+    size_t bytes = 0;
+    unsigned from = 0;
+    int delta = 0;
+    unsigned long long took = 0;
+
+    struct scanf_capture name;
+    uint64_t start = get_time_ns();
+
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        const uint32_t line = i % SCANF_BENCH_LINES;
+        parse_scanf_format(lines[line],
+                           lengths[line],
+                           "rx %zu bytes from %x, %[^ ] |%d took %lluns",
+                           &bytes,
+                           &from,
+                           &name,
+                           &delta,
+                           &took);
+        bench_sink = (char)(bytes + from + delta + took + name.length);
+    }
+
+    print_result("parse_scanf_format",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+
+    char name_copy[16];
+    start = get_time_ns();
+
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        sscanf(lines[i % SCANF_BENCH_LINES],
+               "rx %zu bytes from %x, %15[^ ] |%d took %lluns",
+               &bytes,
+               &from,
+               name_copy,
+               &delta,
+               &took);
+        bench_sink = (char)(bytes + from + delta + took + name_copy[0]);
+    }
+
+    print_result("sscanf", get_time_ns() - start, BENCH_ITERATIONS);
+}
+
+/*
+ * The string primitives the engine needs, as libc, printf_string.c and plain
+ * byte loops implement them. The byte loops stand in for a bare-metal libc,
+ * so they're kept from being vectorized or turned into libc calls.
+ */
+
+#if defined(__GNUC__) && !defined(__clang__)
+    #define BYTE_LOOP \
+        __attribute__((noinline, \
+                       optimize("no-tree-loop-distribute-patterns", \
+                                "no-tree-vectorize")))
+#else
+    #define BYTE_LOOP __attribute__((noinline))
+#endif
+
+__attribute__((noinline))
+static size_t libc_strlen(const char *const str) {
+    return strlen(str);
+}
+
+__attribute__((noinline))
+static const char *libc_find_percent(const char *const str) {
+    return strchr(str, '%');
+}
+
+__attribute__((noinline))
+static void
+libc_memcpy(void *const dst, const void *const src, const size_t length) {
+    memcpy(dst, src, length);
+}
+
+BYTE_LOOP
+static size_t byte_strlen(const char *const str) {
+    const char *iter = str;
+    for (; *iter != '\0'; iter++) {}
+
+    return (size_t)(iter - str);
+}
+
+BYTE_LOOP
+static const char *byte_find_percent(const char *str) {
+    for (; *str != '%'; str++) {
+        if (*str == '\0') {
+            return NULL;
+        }
+    }
+
+    return str;
+}
+
+BYTE_LOOP
+static void
+byte_memcpy(void *const dst, const void *const src, const size_t length) {
+    for (size_t i = 0; i != length; i++) {
+        ((char *)dst)[i] = ((const char *)src)[i];
+    }
+}
+
+struct string_primitives {
+    const char *name;
+    size_t (*length)(const char *str);
+    const char *(*find_percent)(const char *str);
+    void (*copy)(void *dst, const void *src, size_t length);
+};
+
+static void bench_string_primitives(void) {
+    const struct string_primitives primitives[] = {
+        { "libc", libc_strlen, libc_find_percent, libc_memcpy },
+        { "swar", swar_strlen, swar_find_percent, swar_memcpy },
+        { "byte loop", byte_strlen, byte_find_percent, byte_memcpy },
+    };
+
+    // The start moves through every alignment, which also keeps the calls
+    // from being hoisted out of the loop.
+    const uint32_t lengths[] = { 16, 256 };
+    static char text[256 + 8];
+    static char copy[256 + 8];
+
+    for (uint32_t l = 0; l != sizeof(lengths) / sizeof(lengths[0]); l++) {
+        const uint32_t length = lengths[l];
+
+        memset(text, 'x', sizeof(text));
+        for (uint32_t start = 0; start != 8; start++) {
+            text[start + length] = '\0';
+        }
+
+        for (uint32_t p = 0; p != sizeof(primitives) / sizeof(primitives[0]);
+             p++)
+        {
+            const struct string_primitives *const prims = &primitives[p];
+            char name[64];
+
+            uint64_t start = get_time_ns();
+            for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+                bench_sink = (char)prims->length(text + (i % 8));
+            }
+
+            format_to_buffer(name, sizeof(name), "%s strlen (%u bytes)",
+                             prims->name, length);
+            print_result(name, get_time_ns() - start, BENCH_ITERATIONS);
+
+            start = get_time_ns();
+            for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+                bench_sink =
+                    (char)(prims->find_percent(text + (i % 8)) == NULL);
+            }
+
+            format_to_buffer(name, sizeof(name), "%s strchr '%%' (%u bytes)",
+                             prims->name, length);
+            print_result(name, get_time_ns() - start, BENCH_ITERATIONS);
+
+            start = get_time_ns();
+            for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+                prims->copy(copy + (i % 8), text, length);
+                bench_sink = copy[i % 8];
+            }
+
+            format_to_buffer(name, sizeof(name), "%s memcpy (%u bytes)",
+                             prims->name, length);
+            print_result(name, get_time_ns() - start, BENCH_ITERATIONS);
+        }
+    }
+}
+
+/*
+ * The same format, parsed at runtime and from the table printf_precompile
+ * generated into bench_formats.c. The compiled call still looks its table up
+ * by hash, as routed calls do.
+ */
+
+static void bench_compiled(void) {
+    char text[128];
+
+    uint64_t start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        format_to_buffer(text,
+                         sizeof(text),
+                         "motor %d: rpm=%5u current=%+dmA state=%-8s|\n",
+                         (int)(i % 4),
+                         1200 + (i % 300),
+                         (int)(i % 2000) - 1000,
+                         "running");
+        bench_sink = text[0];
+    }
+
+    print_result("format_to_buffer (parsed)",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+
+    start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        format_to_buffer_compiled(
+            text,
+            sizeof(text),
+            PRINTF_COMPILED("motor %d: rpm=%5u current=%+dmA state=%-8s|\n"),
+            "motor %d: rpm=%5u current=%+dmA state=%-8s|\n",
+            (int)(i % 4),
+            1200 + (i % 300),
+            (int)(i % 2000) - 1000,
+            "running");
+        bench_sink = text[0];
+    }
+
+    print_result("format_to_buffer (compiled)",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+}
+
+/*
+ * Scaling across threads. Each thread formats THREAD_BENCH_ITERATIONS
+ * messages and times each one, for 1, 2, 4, ... threads, up to the number of
+ * CPUs. The throughput is of all threads together, and the latencies, which
+ * include reading the clock, are of every message from every thread.
+ */
+
+#define THREAD_BENCH_ITERATIONS 200000
+#define THREAD_BENCH_MAX_THREADS 64
+#define THREAD_BENCH_TEXT_SIZE 128
+
+enum thread_bench_mode {
+    // format_to_buffer() into each thread's own buffer.
+    THREAD_BENCH_FORMAT_TO_BUFFER,
+
+    // A _Thread_local struct printf_context, writing to a buffer sink whose
+    // state is in the thread's own cache line.
+    THREAD_BENCH_CONTEXT,
+
+    // The same, but with the sink states of all threads packed next to each
+    // other, so they share cache lines (false sharing).
+    THREAD_BENCH_CONTEXT_PACKED,
+
+    // Every thread writing to one ring_sink.
+    THREAD_BENCH_SHARED_RING,
+};
+
+// A buffer sink, which updates used with every write.
+struct thread_bench_buffer {
+    char *text;
+    uint32_t used;
+    uint32_t size;
+};
+
+struct thread_bench_padded_buffer {
+    struct thread_bench_buffer buffer;
+} __attribute__((aligned(PRINTF_CACHE_LINE_SIZE)));
+
+struct thread_bench_text {
+    char text[THREAD_BENCH_TEXT_SIZE];
+} __attribute__((aligned(PRINTF_CACHE_LINE_SIZE)));
+
+struct thread_bench_thread {
+    pthread_t thread;
+    enum thread_bench_mode mode;
+    uint32_t index;
+
+    struct thread_bench_buffer *buffer;
+    uint32_t *latencies;
+
+    uint64_t start_ns;
+    uint64_t end_ns;
+};
+
+static struct thread_bench_padded_buffer
+    thread_bench_padded_buffers[THREAD_BENCH_MAX_THREADS];
+
+static struct thread_bench_buffer
+    thread_bench_packed_buffers[THREAD_BENCH_MAX_THREADS];
+
+static struct thread_bench_text thread_bench_texts[THREAD_BENCH_MAX_THREADS];
+
+static _Thread_local struct printf_context thread_bench_context;
+
+static struct ring_sink thread_bench_ring;
+static pthread_barrier_t thread_bench_barrier;
+
+static size_t
+thread_bench_write_ch_callback(struct printf_spec_info *const spec_info,
+                               void *const info,
+                               const char ch,
+                               size_t times,
+                               bool *const should_continue_out)
+{
+    (void)spec_info;
+
+    struct thread_bench_buffer *const buffer =
+        (struct thread_bench_buffer *)info;
+
+    if (times > buffer->size - buffer->used) {
+        times = buffer->size - buffer->used;
+        *should_continue_out = false;
+    }
+
+    memset(buffer->text + buffer->used, ch, times);
+    buffer->used += (uint32_t)times;
+
+    return times;
+}
+
+static size_t
+thread_bench_write_string_callback(struct printf_spec_info *const spec_info,
+                                   void *const info,
+                                   const char *const string,
+                                   size_t length,
+                                   bool *const should_continue_out)
+{
+    (void)spec_info;
+
+    struct thread_bench_buffer *const buffer =
+        (struct thread_bench_buffer *)info;
+
+    if (length > buffer->size - buffer->used) {
+        length = buffer->size - buffer->used;
+        *should_continue_out = false;
+    }
+
+    memcpy(buffer->text + buffer->used, string, length);
+    buffer->used += (uint32_t)length;
+
+    return length;
+}
+
+static void
+thread_bench_format(struct thread_bench_buffer *const buffer,
+                    const char *const format,
+                    ...)
+{
+    va_list list;
+    va_start(list, format);
+
+    buffer->used = 0;
+    parse_printf_format_with_context(&thread_bench_context, format, list);
+
+    va_end(list);
+}
+
+static void *thread_bench_thread(void *const info) {
+    struct thread_bench_thread *const thread =
+        (struct thread_bench_thread *)info;
+
+    printf_context_init(&thread_bench_context,
+                        thread_bench_write_ch_callback,
+                        thread->buffer,
+                        thread_bench_write_string_callback,
+                        thread->buffer);
+
+    pthread_barrier_wait(&thread_bench_barrier);
+    thread->start_ns = get_time_ns();
+
+    for (uint32_t i = 0; i != THREAD_BENCH_ITERATIONS; i++) {
+        const uint64_t start = get_time_ns();
+        switch (thread->mode) {
+            case THREAD_BENCH_FORMAT_TO_BUFFER:
+                format_to_buffer(thread->buffer->text,
+                                 thread->buffer->size,
+                                 "worker %u: req=%u state=%s retries=%d\n",
+                                 thread->index,
+                                 i,
+                                 "open",
+                                 (int)(i % 5));
+                break;
+            case THREAD_BENCH_CONTEXT:
+            case THREAD_BENCH_CONTEXT_PACKED:
+                thread_bench_format(thread->buffer,
+                                    "worker %u: req=%u state=%s retries=%d\n",
+                                    thread->index,
+                                    i,
+                                    "open",
+                                    (int)(i % 5));
+                break;
+            case THREAD_BENCH_SHARED_RING:
+                ring_sink_format(&thread_bench_ring,
+                                 "worker %u: req=%u state=%s retries=%d\n",
+                                 thread->index,
+                                 i,
+                                 "open",
+                                 (int)(i % 5));
+                break;
+        }
+
+        const uint64_t latency = get_time_ns() - start;
+        thread->latencies[i] =
+            latency < UINT32_MAX ? (uint32_t)latency : UINT32_MAX;
+    }
+
+    thread->end_ns = get_time_ns();
+    return NULL;
+}
+
+static int compare_latencies(const void *const lhs, const void *const rhs) {
+    const uint32_t lhs_latency = *(const uint32_t *)lhs;
+    const uint32_t rhs_latency = *(const uint32_t *)rhs;
+
+    return (lhs_latency > rhs_latency) - (lhs_latency < rhs_latency);
+}
+
+static void
+bench_threads_mode(const char *const name,
+                   const enum thread_bench_mode mode,
+                   const uint32_t thread_count)
+{
+    const size_t latency_count =
+        (size_t)thread_count * THREAD_BENCH_ITERATIONS;
+
+    uint32_t *const latencies = malloc(latency_count * sizeof(*latencies));
+    if (latencies == NULL) {
+        return;
+    }
+
+    struct thread_bench_thread threads[THREAD_BENCH_MAX_THREADS];
+    pthread_barrier_init(&thread_bench_barrier, NULL, thread_count);
+
+    for (uint32_t i = 0; i != thread_count; i++) {
+        struct thread_bench_buffer *const buffer =
+            mode == THREAD_BENCH_CONTEXT_PACKED
+                ? &thread_bench_packed_buffers[i]
+                : &thread_bench_padded_buffers[i].buffer;
+
+        *buffer = (struct thread_bench_buffer){
+            .text = thread_bench_texts[i].text,
+            .used = 0,
+            .size = THREAD_BENCH_TEXT_SIZE
+        };
+
+        threads[i] = (struct thread_bench_thread){
+            .mode = mode,
+            .index = i,
+            .buffer = buffer,
+            .latencies = latencies + (size_t)i * THREAD_BENCH_ITERATIONS
+        };
+
+        pthread_create(&threads[i].thread,
+                       NULL,
+                       thread_bench_thread,
+                       &threads[i]);
+    }
+
+    uint64_t start_ns = UINT64_MAX;
+    uint64_t end_ns = 0;
+
+    for (uint32_t i = 0; i != thread_count; i++) {
+        pthread_join(threads[i].thread, NULL);
+
+        if (threads[i].start_ns < start_ns) {
+            start_ns = threads[i].start_ns;
+        }
+
+        if (threads[i].end_ns > end_ns) {
+            end_ns = threads[i].end_ns;
+        }
+    }
+
+    pthread_barrier_destroy(&thread_bench_barrier);
+    qsort(latencies, latency_count, sizeof(*latencies), compare_latencies);
+
+    char label[64];
+    format_to_buffer(label,
+                     sizeof(label),
+                     "%s, %u thread%s",
+                     name,
+                     thread_count,
+                     thread_count != 1 ? "s" : "");
+
+    printf("%-40s %8.2f Mmsg/s\n",
+           label,
+           (double)latency_count * 1000.0 / (double)(end_ns - start_ns));
+
+    printf("%-40s p50 %u, p99 %u, p99.9 %u ns\n",
+           "",
+           latencies[latency_count / 2],
+           latencies[latency_count * 99 / 100],
+           latencies[latency_count * 999 / 1000]);
+
+    free(latencies);
+}
+
+static void bench_threads(void) {
+    static struct ring_sink_slot slots[RING_BENCH_SLOTS];
+    ring_sink_init(&thread_bench_ring, slots, sizeof(slots));
+
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpu_count < 1) {
+        cpu_count = 1;
+    } else if (cpu_count > THREAD_BENCH_MAX_THREADS) {
+        cpu_count = THREAD_BENCH_MAX_THREADS;
+    }
+
+    const uint32_t max_threads = (uint32_t)cpu_count;
+    for (uint32_t count = 1;; count = count * 2 < max_threads
+                                          ? count * 2
+                                          : max_threads)
+    {
+        bench_threads_mode("format_to_buffer",
+                           THREAD_BENCH_FORMAT_TO_BUFFER,
+                           count);
+
+        bench_threads_mode("printf_context",
+                           THREAD_BENCH_CONTEXT,
+                           count);
+
+        bench_threads_mode("printf_context, packed sinks",
+                           THREAD_BENCH_CONTEXT_PACKED,
+                           count);
+
+        bench_threads_mode("shared ring_sink",
+                           THREAD_BENCH_SHARED_RING,
+                           count);
+
+        if (count == max_threads) {
+            break;
+        }
+    }
+}
+
+/*
+ * A table of TABLE_BENCH_ROWS rows, with each column as wide as its widest
+ * cell: either formatting every cell into a scratch string first to find the
+ * widths, or with printf_table. Both write through the buffer sink of
+ * bench_threads().
+ */
+
+#define TABLE_BENCH_ROWS 64
+#define TABLE_BENCH_COLUMNS 3
+#define TABLE_BENCH_CELL_SIZE 32
+
+static void bench_table(void) {
+    static const char *const names[] = {
+        "nginx",
+        "postgres",
+        "redis",
+        "systemd-journald",
+        "sshd",
+        "containerd"
+    };
+
+    uint64_t rows[TABLE_BENCH_ROWS][TABLE_BENCH_COLUMNS];
+    for (uint32_t i = 0; i != TABLE_BENCH_ROWS; i++) {
+        rows[i][0] = (uintptr_t)names[i % (sizeof(names) / sizeof(*names))];
+        rows[i][1] = 100 + i * 37;
+        rows[i][2] = (i * 2654435761u) % 1000000;
+    }
+
+    static char text[TABLE_BENCH_ROWS * TABLE_BENCH_COLUMNS
+                     * TABLE_BENCH_CELL_SIZE];
+    const uint32_t table_count = BENCH_ITERATIONS / TABLE_BENCH_ROWS;
+
+    uint64_t start = get_time_ns();
+    for (uint32_t table = 0; table != table_count; table++) {
+        char cells[TABLE_BENCH_ROWS][TABLE_BENCH_COLUMNS]
+                  [TABLE_BENCH_CELL_SIZE];
+
+        int widths[TABLE_BENCH_COLUMNS] = {0};
+        for (uint32_t i = 0; i != TABLE_BENCH_ROWS; i++) {
+            const int lengths[TABLE_BENCH_COLUMNS] = {
+                (int)format_to_buffer(cells[i][0],
+                                      TABLE_BENCH_CELL_SIZE,
+                                      "%s",
+                                      (const char *)(uintptr_t)rows[i][0]),
+                (int)format_to_buffer(cells[i][1],
+                                      TABLE_BENCH_CELL_SIZE,
+                                      "%u",
+                                      (uint32_t)rows[i][1]),
+                (int)format_to_buffer(cells[i][2],
+                                      TABLE_BENCH_CELL_SIZE,
+                                      "%#x",
+                                      (uint32_t)rows[i][2])
+            };
+
+            for (uint32_t column = 0; column != TABLE_BENCH_COLUMNS; column++) {
+                if (widths[column] < lengths[column]) {
+                    widths[column] = lengths[column];
+                }
+            }
+        }
+
+        struct thread_bench_buffer buffer = {
+            .text = text,
+            .used = 0,
+            .size = sizeof(text)
+        };
+
+        for (uint32_t i = 0; i != TABLE_BENCH_ROWS; i++) {
+            buffer.used +=
+                format_to_buffer(buffer.text + buffer.used,
+                                 buffer.size - buffer.used,
+                                 "%-*s  %*s  %*s\n",
+                                 widths[0],
+                                 cells[i][0],
+                                 widths[1],
+                                 cells[i][1],
+                                 widths[2],
+                                 cells[i][2]);
+        }
+
+        bench_sink = text[0];
+    }
+
+    print_result("table, scratch cells (per row)",
+                 get_time_ns() - start,
+                 (uint64_t)table_count * TABLE_BENCH_ROWS);
+
+    start = get_time_ns();
+    for (uint32_t i = 0; i != table_count; i++) {
+        struct printf_table table;
+        printf_table_init(&table, "%-s  %u  %#x\n");
+        printf_table_measure(&table, &rows[0][0], TABLE_BENCH_ROWS);
+
+        struct thread_bench_buffer buffer = {
+            .text = text,
+            .used = 0,
+            .size = sizeof(text)
+        };
+
+        printf_table_render64(&table,
+                              thread_bench_write_ch_callback,
+                              &buffer,
+                              thread_bench_write_string_callback,
+                              &buffer,
+                              &rows[0][0],
+                              TABLE_BENCH_ROWS);
+
+        bench_sink = text[0];
+    }
+
+    print_result("printf_table (per row)",
+                 get_time_ns() - start,
+                 (uint64_t)table_count * TABLE_BENCH_ROWS);
+}
+
+/*
+ * A simulated transmitter that takes ns_per_byte per byte without using the
+ * CPU, like a DMA transfer. The serial one blocks the formatting thread for
+ * the whole transfer, the threaded one transfers while the next half is being
+ * formatted.
+ */
+
+#define PINGPONG_HALF_SIZE 4096
+
+struct slow_transmitter {
+    struct pingpong_sink *sink;
+    double ns_per_byte;
+
+    // Posted when a half is handed over, or to stop the thread.
+    sem_t start;
+    uint32_t pending_length;
+    bool stop;
+
+    // Time the formatting thread spent blocked on the transmitter, and how
+    // many times it was.
+    uint64_t stall_ns;
+    uint64_t stall_count;
+};
+
+static void
+simulate_transfer(const struct slow_transmitter *const transmitter,
+                  const uint32_t length)
+{
+    const uint64_t ns = (uint64_t)(length * transmitter->ns_per_byte);
+    const struct timespec duration = {
+        .tv_sec = (time_t)(ns / 1000000000),
+        .tv_nsec = (long)(ns % 1000000000)
+    };
+
+    if (ns != 0) {
+        nanosleep(&duration, NULL);
+    }
+}
+
+static void pingpong_idle(void *const info) {
+    struct slow_transmitter *const transmitter =
+        (struct slow_transmitter *)info;
+
+    const uint64_t start = get_time_ns();
+    sched_yield();
+
+    transmitter->stall_ns += get_time_ns() - start;
+}
+
+static void
+serial_transmit(void *const info,
+                const char *const data,
+                const uint32_t length)
+{
+    (void)data;
+
+    struct slow_transmitter *const transmitter =
+        (struct slow_transmitter *)info;
+
+    const uint64_t start = get_time_ns();
+    simulate_transfer(transmitter, length);
+
+    transmitter->stall_ns += get_time_ns() - start;
+    transmitter->stall_count++;
+
+    pingpong_sink_transmit_done(transmitter->sink);
+}
+
+static void
+threaded_transmit(void *const info,
+                  const char *const data,
+                  const uint32_t length)
+{
+    (void)data;
+
+    struct slow_transmitter *const transmitter =
+        (struct slow_transmitter *)info;
+
+    transmitter->pending_length = length;
+    sem_post(&transmitter->start);
+}
+
+static void *slow_transmitter_thread(void *const info) {
+    struct slow_transmitter *const transmitter =
+        (struct slow_transmitter *)info;
+
+    // Sleep until there's something to transmit, like a DMA controller, so
+    // we don't take CPU time from the formatting thread.
+    while (true) {
+        while (sem_wait(&transmitter->start) != 0) {}
+        if (transmitter->stop) {
+            return NULL;
+        }
+
+        simulate_transfer(transmitter, transmitter->pending_length);
+        pingpong_sink_transmit_done(transmitter->sink);
+    }
+}
+
+/*
+ * Returns the time spent per byte of output, or 0 if the transmitter thread
+ * couldn't be started.
+ */
+
+static double
+bench_pingpong_mode(const char *const name,
+                    const pingpong_sink_start_transmit_t start_transmit,
+                    const bool threaded,
+                    const double ns_per_byte)
+{
+    static char buffer[2 * PINGPONG_HALF_SIZE];
+
+    struct pingpong_sink sink;
+    struct slow_transmitter transmitter = {
+        .sink = &sink,
+        .ns_per_byte = ns_per_byte
+    };
+
+    pingpong_sink_init(&sink,
+                       buffer,
+                       PINGPONG_HALF_SIZE,
+                       start_transmit,
+                       pingpong_idle,
+                       &transmitter);
+
+    sem_init(&transmitter.start, /*pshared=*/0, /*value=*/0);
+
+    pthread_t thread;
+    if (threaded &&
+        pthread_create(&thread, NULL, slow_transmitter_thread, &transmitter))
+    {
+        printf("%-40s failed to start transmitter thread\n", name);
+        sem_destroy(&transmitter.start);
+
+        return 0;
+    }
+
+    const uint32_t iterations = BENCH_ITERATIONS / 10;
+    const uint64_t start = get_time_ns();
+
+    uint64_t length = 0;
+    for (uint32_t i = 0; i != iterations; i++) {
+        length += pingpong_sink_format(&sink,
+                                       "sample %u: temp=%d.%02u mV=%u\n",
+                                       i,
+                                       (int)(i % 80) - 20,
+                                       (i * 37) % 100,
+                                       (i * 7919) % 3300);
+    }
+
+    pingpong_sink_flush(&sink);
+    pingpong_sink_wait_idle(&sink);
+
+    const uint64_t elapsed_ns = get_time_ns() - start;
+
+    if (threaded) {
+        transmitter.stop = true;
+        sem_post(&transmitter.start);
+
+        pthread_join(thread, NULL);
+    }
+
+    sem_destroy(&transmitter.start);
+
+    print_result(name, elapsed_ns, iterations);
+    if (ns_per_byte != 0) {
+        printf("%-40s %8.2f%% of the time, %llu times\n",
+               "  formatting thread stalled",
+               100.0 * (double)transmitter.stall_ns / (double)elapsed_ns,
+               (unsigned long long)(transmitter.stall_count
+                                    + sink.wait_count));
+    }
+
+    return (double)elapsed_ns / (double)length;
+}
+
+/*
+ * Overlap can hide at most the smaller of the formatting and transfer times,
+ * so the transfer is made to cost about as much as formatting does.
+ */
+
+static void bench_pingpong(void) {
+#if defined(__linux__)
+    // Sleeps are otherwise rounded up by as much as 50us, which is longer than
+    // the transfers. The transmitter thread inherits this.
+    prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+#endif /* defined(__linux__) */
+
+    const double format_ns_per_byte =
+        bench_pingpong_mode("pingpong_sink, no transfer cost",
+                            serial_transmit,
+                            false,
+                            /*ns_per_byte=*/0);
+
+    bench_pingpong_mode("pingpong_sink serial transmit",
+                        serial_transmit,
+                        false,
+                        format_ns_per_byte);
+    bench_pingpong_mode("pingpong_sink overlapped transmit",
+                        threaded_transmit,
+                        true,
+                        format_ns_per_byte);
+}
+
+int main(const int argc, const char *const argv[]) {
+    (void)argc;
+    (void)argv;
+
+    bench_integers();
+    bench_positional();
+    bench_timestamps();
+    bench_fd_sink();
+    bench_lz4_sink();
+    bench_tee_sink();
+    bench_ring_sink();
+    bench_dedup_sink();
+    bench_tokenize();
+    bench_scanf();
+    bench_string_primitives();
+    bench_compiled();
+    bench_threads();
+    bench_table();
+    bench_pingpong();
+    return 0;
+}
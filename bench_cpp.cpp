@@ -0,0 +1,170 @@
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <iterator>
+#include <memory_resource>
+#include <span>
+#include <string>
+
+#if __has_include(<format>)
+    #include <format>
+#endif
+
+#include "printf_sinks.hpp"
+
+#define BENCH_ITERATIONS 2000000
+
+static uint64_t get_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void
+print_result(const char *const name,
+             const uint64_t elapsed_ns,
+             const uint64_t iterations)
+{
+    std::printf("%-40s %8.2f ns/op\n",
+                name,
+                (double)elapsed_ns / (double)iterations);
+}
+
+// Keep the compiler from optimizing away the formatted output.
+static volatile char bench_sink;
+
+/*
+ * Each iteration builds a new std::string, the way a function returning a
+ * formatted string would, except for the span and the pmr builder, which
+ * write into memory on the stack.
+ */
+
+static void bench_snprintf() {
+    const uint64_t start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        const int length = std::snprintf(nullptr,
+                                         0,
+                                         "req=%u state=%s retries=%d\n",
+                                         i,
+                                         "open",
+                                         (int)(i % 5));
+
+        std::string text(length, '\0');
+        std::snprintf(text.data(),
+                      length + 1,
+                      "req=%u state=%s retries=%d\n",
+                      i,
+                      "open",
+                      (int)(i % 5));
+
+        bench_sink = text[0];
+    }
+
+    print_result("snprintf into std::string",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+}
+
+static void bench_std_format() {
+#if defined(__cpp_lib_format)
+    const uint64_t start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        std::string text;
+        std::format_to(std::back_inserter(text),
+                       "req={} state={} retries={}\n",
+                       i,
+                       "open",
+                       (int)(i % 5));
+
+        bench_sink = text[0];
+    }
+
+    print_result("std::format_to into std::string",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+#else
+    std::printf("%-40s (no <format> in this standard library)\n",
+                "std::format_to into std::string");
+#endif
+}
+
+static void bench_adapters() {
+    uint64_t start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        std::string text;
+        embedded_printf::append_format(text,
+                                       "req=%u state=%s retries=%d\n",
+                                       i,
+                                       "open",
+                                       (int)(i % 5));
+
+        bench_sink = text[0];
+    }
+
+    print_result("append_format into std::string",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+
+    start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        std::string text;
+        embedded_printf::format_to(std::back_inserter(text),
+                                   "req=%u state=%s retries=%d\n",
+                                   i,
+                                   "open",
+                                   (int)(i % 5));
+
+        bench_sink = text[0];
+    }
+
+    print_result("format_to back_inserter(std::string)",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+
+    char storage[256];
+    start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        std::pmr::monotonic_buffer_resource resource(
+            storage,
+            sizeof(storage),
+            std::pmr::null_memory_resource());
+
+        embedded_printf::pmr::builder builder(&resource);
+        builder.format("req=%u state=%s retries=%d\n",
+                       i,
+                       "open",
+                       (int)(i % 5));
+
+        bench_sink = builder.view()[0];
+    }
+
+    print_result("pmr::builder on a stack buffer",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+
+    start = get_time_ns();
+    for (uint32_t i = 0; i != BENCH_ITERATIONS; i++) {
+        embedded_printf::format_to_span(std::span<char>(storage),
+                                        "req=%u state=%s retries=%d\n",
+                                        i,
+                                        "open",
+                                        (int)(i % 5));
+
+        bench_sink = storage[0];
+    }
+
+    print_result("format_to_span",
+                 get_time_ns() - start,
+                 BENCH_ITERATIONS);
+}
+
+int main(const int argc, const char *const argv[]) {
+    (void)argc;
+    (void)argv;
+
+    bench_snprintf();
+    bench_std_format();
+    bench_adapters();
+    return 0;
+}
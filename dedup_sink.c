@@ -0,0 +1,277 @@
+#include <string.h>
+#include <time.h>
+
+#include "dedup_sink.h"
+#include "example.h"
+
+/******* PRIVATE FUNCTIONS *******/
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+static uint64_t hash_line(const char *const line, const uint32_t length) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (uint32_t i = 0; i != length; i++) {
+        hash = (hash ^ (uint8_t)line[i]) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void
+forward(struct dedup_sink *const sink,
+        const char *const data,
+        const uint32_t length)
+{
+    if (sink->stopped || length == 0) {
+        return;
+    }
+
+    bool should_continue = true;
+    sink->write_string_cb(NULL,
+                          sink->string_cb_info,
+                          data,
+                          length,
+                          &should_continue);
+
+    if (!should_continue) {
+        sink->stopped = true;
+    }
+}
+
+static void end_run(struct dedup_sink *const sink) {
+    if (sink->repeats == 0) {
+        return;
+    }
+
+    char summary[64];
+    const uint32_t length =
+        format_to_buffer(summary,
+                         sizeof(summary),
+                         "last message repeated %u times\n",
+                         sink->repeats);
+
+    sink->repeats = 0;
+    forward(sink, summary, length);
+}
+
+static void complete_line(struct dedup_sink *const sink) {
+    const char *const line = sink->lines[sink->current];
+    const uint32_t length = sink->current_length;
+
+    sink->current_length = 0;
+    sink->lines_in++;
+
+    const uint64_t hash = hash_line(line, length);
+    const uint64_t now_ns = sink->window_ns != 0 ? get_time_ns() : 0;
+
+    if (sink->have_previous &&
+        sink->previous_hash == hash &&
+        sink->previous_length == length &&
+        memcmp(sink->lines[sink->current ^ 1], line, length) == 0)
+    {
+        const bool in_count_window =
+            sink->window_count == 0 || sink->repeats < sink->window_count;
+        const bool in_time_window =
+            sink->window_ns == 0 ||
+            now_ns - sink->run_start_ns < sink->window_ns;
+
+        if (in_count_window && in_time_window) {
+            sink->repeats++;
+            sink->lines_suppressed++;
+
+            return;
+        }
+    }
+
+    // This line starts a new run.
+    end_run(sink);
+    forward(sink, line, length);
+
+    sink->current ^= 1;
+    sink->have_previous = true;
+    sink->previous_length = length;
+    sink->previous_hash = hash;
+    sink->run_start_ns = now_ns;
+}
+
+// The line being gathered is too long to suppress, so pass it through.
+static void start_passthrough(struct dedup_sink *const sink) {
+    end_run(sink);
+    forward(sink, sink->lines[sink->current], sink->current_length);
+
+    sink->current_length = 0;
+    sink->passthrough = true;
+    sink->have_previous = false;
+}
+
+static void
+append(struct dedup_sink *const sink,
+       const char *const data,
+       const uint32_t length)
+{
+    uint32_t done = 0;
+    while (done != length && !sink->stopped) {
+        const char *const start = data + done;
+        const uint32_t left = length - done;
+
+        const char *const newline = memchr(start, '\n', left);
+        const uint32_t line_left =
+            newline != NULL ? (uint32_t)(newline - start) + 1 : left;
+
+        if (sink->passthrough) {
+            forward(sink, start, line_left);
+            if (newline != NULL) {
+                sink->passthrough = false;
+                sink->lines_in++;
+            }
+
+            done += line_left;
+            continue;
+        }
+
+        const uint32_t room = DEDUP_SINK_LINE_SIZE - sink->current_length;
+        if (line_left > room) {
+            start_passthrough(sink);
+            continue;
+        }
+
+        memcpy(sink->lines[sink->current] + sink->current_length,
+               start,
+               line_left);
+
+        sink->current_length += line_left;
+        done += line_left;
+
+        if (newline != NULL) {
+            complete_line(sink);
+        }
+    }
+}
+
+/******* PUBLIC FUNCTIONS *******/
+
+void
+dedup_sink_init(struct dedup_sink *const sink,
+                const printf_write_string_callback_t write_string_cb,
+                void *const string_cb_info,
+                const uint32_t window_count,
+                const uint64_t window_ns)
+{
+    sink->write_string_cb = write_string_cb;
+    sink->string_cb_info = string_cb_info;
+
+    sink->window_count = window_count;
+    sink->window_ns = window_ns;
+
+    sink->current = 0;
+    sink->current_length = 0;
+    sink->passthrough = false;
+
+    sink->have_previous = false;
+    sink->previous_length = 0;
+    sink->previous_hash = 0;
+
+    sink->run_start_ns = 0;
+    sink->repeats = 0;
+
+    sink->stopped = false;
+    sink->lines_in = 0;
+    sink->lines_suppressed = 0;
+}
+
+bool dedup_sink_flush(struct dedup_sink *const sink) {
+    end_run(sink);
+
+    // An incomplete line can't be compared, so it ends any run.
+    if (sink->current_length != 0) {
+        forward(sink, sink->lines[sink->current], sink->current_length);
+
+        sink->current_length = 0;
+        sink->have_previous = false;
+    }
+
+    return !sink->stopped;
+}
+
+uint32_t
+dedup_sink_write_ch_callback(struct printf_spec_info *const spec_info,
+                             void *const info,
+                             const char ch,
+                             const uint32_t times,
+                             bool *const should_continue_out)
+{
+    (void)spec_info;
+
+    struct dedup_sink *const sink = (struct dedup_sink *)info;
+
+    char chunk[64];
+    memset(chunk, ch, sizeof(chunk));
+
+    uint32_t left = times;
+    while (left != 0) {
+        const uint32_t amount = left < sizeof(chunk) ? left : sizeof(chunk);
+
+        append(sink, chunk, amount);
+        left -= amount;
+    }
+
+    if (sink->stopped) {
+        *should_continue_out = false;
+    }
+
+    return times;
+}
+
+uint32_t
+dedup_sink_write_string_callback(struct printf_spec_info *const spec_info,
+                                 void *const info,
+                                 const char *const string,
+                                 const uint32_t length,
+                                 bool *const should_continue_out)
+{
+    (void)spec_info;
+
+    struct dedup_sink *const sink = (struct dedup_sink *)info;
+    append(sink, string, length);
+
+    if (sink->stopped) {
+        *should_continue_out = false;
+    }
+
+    return length;
+}
+
+uint32_t
+dedup_sink_format(struct dedup_sink *const sink, const char *const format, ...)
+{
+    va_list list;
+    va_start(list, format);
+
+    const uint32_t result = dedup_sink_vformat(sink, format, list);
+
+    va_end(list);
+    return result;
+}
+
+uint32_t
+dedup_sink_vformat(struct dedup_sink *const sink,
+                   const char *const format,
+                   va_list list)
+{
+    const uint32_t length =
+        parse_printf_format(dedup_sink_write_ch_callback,
+                            sink,
+                            dedup_sink_write_string_callback,
+                            sink,
+                            format,
+                            list);
+    return length;
+}
@@ -0,0 +1,115 @@
+/*
+Copyright (c) 2023 Suhas Pai
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "parse_printf.h"
+
+/*
+ * A sink stage that suppresses repeated lines before they reach a downstream
+ * sink.
+ *
+ * Output is gathered a line at a time. When a line is complete, it's hashed
+ * and compared against the previous line, and exact repeats are dropped. When
+ * the run of repeats ends, because a different line arrived, the window ran
+ * out, or dedup_sink_flush() was called, a single summary line is emitted:
+ *
+ *   last message repeated N times
+ *
+ * Lines longer than DEDUP_SINK_LINE_SIZE are passed through as-is, and never
+ * suppressed. Memory use is fixed by the size of struct dedup_sink.
+ */
+
+#define DEDUP_SINK_LINE_SIZE 512
+
+struct dedup_sink {
+    // The downstream sink. Lines are gathered first, so they're always
+    // forwarded through the string callback.
+    printf_write_string_callback_t write_string_cb;
+    void *string_cb_info;
+
+    // A run of repeats ends after this many repeats, or this many nanoseconds
+    // after its first line. 0 means no limit.
+    uint32_t window_count;
+    uint64_t window_ns;
+
+    // The line being gathered, and the previous line, including newlines.
+    char lines[2][DEDUP_SINK_LINE_SIZE];
+    uint32_t current;
+    uint32_t current_length;
+
+    // Set while passing the rest of an over-long line through.
+    bool passthrough;
+
+    bool have_previous;
+    uint32_t previous_length;
+    uint64_t previous_hash;
+
+    uint64_t run_start_ns;
+    uint32_t repeats;
+
+    // Set once the downstream sink stops accepting output.
+    bool stopped;
+
+    uint64_t lines_in;
+    uint64_t lines_suppressed;
+};
+
+void
+dedup_sink_init(struct dedup_sink *sink,
+                printf_write_string_callback_t write_string_cb,
+                void *string_cb_info,
+                uint32_t window_count,
+                uint64_t window_ns);
+
+/*
+ * End the current run of repeats, emitting its summary, and pass on any
+ * incomplete line. Returns false if the downstream sink stopped accepting
+ * output.
+ */
+
+bool dedup_sink_flush(struct dedup_sink *sink);
+
+uint32_t
+dedup_sink_write_ch_callback(struct printf_spec_info *spec_info,
+                             void *info,
+                             char ch,
+                             uint32_t times,
+                             bool *should_continue_out);
+
+uint32_t
+dedup_sink_write_string_callback(struct printf_spec_info *spec_info,
+                                 void *info,
+                                 const char *string,
+                                 uint32_t length,
+                                 bool *should_continue_out);
+
+__attribute__((format(printf, 2, 3)))
+uint32_t dedup_sink_format(struct dedup_sink *sink, const char *format, ...);
+
+uint32_t
+dedup_sink_vformat(struct dedup_sink *sink, const char *format, va_list list);
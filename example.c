@@ -1,7 +1,7 @@
-#include <string.h>
 
 #include "example.h"
 #include "parse_printf.h"
+#include "printf_string.h"
 
 struct callback_info {
     char *buffer_in;
@@ -25,81 +25,64 @@ format_to_buffer(char *const buffer_in,
     return result;
 }
 
-static uint32_t
+static size_t
 format_to_buffer_write_ch_callback(
     struct printf_spec_info *const spec_info,
     void *const info,
     const char ch,
-    uint32_t amount,
+    size_t amount,
     bool *const should_continue_out)
 {
     (void)spec_info;
 
     struct callback_info *const cb_info = (struct callback_info *)info;
     const uint32_t old_used = cb_info->buffer_used;
+    const uint32_t room = cb_info->buffer_size - old_used;
 
-    uint32_t new_used = old_used;
-    if (__builtin_add_overflow(new_used, amount, &new_used)) {
-        *should_continue_out = false;
-        return 0;
-    }
-
-    const uint32_t buffer_size = cb_info->buffer_size;
-    if (new_used >= buffer_size) {
+    if (amount >= room) {
         /*
          * Truncate amount to just the space left if we don't have enough space
          * in the buffer to copy the whole string.
          */
 
-        amount = buffer_size - old_used;
+        amount = room;
         *should_continue_out = false;
-
-        cb_info->buffer_used = old_used + amount;
-    } else {
-        cb_info->buffer_used = new_used;
     }
 
-    memset(cb_info->buffer_in + old_used, ch, amount);
+    cb_info->buffer_used = old_used + (uint32_t)amount;
+
+    printf_memset(cb_info->buffer_in + old_used, ch, amount);
     return amount;
 }
 
-static uint32_t
+static size_t
 format_to_buffer_write_string_callback(
     struct printf_spec_info *const spec_info,
     void *const info,
     const char *const string,
-    const uint32_t length,
+    const size_t length,
     bool *const should_continue_out)
 {
     (void)spec_info;
 
     struct callback_info *const cb_info = (struct callback_info *)info;
     const uint32_t old_used = cb_info->buffer_used;
+    const uint32_t room = cb_info->buffer_size - old_used;
 
-    uint32_t new_used = old_used;
-    if (__builtin_add_overflow(new_used, length, &new_used)) {
-        *should_continue_out = false;
-        return 0;
-    }
-
-    const uint32_t buffer_size = cb_info->buffer_size;
-    uint32_t amount = length;
-
-    if (new_used >= buffer_size) {
+    size_t amount = length;
+    if (amount >= room) {
         /*
          * Truncate amount to just the space left if we don't have enough space
          * in the buffer to copy the whole string.
          */
 
-        amount = buffer_size - old_used;
+        amount = room;
         *should_continue_out = false;
-
-        cb_info->buffer_used = old_used + amount;
-    } else {
-        cb_info->buffer_used = new_used;
     }
 
-    memcpy(cb_info->buffer_in + old_used, string, amount);
+    cb_info->buffer_used = old_used + (uint32_t)amount;
+
+    printf_memcpy(cb_info->buffer_in + old_used, string, amount);
     return amount;
 }
 
@@ -108,6 +91,41 @@ vformat_to_buffer(char *const buffer_in,
                   const uint32_t buffer_len,
                   const char *const format,
                   va_list list)
+{
+    return vformat_to_buffer_with_arg_table(buffer_in,
+                                            buffer_len,
+                                            /*table=*/NULL,
+                                            format,
+                                            list);
+}
+
+uint32_t
+format_to_buffer_with_arg_table(char *const buffer_in,
+                                const uint32_t buffer_len,
+                                const struct printf_arg_table *const table,
+                                const char *const format,
+                                ...)
+{
+    va_list list;
+    va_start(list, format);
+
+    const uint32_t result =
+        vformat_to_buffer_with_arg_table(buffer_in,
+                                         buffer_len,
+                                         table,
+                                         format,
+                                         list);
+
+    va_end(list);
+    return result;
+}
+
+uint32_t
+vformat_to_buffer_with_arg_table(char *const buffer_in,
+                                 const uint32_t buffer_len,
+                                 const struct printf_arg_table *const table,
+                                 const char *const format,
+                                 va_list list)
 {
     if (buffer_len == 0) {
         return 0;
@@ -121,22 +139,76 @@ vformat_to_buffer(char *const buffer_in,
     };
 
     const uint32_t length =
-        parse_printf_format(format_to_buffer_write_ch_callback,
-                            &cb_info,
-                            format_to_buffer_write_string_callback,
-                            &cb_info,
-                            format,
-                            list);
+        (uint32_t)parse_printf_format_with_arg_table64(
+            format_to_buffer_write_ch_callback,
+            &cb_info,
+            format_to_buffer_write_string_callback,
+            &cb_info,
+            format,
+            table,
+            list);
+
+    cb_info.buffer_in[cb_info.buffer_used] = '\0';
+    return length;
+}
+
+uint32_t
+format_to_buffer_compiled(char *const buffer_in,
+                          const uint32_t buffer_len,
+                          const struct printf_compiled_format *const compiled,
+                          const char *const format,
+                          ...)
+{
+    va_list list;
+    va_start(list, format);
+
+    const uint32_t result =
+        vformat_to_buffer_compiled(buffer_in,
+                                   buffer_len,
+                                   compiled,
+                                   format,
+                                   list);
+
+    va_end(list);
+    return result;
+}
+
+uint32_t
+vformat_to_buffer_compiled(char *const buffer_in,
+                           const uint32_t buffer_len,
+                           const struct printf_compiled_format *const compiled,
+                           const char *const format,
+                           va_list list)
+{
+    if (buffer_len == 0) {
+        return 0;
+    }
+
+    struct callback_info cb_info = {
+        .buffer_in = buffer_in,
+        .buffer_used = 0,
+        .buffer_size = buffer_len - 1
+    };
+
+    const uint32_t length =
+        (uint32_t)parse_printf_compiled64(
+            format_to_buffer_write_ch_callback,
+            &cb_info,
+            format_to_buffer_write_string_callback,
+            &cb_info,
+            compiled,
+            format,
+            list);
 
     cb_info.buffer_in[cb_info.buffer_used] = '\0';
     return length;
 }
 
-static uint32_t
+static size_t
 get_length_ch_callback(struct printf_spec_info *const spec_info,
                        void *const cb_info,
                        const char ch,
-                       const uint32_t times,
+                       const size_t times,
                        bool *const should_continue_out)
 {
     (void)spec_info;
@@ -148,11 +220,11 @@ get_length_ch_callback(struct printf_spec_info *const spec_info,
     return times;
 }
 
-static uint32_t
+static size_t
 get_length_string_callback(struct printf_spec_info *const spec_info,
                            void *const cb_info,
                            const char *const string,
-                           const uint32_t length,
+                           const size_t length,
                            bool *const should_continue_out)
 {
     (void)spec_info;
@@ -175,12 +247,26 @@ uint32_t get_length_of_printf_format(const char *const fmt, ...) {
 }
 
 uint32_t get_length_of_printf_vformat(const char *const fmt, va_list list) {
-    const uint32_t length =
-        parse_printf_format(get_length_ch_callback,
-                            /*char_cb_info=*/NULL,
-                            get_length_string_callback,
-                            /*string_cb_info=*/NULL,
-                            fmt,
-                            list);
+    return (uint32_t)get_length_of_printf_vformat64(fmt, list);
+}
+
+uint64_t get_length_of_printf_format64(const char *const fmt, ...) {
+    va_list list;
+    va_start(list, fmt);
+
+    const uint64_t result = get_length_of_printf_vformat64(fmt, list);
+
+    va_end(list);
+    return result;
+}
+
+uint64_t get_length_of_printf_vformat64(const char *const fmt, va_list list) {
+    const uint64_t length =
+        parse_printf_format64(get_length_ch_callback,
+                              /*char_cb_info=*/NULL,
+                              get_length_string_callback,
+                              /*string_cb_info=*/NULL,
+                              fmt,
+                              list);
     return length;
 }
\ No newline at end of file
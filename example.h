@@ -38,7 +38,56 @@ vformat_to_buffer(char *buffer_in,
                   const char *format,
                   va_list list);
 
+struct printf_arg_table;
+
+/*
+ * Same as format_to_buffer(), but takes a positional-argument table built
+ * ahead of time with printf_arg_table_init().
+ */
+
+uint32_t
+format_to_buffer_with_arg_table(char *buffer_in,
+                                uint32_t buffer_len,
+                                const struct printf_arg_table *table,
+                                const char *format,
+                                ...);
+
+uint32_t
+vformat_to_buffer_with_arg_table(char *buffer_in,
+                                 uint32_t buffer_len,
+                                 const struct printf_arg_table *table,
+                                 const char *format,
+                                 va_list list);
+
+struct printf_compiled_format;
+
+/*
+ * Same as format_to_buffer(), but formats from a table parsed ahead of time,
+ * if compiled isn't NULL. See printf_compiled.h.
+ */
+
+__attribute__((format(printf, 4, 5)))
+uint32_t
+format_to_buffer_compiled(char *buffer_in,
+                          uint32_t buffer_len,
+                          const struct printf_compiled_format *compiled,
+                          const char *format,
+                          ...);
+
+uint32_t
+vformat_to_buffer_compiled(char *buffer_in,
+                           uint32_t buffer_len,
+                           const struct printf_compiled_format *compiled,
+                           const char *format,
+                           va_list list);
+
 __attribute__((format(printf, 1, 2)))
 uint32_t get_length_of_printf_format(const char *fmt, ...);
 
 uint32_t get_length_of_printf_vformat(const char *fmt, va_list list);
+
+// The same, but counted in 64 bits, for output that can pass 4 GiB.
+__attribute__((format(printf, 1, 2)))
+uint64_t get_length_of_printf_format64(const char *fmt, ...);
+
+uint64_t get_length_of_printf_vformat64(const char *fmt, va_list list);
@@ -0,0 +1,297 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "fd_sink.h"
+
+/*
+ * Write out all of iov, retrying on partial writes and on EINTR.
+ */
+
+static bool
+fd_sink_write_iov(struct fd_sink *const sink,
+                  struct iovec *iov,
+                  int iov_count)
+{
+    while (iov_count != 0) {
+        const ssize_t written = writev(sink->fd, iov, iov_count);
+        sink->syscall_count++;
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            sink->failed = true;
+            return false;
+        }
+
+        size_t left = (size_t)written;
+        while (iov_count != 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+
+            iov++;
+            iov_count--;
+        }
+
+        if (iov_count != 0) {
+            iov->iov_base = (char *)iov->iov_base + left;
+            iov->iov_len -= left;
+        }
+    }
+
+    return true;
+}
+
+void
+fd_sink_init(struct fd_sink *const sink,
+             const int fd,
+             char *const buffer,
+             const uint32_t buffer_size,
+             const enum fd_sink_flush_policy policy)
+{
+    sink->fd = fd;
+    sink->policy = policy;
+    sink->buffer = buffer;
+    sink->buffer_used = 0;
+    sink->buffer_size = buffer_size;
+    sink->failed = false;
+    sink->syscall_count = 0;
+}
+
+bool fd_sink_flush(struct fd_sink *const sink) {
+    if (sink->failed) {
+        return false;
+    }
+
+    if (sink->buffer_used == 0) {
+        return true;
+    }
+
+    struct iovec iov = {
+        .iov_base = sink->buffer,
+        .iov_len = sink->buffer_used
+    };
+
+    sink->buffer_used = 0;
+    return fd_sink_write_iov(sink, &iov, /*iov_count=*/1);
+}
+
+/*
+ * The callbacks' implementations, with lengths as wide as the 64-bit
+ * callbacks'. The 32-bit callbacks never pass more than they can return.
+ */
+
+static size_t
+fd_sink_write_ch(struct fd_sink *const sink,
+                 const char ch,
+                 const size_t times,
+                 bool *const should_continue_out)
+{
+    if (sink->failed) {
+        *should_continue_out = false;
+        return 0;
+    }
+
+    size_t left = times;
+    while (left != 0) {
+        uint32_t room = sink->buffer_size - sink->buffer_used;
+        if (room == 0) {
+            if (sink->policy == FD_SINK_FLUSH_MANUAL) {
+                *should_continue_out = false;
+                return times - left;
+            }
+
+            if (!fd_sink_flush(sink)) {
+                *should_continue_out = false;
+                return times - left;
+            }
+
+            room = sink->buffer_size;
+        }
+
+        const uint32_t amount = left < room ? (uint32_t)left : room;
+        memset(sink->buffer + sink->buffer_used, ch, amount);
+
+        sink->buffer_used += amount;
+        left -= amount;
+    }
+
+    if (sink->policy == FD_SINK_FLUSH_ON_NEWLINE && ch == '\n') {
+        if (!fd_sink_flush(sink)) {
+            *should_continue_out = false;
+        }
+    }
+
+    return times;
+}
+
+static size_t
+fd_sink_write_string(struct fd_sink *const sink,
+                     const char *const string,
+                     const size_t length,
+                     bool *const should_continue_out)
+{
+    if (sink->failed) {
+        *should_continue_out = false;
+        return 0;
+    }
+
+    const uint32_t room = sink->buffer_size - sink->buffer_used;
+    if (length <= room) {
+        memcpy(sink->buffer + sink->buffer_used, string, length);
+        sink->buffer_used += (uint32_t)length;
+
+        if (sink->policy == FD_SINK_FLUSH_ON_NEWLINE
+            && memchr(string, '\n', length) != NULL)
+        {
+            if (!fd_sink_flush(sink)) {
+                *should_continue_out = false;
+            }
+        }
+
+        return length;
+    }
+
+    if (sink->policy == FD_SINK_FLUSH_MANUAL) {
+        /*
+         * Truncate to just the space left if we aren't allowed to write the
+         * buffer out.
+         */
+
+        memcpy(sink->buffer + sink->buffer_used, string, room);
+        sink->buffer_used += room;
+
+        *should_continue_out = false;
+        return room;
+    }
+
+    /*
+     * The string doesn't fit, so send the buffered data and the string to the
+     * kernel together, instead of copying the string into the buffer.
+     */
+
+    struct iovec iov[2] = {
+        {
+            .iov_base = sink->buffer,
+            .iov_len = sink->buffer_used
+        },
+        {
+            .iov_base = (void *)string,
+            .iov_len = length
+        }
+    };
+
+    const bool has_buffered = sink->buffer_used != 0;
+    sink->buffer_used = 0;
+
+    if (!fd_sink_write_iov(sink,
+                           has_buffered ? iov : iov + 1,
+                           has_buffered ? 2 : 1))
+    {
+        *should_continue_out = false;
+        return 0;
+    }
+
+    return length;
+}
+
+uint32_t
+fd_sink_write_ch_callback(struct printf_spec_info *const spec_info,
+                          void *const info,
+                          const char ch,
+                          const uint32_t times,
+                          bool *const should_continue_out)
+{
+    (void)spec_info;
+    return (uint32_t)fd_sink_write_ch((struct fd_sink *)info,
+                                      ch,
+                                      times,
+                                      should_continue_out);
+}
+
+uint32_t
+fd_sink_write_string_callback(struct printf_spec_info *const spec_info,
+                              void *const info,
+                              const char *const string,
+                              const uint32_t length,
+                              bool *const should_continue_out)
+{
+    (void)spec_info;
+    return (uint32_t)fd_sink_write_string((struct fd_sink *)info,
+                                          string,
+                                          length,
+                                          should_continue_out);
+}
+
+size_t
+fd_sink_write_ch_callback64(struct printf_spec_info *const spec_info,
+                            void *const info,
+                            const char ch,
+                            const size_t times,
+                            bool *const should_continue_out)
+{
+    (void)spec_info;
+    return fd_sink_write_ch((struct fd_sink *)info,
+                            ch,
+                            times,
+                            should_continue_out);
+}
+
+size_t
+fd_sink_write_string_callback64(struct printf_spec_info *const spec_info,
+                                void *const info,
+                                const char *const string,
+                                const size_t length,
+                                bool *const should_continue_out)
+{
+    (void)spec_info;
+    return fd_sink_write_string((struct fd_sink *)info,
+                                string,
+                                length,
+                                should_continue_out);
+}
+
+uint32_t
+fd_sink_format(struct fd_sink *const sink, const char *const format, ...) {
+    va_list list;
+    va_start(list, format);
+
+    const uint32_t result = fd_sink_vformat(sink, format, list);
+
+    va_end(list);
+    return result;
+}
+
+uint32_t
+fd_sink_vformat(struct fd_sink *const sink,
+                const char *const format,
+                va_list list)
+{
+    return (uint32_t)fd_sink_vformat64(sink, format, list);
+}
+
+uint64_t
+fd_sink_format64(struct fd_sink *const sink, const char *const format, ...) {
+    va_list list;
+    va_start(list, format);
+
+    const uint64_t result = fd_sink_vformat64(sink, format, list);
+
+    va_end(list);
+    return result;
+}
+
+uint64_t
+fd_sink_vformat64(struct fd_sink *const sink,
+                  const char *const format,
+                  va_list list)
+{
+    return parse_printf_format64(fd_sink_write_ch_callback64,
+                                 sink,
+                                 fd_sink_write_string_callback64,
+                                 sink,
+                                 format,
+                                 list);
+}
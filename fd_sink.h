@@ -0,0 +1,119 @@
+/*
+Copyright (c) 2023 Suhas Pai
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "parse_printf.h"
+
+/*
+ * A sink that buffers formatted output in a caller-supplied buffer, and writes
+ * it out to a file-descriptor.
+ *
+ * Strings that don't fit in the buffer are sent straight to the kernel along
+ * with the buffered data through writev(), without being copied.
+ */
+
+enum fd_sink_flush_policy {
+    // Flush whenever a newline is written, like a line-buffered FILE.
+    FD_SINK_FLUSH_ON_NEWLINE,
+
+    // Only flush when the buffer is full.
+    FD_SINK_FLUSH_ON_FULL,
+
+    // Never write to the fd except in fd_sink_flush(). Output that doesn't fit
+    // in the buffer is truncated.
+    FD_SINK_FLUSH_MANUAL,
+};
+
+struct fd_sink {
+    int fd;
+    enum fd_sink_flush_policy policy;
+
+    char *buffer;
+    uint32_t buffer_used;
+    uint32_t buffer_size;
+
+    // Set if a write to fd failed. Nothing else is written once this is set.
+    bool failed;
+
+    // Number of write()/writev() calls made, for measuring.
+    uint64_t syscall_count;
+};
+
+void
+fd_sink_init(struct fd_sink *sink,
+             int fd,
+             char *buffer,
+             uint32_t buffer_size,
+             enum fd_sink_flush_policy policy);
+
+// Returns false if the buffered output couldn't be written out.
+bool fd_sink_flush(struct fd_sink *sink);
+
+uint32_t
+fd_sink_write_ch_callback(struct printf_spec_info *spec_info,
+                          void *info,
+                          char ch,
+                          uint32_t times,
+                          bool *should_continue_out);
+
+uint32_t
+fd_sink_write_string_callback(struct printf_spec_info *spec_info,
+                              void *info,
+                              const char *string,
+                              uint32_t length,
+                              bool *should_continue_out);
+
+__attribute__((format(printf, 2, 3)))
+uint32_t fd_sink_format(struct fd_sink *sink, const char *format, ...);
+
+uint32_t
+fd_sink_vformat(struct fd_sink *sink, const char *format, va_list list);
+
+/*
+ * The same, but with the 64-bit callbacks from parse_printf.h, for output
+ * that can pass 4 GiB.
+ */
+
+size_t
+fd_sink_write_ch_callback64(struct printf_spec_info *spec_info,
+                            void *info,
+                            char ch,
+                            size_t times,
+                            bool *should_continue_out);
+
+size_t
+fd_sink_write_string_callback64(struct printf_spec_info *spec_info,
+                                void *info,
+                                const char *string,
+                                size_t length,
+                                bool *should_continue_out);
+
+__attribute__((format(printf, 2, 3)))
+uint64_t fd_sink_format64(struct fd_sink *sink, const char *format, ...);
+
+uint64_t
+fd_sink_vformat64(struct fd_sink *sink, const char *format, va_list list);
@@ -0,0 +1,467 @@
+#include <string.h>
+
+#include "lz4_sink.h"
+
+/*
+ * LZ4 block format constants. The last LZ4_LAST_LITERALS bytes of a block are
+ * always literals, and no match may start in the last LZ4_MATCH_LIMIT bytes.
+ */
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MATCH_LIMIT 12
+#define LZ4_MAX_OFFSET 65535
+
+static inline uint32_t read_u32(const uint8_t *const ptr) {
+    uint32_t result = 0;
+    memcpy(&result, ptr, sizeof(result));
+
+    return result;
+}
+
+static inline uint32_t lz4_hash(const uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - LZ4_SINK_HASH_LOG);
+}
+
+static inline uint8_t *
+write_length_bytes(uint8_t *out, uint32_t length) {
+    for (; length >= 255; length -= 255) {
+        *out++ = 255;
+    }
+
+    *out++ = (uint8_t)length;
+    return out;
+}
+
+/*
+ * Write one sequence of literals followed by a match (or only literals, if
+ * match_length is 0). Returns NULL if the sequence wouldn't fit before end.
+ */
+
+static uint8_t *
+write_sequence(uint8_t *out,
+               const uint8_t *const end,
+               const uint8_t *const literals,
+               const uint32_t literal_length,
+               const uint32_t offset,
+               const uint32_t match_length)
+{
+    const uint32_t worst_case =
+        1 + (literal_length / 255 + 1) + literal_length + 2
+        + (match_length / 255 + 1);
+
+    if ((uint32_t)(end - out) < worst_case) {
+        return NULL;
+    }
+
+    uint8_t *const token = out++;
+    *token = 0;
+
+    if (literal_length >= 15) {
+        *token = 15 << 4;
+        out = write_length_bytes(out, literal_length - 15);
+    } else {
+        *token = (uint8_t)(literal_length << 4);
+    }
+
+    memcpy(out, literals, literal_length);
+    out += literal_length;
+
+    if (match_length == 0) {
+        return out;
+    }
+
+    *out++ = (uint8_t)offset;
+    *out++ = (uint8_t)(offset >> 8);
+
+    const uint32_t extra_length = match_length - LZ4_MIN_MATCH;
+    if (extra_length >= 15) {
+        *token |= 15;
+        out = write_length_bytes(out, extra_length - 15);
+    } else {
+        *token |= (uint8_t)extra_length;
+    }
+
+    return out;
+}
+
+/*
+ * Compress src into out. Returns the compressed length, or 0 if it doesn't fit
+ * in out_capacity bytes.
+ */
+
+static uint32_t
+compress_block(struct lz4_sink *const sink,
+               const uint8_t *const src,
+               const uint32_t length,
+               uint8_t *const out,
+               const uint32_t out_capacity)
+{
+    uint8_t *op = out;
+    const uint8_t *const out_end = out + out_capacity;
+
+    uint32_t anchor = 0;
+    if (length > LZ4_MATCH_LIMIT) {
+        memset(sink->hash_table, 0, sizeof(sink->hash_table));
+
+        const uint32_t match_start_limit = length - LZ4_MATCH_LIMIT;
+        const uint32_t match_end_limit = length - LZ4_LAST_LITERALS;
+
+        uint32_t ip = 0;
+        while (ip < match_start_limit) {
+            const uint32_t sequence = read_u32(src + ip);
+            const uint32_t hash = lz4_hash(sequence);
+            const uint32_t ref = sink->hash_table[hash];
+
+            sink->hash_table[hash] = (uint16_t)ip;
+            if (ref >= ip
+                || ip - ref > LZ4_MAX_OFFSET
+                || read_u32(src + ref) != sequence)
+            {
+                ip++;
+                continue;
+            }
+
+            uint32_t match_length = LZ4_MIN_MATCH;
+            while (ip + match_length < match_end_limit
+                   && src[ref + match_length] == src[ip + match_length])
+            {
+                match_length++;
+            }
+
+            op = write_sequence(op,
+                                out_end,
+                                src + anchor,
+                                ip - anchor,
+                                ip - ref,
+                                match_length);
+            if (op == NULL) {
+                return 0;
+            }
+
+            ip += match_length;
+            anchor = ip;
+        }
+    }
+
+    op = write_sequence(op,
+                        out_end,
+                        src + anchor,
+                        length - anchor,
+                        /*offset=*/0,
+                        /*match_length=*/0);
+    if (op == NULL) {
+        return 0;
+    }
+
+    return (uint32_t)(op - out);
+}
+
+static inline void write_u32_le(uint8_t *const out, const uint32_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    out[2] = (uint8_t)(value >> 16);
+    out[3] = (uint8_t)(value >> 24);
+}
+
+static bool emit_block(struct lz4_sink *const sink) {
+    const uint32_t length = sink->input_used;
+    if (length == 0) {
+        return !sink->stopped;
+    }
+
+    sink->input_used = 0;
+    if (sink->stopped) {
+        return false;
+    }
+
+    uint8_t *const payload = sink->frame + LZ4_SINK_FRAME_HEADER_SIZE;
+    uint32_t payload_length =
+        compress_block(sink, sink->input, length, payload, length - 1);
+
+    // Store the block as-is if it didn't compress.
+    uint32_t header = payload_length;
+    if (payload_length == 0) {
+        memcpy(payload, sink->input, length);
+
+        payload_length = length;
+        header = length | LZ4_SINK_FRAME_RAW;
+    }
+
+    write_u32_le(sink->frame, header);
+
+    const uint32_t frame_length = LZ4_SINK_FRAME_HEADER_SIZE + payload_length;
+    bool should_continue = true;
+
+    sink->bytes_out +=
+        sink->write_string_cb(NULL,
+                              sink->string_cb_info,
+                              (const char *)sink->frame,
+                              frame_length,
+                              &should_continue);
+
+    if (!should_continue) {
+        sink->stopped = true;
+    }
+
+    return true;
+}
+
+void
+lz4_sink_init(struct lz4_sink *const sink,
+              const printf_write_string_callback_t write_string_cb,
+              void *const string_cb_info)
+{
+    sink->write_string_cb = write_string_cb;
+    sink->string_cb_info = string_cb_info;
+
+    sink->input_used = 0;
+    sink->stopped = false;
+    sink->bytes_in = 0;
+    sink->bytes_out = 0;
+}
+
+bool lz4_sink_flush(struct lz4_sink *const sink) {
+    return emit_block(sink);
+}
+
+uint32_t
+lz4_sink_write_ch_callback(struct printf_spec_info *const spec_info,
+                           void *const info,
+                           const char ch,
+                           const uint32_t times,
+                           bool *const should_continue_out)
+{
+    (void)spec_info;
+
+    struct lz4_sink *const sink = (struct lz4_sink *)info;
+    uint32_t left = times;
+
+    while (left != 0) {
+        if (sink->input_used == LZ4_SINK_BLOCK_SIZE) {
+            emit_block(sink);
+        }
+
+        if (sink->stopped) {
+            *should_continue_out = false;
+            break;
+        }
+
+        const uint32_t room = LZ4_SINK_BLOCK_SIZE - sink->input_used;
+        const uint32_t amount = left < room ? left : room;
+
+        memset(sink->input + sink->input_used, ch, amount);
+
+        sink->input_used += amount;
+        left -= amount;
+    }
+
+    sink->bytes_in += times - left;
+    return times - left;
+}
+
+uint32_t
+lz4_sink_write_string_callback(struct printf_spec_info *const spec_info,
+                               void *const info,
+                               const char *const string,
+                               const uint32_t length,
+                               bool *const should_continue_out)
+{
+    (void)spec_info;
+
+    struct lz4_sink *const sink = (struct lz4_sink *)info;
+    uint32_t done = 0;
+
+    while (done != length) {
+        if (sink->input_used == LZ4_SINK_BLOCK_SIZE) {
+            emit_block(sink);
+        }
+
+        if (sink->stopped) {
+            *should_continue_out = false;
+            break;
+        }
+
+        const uint32_t room = LZ4_SINK_BLOCK_SIZE - sink->input_used;
+        const uint32_t left = length - done;
+        const uint32_t amount = left < room ? left : room;
+
+        memcpy(sink->input + sink->input_used, string + done, amount);
+
+        sink->input_used += amount;
+        done += amount;
+    }
+
+    sink->bytes_in += done;
+    return done;
+}
+
+uint32_t
+lz4_sink_format(struct lz4_sink *const sink, const char *const format, ...) {
+    va_list list;
+    va_start(list, format);
+
+    const uint32_t result = lz4_sink_vformat(sink, format, list);
+
+    va_end(list);
+    return result;
+}
+
+uint32_t
+lz4_sink_vformat(struct lz4_sink *const sink,
+                 const char *const format,
+                 va_list list)
+{
+    const uint32_t length =
+        parse_printf_format(lz4_sink_write_ch_callback,
+                            sink,
+                            lz4_sink_write_string_callback,
+                            sink,
+                            format,
+                            list);
+    return length;
+}
+
+static inline bool
+read_length_bytes(const uint8_t **const ip_in,
+                  const uint8_t *const end,
+                  uint32_t *const length_in_out)
+{
+    const uint8_t *ip = *ip_in;
+    uint8_t byte = 0;
+
+    do {
+        if (ip == end) {
+            return false;
+        }
+
+        byte = *ip++;
+        if (__builtin_add_overflow(*length_in_out, byte, length_in_out)) {
+            return false;
+        }
+    } while (byte == 255);
+
+    *ip_in = ip;
+    return true;
+}
+
+static int64_t
+decode_block(const uint8_t *ip,
+             const uint32_t length,
+             uint8_t *const out,
+             const uint64_t out_capacity)
+{
+    const uint8_t *const end = ip + length;
+    uint64_t op = 0;
+
+    while (ip != end) {
+        const uint8_t token = *ip++;
+
+        uint32_t literal_length = token >> 4;
+        if (literal_length == 15) {
+            if (!read_length_bytes(&ip, end, &literal_length)) {
+                return -1;
+            }
+        }
+
+        if ((uint64_t)(end - ip) < literal_length
+            || out_capacity - op < literal_length)
+        {
+            return -1;
+        }
+
+        memcpy(out + op, ip, literal_length);
+
+        ip += literal_length;
+        op += literal_length;
+
+        // The last sequence has only literals.
+        if (ip == end) {
+            break;
+        }
+
+        if (end - ip < 2) {
+            return -1;
+        }
+
+        const uint32_t offset = (uint32_t)ip[0] | ((uint32_t)ip[1] << 8);
+        ip += 2;
+
+        uint32_t match_length = token & 15;
+        if (match_length == 15) {
+            if (!read_length_bytes(&ip, end, &match_length)) {
+                return -1;
+            }
+        }
+
+        match_length += LZ4_MIN_MATCH;
+        if (offset == 0 || offset > op || out_capacity - op < match_length) {
+            return -1;
+        }
+
+        // Matches can overlap their own output, so copy byte-by-byte.
+        const uint8_t *match = out + op - offset;
+        for (uint32_t i = 0; i != match_length; i++) {
+            out[op + i] = match[i];
+        }
+
+        op += match_length;
+    }
+
+    return (int64_t)op;
+}
+
+int64_t
+lz4_sink_decode(const uint8_t *const frames,
+                const uint64_t frames_length,
+                uint8_t *const out,
+                const uint64_t out_capacity)
+{
+    uint64_t ip = 0;
+    uint64_t op = 0;
+
+    while (ip != frames_length) {
+        if (frames_length - ip < LZ4_SINK_FRAME_HEADER_SIZE) {
+            return -1;
+        }
+
+        const uint8_t *const header_ptr = frames + ip;
+        const uint32_t header =
+            (uint32_t)header_ptr[0]
+            | ((uint32_t)header_ptr[1] << 8)
+            | ((uint32_t)header_ptr[2] << 16)
+            | ((uint32_t)header_ptr[3] << 24);
+
+        ip += LZ4_SINK_FRAME_HEADER_SIZE;
+
+        const uint32_t payload_length = header & ~LZ4_SINK_FRAME_RAW;
+        if (frames_length - ip < payload_length) {
+            return -1;
+        }
+
+        if ((header & LZ4_SINK_FRAME_RAW) != 0) {
+            if (out_capacity - op < payload_length) {
+                return -1;
+            }
+
+            memcpy(out + op, frames + ip, payload_length);
+            op += payload_length;
+        } else {
+            const int64_t decoded =
+                decode_block(frames + ip,
+                             payload_length,
+                             out + op,
+                             out_capacity - op);
+
+            if (decoded < 0) {
+                return -1;
+            }
+
+            op += (uint64_t)decoded;
+        }
+
+        ip += payload_length;
+    }
+
+    return (int64_t)op;
+}
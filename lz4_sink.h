@@ -0,0 +1,110 @@
+/*
+Copyright (c) 2023 Suhas Pai
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "parse_printf.h"
+
+/*
+ * A sink stage that compresses the formatted stream with an LZ4-block-style
+ * compressor, and forwards framed blocks to a downstream sink.
+ *
+ * Input is gathered into fixed-size blocks, and every block is compressed
+ * independently, so the match window never goes past the current block and
+ * memory use is fixed by the size of struct lz4_sink.
+ *
+ * Each frame is a 4-byte little-endian header followed by the payload. The
+ * header holds the payload length, with LZ4_SINK_FRAME_RAW set if the block
+ * didn't compress and is stored as-is.
+ */
+
+#define LZ4_SINK_BLOCK_SIZE 16384
+#define LZ4_SINK_HASH_LOG 12
+
+#define LZ4_SINK_FRAME_HEADER_SIZE 4
+#define LZ4_SINK_FRAME_RAW 0x80000000u
+
+// Worst-case size of a frame for one full block.
+#define LZ4_SINK_MAX_FRAME_SIZE \
+    (LZ4_SINK_FRAME_HEADER_SIZE + LZ4_SINK_BLOCK_SIZE)
+
+struct lz4_sink {
+    // The downstream sink. Frames are binary, so they're always forwarded
+    // through the string callback.
+    printf_write_string_callback_t write_string_cb;
+    void *string_cb_info;
+
+    uint32_t input_used;
+    uint8_t input[LZ4_SINK_BLOCK_SIZE];
+    uint8_t frame[LZ4_SINK_MAX_FRAME_SIZE];
+    uint16_t hash_table[1 << LZ4_SINK_HASH_LOG];
+
+    // Set once the downstream sink stops accepting output.
+    bool stopped;
+
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+};
+
+void
+lz4_sink_init(struct lz4_sink *sink,
+              printf_write_string_callback_t write_string_cb,
+              void *string_cb_info);
+
+// Compress and forward any buffered input as a final (partial) block.
+bool lz4_sink_flush(struct lz4_sink *sink);
+
+uint32_t
+lz4_sink_write_ch_callback(struct printf_spec_info *spec_info,
+                           void *info,
+                           char ch,
+                           uint32_t times,
+                           bool *should_continue_out);
+
+uint32_t
+lz4_sink_write_string_callback(struct printf_spec_info *spec_info,
+                               void *info,
+                               const char *string,
+                               uint32_t length,
+                               bool *should_continue_out);
+
+__attribute__((format(printf, 2, 3)))
+uint32_t lz4_sink_format(struct lz4_sink *sink, const char *format, ...);
+
+uint32_t
+lz4_sink_vformat(struct lz4_sink *sink, const char *format, va_list list);
+
+/*
+ * Decode a stream of frames produced by an lz4_sink into out. Returns the
+ * decoded length, or -1 if the stream is malformed or doesn't fit in out.
+ */
+
+int64_t
+lz4_sink_decode(const uint8_t *frames,
+                uint64_t frames_length,
+                uint8_t *out,
+                uint64_t out_capacity);
@@ -0,0 +1,324 @@
+#if defined(__linux__)
+    #define _GNU_SOURCE // For mremap()
+#endif /* defined(__linux__) */
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif /* defined(__SSE2__) */
+
+#include "mmap_sink.h"
+
+static inline struct mmap_sink_header *
+mmap_sink_get_header(const struct mmap_sink *const sink) {
+    return (struct mmap_sink_header *)sink->map;
+}
+
+static bool
+mmap_sink_remap(struct mmap_sink *const sink, const uint64_t new_size) {
+    if (ftruncate(sink->fd, (off_t)new_size) != 0) {
+        return false;
+    }
+
+#if defined(__linux__)
+    void *const map =
+        mremap(sink->map, sink->map_size, new_size, MREMAP_MAYMOVE);
+#else
+    munmap(sink->map, sink->map_size);
+    void *const map =
+        mmap(NULL,
+             new_size,
+             PROT_READ | PROT_WRITE,
+             MAP_SHARED,
+             sink->fd,
+             /*offset=*/0);
+#endif /* defined(__linux__) */
+
+    if (map == MAP_FAILED) {
+#if !defined(__linux__)
+        // The old mapping is already gone.
+        sink->map = NULL;
+#endif /* !defined(__linux__) */
+        return false;
+    }
+
+    sink->map = (char *)map;
+    sink->map_size = new_size;
+
+    return true;
+}
+
+/*
+ * Make sure there's room for length more bytes of data, growing the file by
+ * whole chunks if there isn't.
+ */
+
+static bool
+mmap_sink_reserve(struct mmap_sink *const sink, const uint32_t length) {
+    if (__builtin_expect(sink->failed, 0)) {
+        return false;
+    }
+
+    const uint64_t needed = MMAP_SINK_HEADER_SIZE + sink->used + length;
+    if (__builtin_expect(needed <= sink->map_size, 1)) {
+        return true;
+    }
+
+    const uint64_t chunk_count =
+        (needed - sink->map_size + sink->chunk_size - 1) / sink->chunk_size;
+
+    if (!mmap_sink_remap(sink,
+                         sink->map_size + (chunk_count * sink->chunk_size)))
+    {
+        sink->failed = true;
+        return false;
+    }
+
+    return true;
+}
+
+static void
+copy_to_map(struct mmap_sink *const sink,
+            char *dst,
+            const char *src,
+            uint32_t length)
+{
+#if defined(__SSE2__)
+    if (sink->use_non_temporal_stores
+        && length >= MMAP_SINK_NON_TEMPORAL_THRESHOLD)
+    {
+        // Stream large copies past the cache, since we'll never read them.
+        const uint32_t misalignment = (uintptr_t)dst & 15;
+        if (misalignment != 0) {
+            const uint32_t head = 16 - misalignment;
+            memcpy(dst, src, head);
+
+            dst += head;
+            src += head;
+            length -= head;
+        }
+
+        for (; length >= 16; length -= 16) {
+            const __m128i value =
+                _mm_loadu_si128((const __m128i *)(const void *)src);
+
+            _mm_stream_si128((__m128i *)(void *)dst, value);
+
+            dst += 16;
+            src += 16;
+        }
+    }
+#else
+    (void)sink;
+#endif /* defined(__SSE2__) */
+
+    memcpy(dst, src, length);
+}
+
+bool
+mmap_sink_open(struct mmap_sink *const sink,
+               const char *const path,
+               const uint64_t chunk_size,
+               const bool use_non_temporal_stores)
+{
+    memset(sink, 0, sizeof(*sink));
+    if (chunk_size == 0) {
+        return false;
+    }
+
+    sink->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (sink->fd < 0) {
+        return false;
+    }
+
+    sink->chunk_size = chunk_size;
+    sink->use_non_temporal_stores = use_non_temporal_stores;
+
+    struct stat st;
+    if (fstat(sink->fd, &st) != 0) {
+        close(sink->fd);
+        return false;
+    }
+
+    uint64_t file_size = (uint64_t)st.st_size;
+    const bool is_new = file_size == 0;
+
+    if (is_new) {
+        file_size = MMAP_SINK_HEADER_SIZE + chunk_size;
+        if (ftruncate(sink->fd, (off_t)file_size) != 0) {
+            close(sink->fd);
+            return false;
+        }
+    } else if (file_size < MMAP_SINK_HEADER_SIZE) {
+        // Don't clobber a file that isn't one of our logs.
+        close(sink->fd);
+        return false;
+    }
+
+    void *const map =
+        mmap(NULL,
+             file_size,
+             PROT_READ | PROT_WRITE,
+             MAP_SHARED,
+             sink->fd,
+             /*offset=*/0);
+
+    if (map == MAP_FAILED) {
+        close(sink->fd);
+        return false;
+    }
+
+    sink->map = (char *)map;
+    sink->map_size = file_size;
+
+    struct mmap_sink_header *const header = mmap_sink_get_header(sink);
+    if (is_new) {
+        header->magic = MMAP_SINK_MAGIC;
+        header->version = MMAP_SINK_VERSION;
+        header->committed_length = 0;
+
+        return true;
+    }
+
+    if (header->magic != MMAP_SINK_MAGIC
+        || header->version != MMAP_SINK_VERSION
+        || header->committed_length > file_size - MMAP_SINK_HEADER_SIZE)
+    {
+        munmap(sink->map, sink->map_size);
+        close(sink->fd);
+
+        return false;
+    }
+
+    // Anything past the committed length is from an unfinished message, and
+    // is overwritten.
+
+    sink->used = header->committed_length;
+    sink->committed = header->committed_length;
+
+    return true;
+}
+
+void mmap_sink_commit(struct mmap_sink *const sink) {
+    if (sink->map == NULL || sink->failed) {
+        return;
+    }
+
+#if defined(__SSE2__)
+    // Order any non-temporal stores before the header update.
+    if (sink->use_non_temporal_stores) {
+        _mm_sfence();
+    }
+#endif /* defined(__SSE2__) */
+
+    __atomic_store_n(&mmap_sink_get_header(sink)->committed_length,
+                     sink->used,
+                     __ATOMIC_RELEASE);
+
+    sink->committed = sink->used;
+}
+
+bool mmap_sink_sync(struct mmap_sink *const sink) {
+    mmap_sink_commit(sink);
+    if (sink->map == NULL) {
+        return false;
+    }
+
+    return msync(sink->map, sink->map_size, MS_SYNC) == 0 && !sink->failed;
+}
+
+bool mmap_sink_close(struct mmap_sink *const sink) {
+    mmap_sink_commit(sink);
+
+    if (sink->map != NULL) {
+        munmap(sink->map, sink->map_size);
+        sink->map = NULL;
+    }
+
+    // Drop any unfinished message, and the unused rest of the last chunk.
+    const off_t length = (off_t)(MMAP_SINK_HEADER_SIZE + sink->committed);
+    const bool result = ftruncate(sink->fd, length) == 0 && !sink->failed;
+
+    close(sink->fd);
+    return result;
+}
+
+uint32_t
+mmap_sink_write_ch_callback(struct printf_spec_info *const spec_info,
+                            void *const info,
+                            const char ch,
+                            const uint32_t times,
+                            bool *const should_continue_out)
+{
+    (void)spec_info;
+
+    struct mmap_sink *const sink = (struct mmap_sink *)info;
+    if (!mmap_sink_reserve(sink, times)) {
+        *should_continue_out = false;
+        return 0;
+    }
+
+    memset(sink->map + MMAP_SINK_HEADER_SIZE + sink->used, ch, times);
+    sink->used += times;
+
+    return times;
+}
+
+uint32_t
+mmap_sink_write_string_callback(struct printf_spec_info *const spec_info,
+                                void *const info,
+                                const char *const string,
+                                const uint32_t length,
+                                bool *const should_continue_out)
+{
+    (void)spec_info;
+
+    struct mmap_sink *const sink = (struct mmap_sink *)info;
+    if (!mmap_sink_reserve(sink, length)) {
+        *should_continue_out = false;
+        return 0;
+    }
+
+    copy_to_map(sink,
+                sink->map + MMAP_SINK_HEADER_SIZE + sink->used,
+                string,
+                length);
+
+    sink->used += length;
+    return length;
+}
+
+uint32_t
+mmap_sink_format(struct mmap_sink *const sink, const char *const format, ...) {
+    va_list list;
+    va_start(list, format);
+
+    const uint32_t result = mmap_sink_vformat(sink, format, list);
+
+    va_end(list);
+    return result;
+}
+
+uint32_t
+mmap_sink_vformat(struct mmap_sink *const sink,
+                  const char *const format,
+                  va_list list)
+{
+    const uint32_t length =
+        parse_printf_format(mmap_sink_write_ch_callback,
+                            sink,
+                            mmap_sink_write_string_callback,
+                            sink,
+                            format,
+                            list);
+
+    // Only whole messages are committed.
+    mmap_sink_commit(sink);
+
+    return length;
+}
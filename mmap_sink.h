@@ -0,0 +1,113 @@
+/*
+Copyright (c) 2023 Suhas Pai
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "parse_printf.h"
+
+/*
+ * A sink that writes formatted output straight into a memory-mapped,
+ * append-only log file. Writing is a plain store into the mapping, so no
+ * system calls are made per line. The file grows by chunk_size bytes at a
+ * time.
+ *
+ * The file starts with a header recording how many bytes of data have been
+ * committed. mmap_sink_format() commits after every message, so if the process
+ * crashes mid-message, readers only see whole messages. Reopening an existing
+ * log appends after its committed data.
+ */
+
+#define MMAP_SINK_MAGIC 0x474c4650 // "PFLG"
+#define MMAP_SINK_VERSION 1
+#define MMAP_SINK_HEADER_SIZE 64
+
+// Strings at least this long use non-temporal stores, if enabled.
+#define MMAP_SINK_NON_TEMPORAL_THRESHOLD 256
+
+struct mmap_sink_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t committed_length;
+};
+
+struct mmap_sink {
+    int fd;
+
+    char *map;
+    uint64_t map_size;
+    uint64_t chunk_size;
+
+    // Length of the data written after the header, including uncommitted
+    // data.
+    uint64_t used;
+
+    // Length of the data last recorded as committed in the header.
+    uint64_t committed;
+
+    bool use_non_temporal_stores;
+    bool failed;
+};
+
+bool
+mmap_sink_open(struct mmap_sink *sink,
+               const char *path,
+               uint64_t chunk_size,
+               bool use_non_temporal_stores);
+
+// Record everything written so far as committed in the header. Does nothing
+// once a write has failed, as the last message may be incomplete.
+void mmap_sink_commit(struct mmap_sink *sink);
+
+// Commit, then flush the mapping to disk with msync().
+bool mmap_sink_sync(struct mmap_sink *sink);
+
+/*
+ * Commit, then unmap and close the log. The file is truncated to the
+ * committed data. Returns false if any write failed.
+ */
+
+bool mmap_sink_close(struct mmap_sink *sink);
+
+uint32_t
+mmap_sink_write_ch_callback(struct printf_spec_info *spec_info,
+                            void *info,
+                            char ch,
+                            uint32_t times,
+                            bool *should_continue_out);
+
+uint32_t
+mmap_sink_write_string_callback(struct printf_spec_info *spec_info,
+                                void *info,
+                                const char *string,
+                                uint32_t length,
+                                bool *should_continue_out);
+
+__attribute__((format(printf, 2, 3)))
+uint32_t mmap_sink_format(struct mmap_sink *sink, const char *format, ...);
+
+uint32_t
+mmap_sink_vformat(struct mmap_sink *sink, const char *format, va_list list);
@@ -1,19 +1,40 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
-#include <string.h>
 
 #include "parse_printf.h"
+#include "printf_string.h"
 
 struct string_view {
     const char *begin;
-    uint32_t length;
+    size_t length;
 };
 
-struct va_list_struct {
-    va_list list;
+// The 32-bit functions wrap their callbacks in adapters to struct printf_sink.
+struct printf_sink32 {
+    printf_write_char_callback_t write_char_cb;
+    void *char_cb_info;
+
+    printf_write_string_callback_t write_string_cb;
+    void *string_cb_info;
 };
 
+/*
+ * Fetch the next argument, either from the va_list, or from the pre-loaded
+ * arguments.
+ */
+
+#define next_int_arg(list_struct, type) \
+    (__builtin_expect((list_struct)->positional_args == NULL, 1) ? \
+        va_arg((list_struct)->list, type) : \
+        (type)(list_struct)->positional_args[(list_struct)->positional_index++])
+
+#define next_ptr_arg(list_struct, type) \
+    (__builtin_expect((list_struct)->positional_args == NULL, 1) ? \
+        va_arg((list_struct)->list, type) : \
+        (type)(uintptr_t) \
+            (list_struct)->positional_args[(list_struct)->positional_index++])
+
 #define c_string_foreach(c_str, name) \
     for (typeof(*c_str) *name = c_str; *name != '\0'; name++)
 
@@ -25,12 +46,26 @@ struct va_list_struct {
 #define OCTAL_BUFFER_LENGTH  26
 #define DECIMAL_BUFFER_LENGTH 22
 #define HEXADECIMAL_BUFFER_LENGTH 20
-#define LARGEST_BUFFER_LENGTH BINARY_BUFFER_LENGTH
+// Fixed-point numbers and timestamps also need more than the octal buffer.
+#if PRINTF_ENABLE_BINARY \
+    || PRINTF_ENABLE_FIXED_POINT \
+    || PRINTF_ENABLE_TIMESTAMP
+    #define LARGEST_BUFFER_LENGTH BINARY_BUFFER_LENGTH
+#else
+    #define LARGEST_BUFFER_LENGTH OCTAL_BUFFER_LENGTH
+#endif
+
+// Room in front of an integer's digits for its sign, base prefix and zeros.
+#define FIELD_HEADROOM_LENGTH 32
+
+_Static_assert(FIELD_HEADROOM_LENGTH + LARGEST_BUFFER_LENGTH
+                   <= PRINTF_FIELD_BUFFER_LENGTH,
+               "struct printf_context's field buffer is too small");
 
 /******* PRIVATE FUNCTIONS *******/
 
 static inline struct string_view
-sv_create_length(const char *const string, const uint32_t length) {
+sv_create_length(const char *const string, const size_t length) {
     const struct string_view sv = {
         .begin = string,
         .length = length
@@ -41,7 +76,7 @@ sv_create_length(const char *const string, const uint32_t length) {
 
 static inline struct string_view
 sv_create_end(const char *const begin, const char *const end) {
-    return sv_create_length(begin, (uint64_t)(end - begin));
+    return sv_create_length(begin, (size_t)(end - begin));
 }
 
 #define SV_STATIC(c_str) sv_create_length(c_str, sizeof(c_str) - 1)
@@ -70,6 +105,7 @@ struct num_to_str_options {
     bool include_pos_sign : 1;
 
     bool capitalize : 1;
+    bool group_digits : 1;
 };
 
 #define NUM_TO_STR_OPTIONS_INIT() \
@@ -77,52 +113,384 @@ struct num_to_str_options {
         .include_prefix = false, \
         .include_pos_sign = false, \
         .capitalize = false, \
+        .group_digits = false, \
     })
 
-static inline struct string_view
-unsigned_to_string_view(uint64_t number,
-                        const enum numeric_base base,
-                        char buffer_in[static const LARGEST_BUFFER_LENGTH],
-                        const struct num_to_str_options options)
+/*
+ * Two-digit lookup table for decimal conversion. Emitting a pair of digits per
+ * step halves the number of divisions needed for base-10 conversions.
+ */
+
+static const char decimal_digit_pairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/*
+ * Multiply two 64-bit integers and return the upper 64 bits of the 128-bit
+ * product.
+ *
+ * On targets without a native 128-bit type (32-bit targets), we compose the
+ * result from 32x32->64 multiplies, which avoids calls to libgcc helpers.
+ */
+
+static inline uint64_t umul64_high(const uint64_t lhs, const uint64_t rhs) {
+#if defined(__SIZEOF_INT128__)
+    return (uint64_t)(((unsigned __int128)lhs * rhs) >> 64);
+#else
+    const uint32_t lhs_lo = (uint32_t)lhs;
+    const uint32_t lhs_hi = (uint32_t)(lhs >> 32);
+    const uint32_t rhs_lo = (uint32_t)rhs;
+    const uint32_t rhs_hi = (uint32_t)(rhs >> 32);
+
+    const uint64_t lo_lo = (uint64_t)lhs_lo * rhs_lo;
+    const uint64_t hi_lo = (uint64_t)lhs_hi * rhs_lo;
+    const uint64_t lo_hi = (uint64_t)lhs_lo * rhs_hi;
+    const uint64_t hi_hi = (uint64_t)lhs_hi * rhs_hi;
+
+    const uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + lo_hi;
+    return hi_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+/*
+ * Divide a 64-bit integer by 10^9 with a multiply-by-reciprocal, so we never
+ * emit a 64-bit division (which is a call to __udivdi3 on 32-bit targets).
+ */
+
+#define DECIMAL_CHUNK_DIVISOR 1000000000u
+#define DECIMAL_CHUNK_DIGITS 9
+
+static inline uint64_t
+udiv64_by_decimal_chunk(const uint64_t number, uint32_t *const rem_out) {
+    const uint64_t quotient = umul64_high(number >> 9, 0x44B82FA09B5A53) >> 11;
+    *rem_out = (uint32_t)(number - quotient * DECIMAL_CHUNK_DIVISOR);
+
+    return quotient;
+}
+
+/*
+ * Write the decimal digits of number so that they end right before
+ * buffer_in[end]. Returns the index of the first digit written.
+ *
+ * All divisions here are 32-bit divisions by a constant, which the compiler
+ * lowers to multiplications.
+ */
+
+static inline int
+u32_to_decimal_digits(uint32_t number, char *const buffer_in, int end) {
+    while (number >= 100) {
+        const uint32_t pair = number % 100;
+
+        number /= 100;
+        end -= 2;
+
+        __builtin_memcpy(buffer_in + end, decimal_digit_pairs + (pair * 2), 2);
+    }
+
+    if (number >= 10) {
+        end -= 2;
+        __builtin_memcpy(buffer_in + end,
+                         decimal_digit_pairs + (number * 2),
+                         2);
+    } else {
+        end -= 1;
+        buffer_in[end] = (char)('0' + number);
+    }
+
+    return end;
+}
+
+static inline int
+u32_to_decimal_chunk(const uint32_t number, char *const buffer_in, int end) {
+    const int chunk_begin = end - DECIMAL_CHUNK_DIGITS;
+
+    int i = u32_to_decimal_digits(number, buffer_in, end);
+    while (i > chunk_begin) {
+        i--;
+        buffer_in[i] = '0';
+    }
+
+    return chunk_begin;
+}
+
+static inline int
+u64_to_decimal_digits(const uint64_t number, char *const buffer_in, int end) {
+    if (number <= UINT32_MAX) {
+        return u32_to_decimal_digits((uint32_t)number, buffer_in, end);
+    }
+
+    // A 64-bit integer has at most 20 digits, so we need at most three chunks.
+
+    uint32_t low_chunk = 0;
+    const uint64_t upper = udiv64_by_decimal_chunk(number, &low_chunk);
+
+    end = u32_to_decimal_chunk(low_chunk, buffer_in, end);
+    if (upper <= UINT32_MAX) {
+        return u32_to_decimal_digits((uint32_t)upper, buffer_in, end);
+    }
+
+    uint32_t mid_chunk = 0;
+    const uint64_t top = udiv64_by_decimal_chunk(upper, &mid_chunk);
+
+    end = u32_to_decimal_chunk(mid_chunk, buffer_in, end);
+    return u32_to_decimal_digits((uint32_t)top, buffer_in, end);
+}
+
+#if PRINTF_ENABLE_DIGIT_GROUPING
+
+/*
+ * Digit-grouping (the ' flag) is done while converting, rather than as a
+ * separate pass. We still emit two digits at a time, and only fall back to one
+ * digit at a time for a pair that straddles a separator.
+ */
+
+struct digit_grouping {
+    char separator;
+    uint8_t size;
+};
+
+static struct digit_grouping digit_grouping = {
+    .separator = ',',
+    .size = 3
+};
+
+struct digit_grouping_state {
+    struct digit_grouping grouping;
+    uint8_t left_in_group;
+};
+
+static inline int
+grouped_write_digit(struct digit_grouping_state *const state,
+                    const char digit,
+                    char *const buffer_in,
+                    int end)
 {
-    // Subtract one from the buffer-size to convert ordinal to index.
+    if (state->left_in_group == 0) {
+        end--;
+        buffer_in[end] = state->grouping.separator;
+        state->left_in_group = state->grouping.size;
+    }
+
+    end--;
+    buffer_in[end] = digit;
+    state->left_in_group--;
+
+    return end;
+}
+
+static inline int
+grouped_write_pair(struct digit_grouping_state *const state,
+                   const uint32_t pair,
+                   char *const buffer_in,
+                   int end)
+{
+    const char *const digits = decimal_digit_pairs + (pair * 2);
+    if (state->left_in_group >= 2) {
+        end -= 2;
+        __builtin_memcpy(buffer_in + end, digits, 2);
+        state->left_in_group -= 2;
+
+        return end;
+    }
+
+    end = grouped_write_digit(state, digits[1], buffer_in, end);
+    return grouped_write_digit(state, digits[0], buffer_in, end);
+}
+
+/*
+ * Same as u32_to_decimal_digits(), but writes at least min_digits digits,
+ * padding with zeros.
+ */
+
+static int
+u32_to_grouped_decimal_digits(uint32_t number,
+                              const uint8_t min_digits,
+                              struct digit_grouping_state *const state,
+                              char *const buffer_in,
+                              int end)
+{
+    uint8_t written = 0;
+    while (number >= 100) {
+        const uint32_t pair = number % 100;
+
+        number /= 100;
+        end = grouped_write_pair(state, pair, buffer_in, end);
+        written += 2;
+    }
+
+    if (number >= 10) {
+        end = grouped_write_pair(state, number, buffer_in, end);
+        written += 2;
+    } else {
+        end = grouped_write_digit(state, (char)('0' + number), buffer_in, end);
+        written += 1;
+    }
+
+    for (; written < min_digits; written++) {
+        end = grouped_write_digit(state, '0', buffer_in, end);
+    }
+
+    return end;
+}
+
+static int
+u64_to_grouped_decimal_digits(const uint64_t number,
+                              char *const buffer_in,
+                              int end)
+{
+    struct digit_grouping_state state = {
+        .grouping = digit_grouping,
+        .left_in_group = digit_grouping.size
+    };
+
+    if (number <= UINT32_MAX) {
+        return u32_to_grouped_decimal_digits((uint32_t)number,
+                                             /*min_digits=*/0,
+                                             &state,
+                                             buffer_in,
+                                             end);
+    }
+
+    uint32_t low_chunk = 0;
+    const uint64_t upper = udiv64_by_decimal_chunk(number, &low_chunk);
+
+    end = u32_to_grouped_decimal_digits(low_chunk,
+                                        DECIMAL_CHUNK_DIGITS,
+                                        &state,
+                                        buffer_in,
+                                        end);
+
+    if (upper <= UINT32_MAX) {
+        return u32_to_grouped_decimal_digits((uint32_t)upper,
+                                             /*min_digits=*/0,
+                                             &state,
+                                             buffer_in,
+                                             end);
+    }
+
+    uint32_t mid_chunk = 0;
+    const uint64_t top = udiv64_by_decimal_chunk(upper, &mid_chunk);
+
+    end = u32_to_grouped_decimal_digits(mid_chunk,
+                                        DECIMAL_CHUNK_DIGITS,
+                                        &state,
+                                        buffer_in,
+                                        end);
+
+    return u32_to_grouped_decimal_digits((uint32_t)top,
+                                         /*min_digits=*/0,
+                                         &state,
+                                         buffer_in,
+                                         end);
+}
+
+#endif /* PRINTF_ENABLE_DIGIT_GROUPING */
+
+/*
+ * Power-of-two bases only need shifts and masks, so we never divide at all.
+ */
+
+static inline int
+u64_to_pow2_digits(uint64_t number,
+                   const uint8_t shift,
+                   const char *const alphadigit_string,
+                   char *const buffer_in,
+                   int end)
+{
+    const uint64_t mask = ((uint64_t)1 << shift) - 1;
+    do {
+        end--;
+        buffer_in[end] = alphadigit_string[number & mask];
+
+        number >>= shift;
+    } while (number != 0);
+
+    return end;
+}
 
-    int i = LARGEST_BUFFER_LENGTH - 1;
+/*
+ * Write the digits of number in the given base so that they end right before
+ * the null-terminator at the end of buffer_in. Returns the index of the first
+ * digit written.
+ */
+
+static inline int
+u64_to_digits(const uint64_t number,
+              const enum numeric_base base,
+              char buffer_in[static const LARGEST_BUFFER_LENGTH],
+              const struct num_to_str_options options)
+{
     const char *const alphadigit_string =
         (options.capitalize) ?
             upper_alphadigit_string : lower_alphadigit_string;
 
-    buffer_in[i] = '\0';
-    i--;
+    // Subtract one from the buffer-size to convert ordinal to index.
+    const int end = LARGEST_BUFFER_LENGTH - 1;
+    buffer_in[end] = '\0';
+
+#if PRINTF_ENABLE_DIGIT_GROUPING
+    // Digit-grouping only applies to decimal numbers.
+    if (options.group_digits && digit_grouping.size != 0) {
+        if (base == NUMERIC_BASE_10) {
+            return u64_to_grouped_decimal_digits(number, buffer_in, end);
+        }
+    }
+#endif /* PRINTF_ENABLE_DIGIT_GROUPING */
 
-    do {
-        buffer_in[i] = alphadigit_string[number % base];
-        if (number < base) {
+    uint8_t shift = 0;
+    switch (base) {
+        case NUMERIC_BASE_2:
+            shift = 1;
             break;
-        }
+        case NUMERIC_BASE_8:
+            shift = 3;
+            break;
+        case NUMERIC_BASE_10:
+            return u64_to_decimal_digits(number, buffer_in, end);
+        case NUMERIC_BASE_16:
+            shift = 4;
+            break;
+    }
 
-        i--;
-        number /= base;
-    } while (true);
+    return u64_to_pow2_digits(number, shift, alphadigit_string, buffer_in, end);
+}
 
-    if (options.include_prefix) {
-        buffer_in[i - 2] = '0';
-        switch (base) {
-            case NUMERIC_BASE_2:
-                buffer_in[i - 1] = 'b';
-                break;
-            case NUMERIC_BASE_8:
-                buffer_in[i - 1] = 'o';
-                break;
-            case NUMERIC_BASE_10:
-                // This should never be reached.
-                break;
-            case NUMERIC_BASE_16:
-                buffer_in[i - 1] = 'x';
-                break;
-        }
+static inline int
+write_base_prefix(const enum numeric_base base,
+                  char buffer_in[static const LARGEST_BUFFER_LENGTH],
+                  int i)
+{
+    buffer_in[i - 2] = '0';
+    switch (base) {
+        case NUMERIC_BASE_2:
+            buffer_in[i - 1] = 'b';
+            break;
+        case NUMERIC_BASE_8:
+            buffer_in[i - 1] = 'o';
+            break;
+        case NUMERIC_BASE_10:
+            // This should never be reached.
+            break;
+        case NUMERIC_BASE_16:
+            buffer_in[i - 1] = 'x';
+            break;
+    }
+
+    return i - 2;
+}
 
-        i -= 2;
+static inline struct string_view
+unsigned_to_string_view(const uint64_t number,
+                        const enum numeric_base base,
+                        char buffer_in[static const LARGEST_BUFFER_LENGTH],
+                        const struct num_to_str_options options)
+{
+    int i = u64_to_digits(number, base, buffer_in, options);
+    if (options.include_prefix) {
+        i = write_base_prefix(base, buffer_in, i);
     }
 
     if (options.include_pos_sign) {
@@ -136,50 +504,17 @@ unsigned_to_string_view(uint64_t number,
 }
 
 static struct string_view
-convert_neg_64int_to_string(int64_t number,
+convert_neg_64int_to_string(const int64_t number,
                             const enum numeric_base base,
                             char buffer_in[static const LARGEST_BUFFER_LENGTH],
                             const struct num_to_str_options options)
 {
-    // Subtract one from the buffer-size to convert ordinal to index.
-
-    int i = LARGEST_BUFFER_LENGTH - 1;
-    const char *const alphadigit_string =
-        (options.capitalize) ?
-        upper_alphadigit_string : lower_alphadigit_string;
-
-    buffer_in[i] = '\0';
-    i--;
-
-    const int64_t neg_base = 0 - (int64_t)base;
-    do {
-        buffer_in[i] = alphadigit_string[0 - (number % base)];
-        if (number > neg_base) {
-            break;
-        }
-
-        i--;
-        number /= base;
-    } while (true);
+    // Negate in unsigned arithmetic so INT64_MIN doesn't overflow.
+    const uint64_t magnitude = 0 - (uint64_t)number;
 
+    int i = u64_to_digits(magnitude, base, buffer_in, options);
     if (options.include_prefix) {
-        buffer_in[i - 2] = '0';
-        switch (base) {
-            case NUMERIC_BASE_2:
-                buffer_in[i - 1] = 'b';
-                break;
-            case NUMERIC_BASE_8:
-                buffer_in[i - 1] = 'o';
-                break;
-            case NUMERIC_BASE_10:
-                // This should never be reached.
-                break;
-            case NUMERIC_BASE_16:
-                buffer_in[i - 1] = 'x';
-                break;
-        }
-
-        i -= 2;
+        i = write_base_prefix(base, buffer_in, i);
     }
 
     buffer_in[i - 1] = '-';
@@ -206,117 +541,556 @@ signed_to_string_view(const int64_t number,
     return result;
 }
 
-static bool
-parse_flags(struct printf_spec_info *const curr_spec,
-            const char *iter,
-            const char **const iter_out)
+#if PRINTF_ENABLE_FIXED_POINT
+
+/*
+ * Fixed-point (Qm.n) numbers are converted entirely with integer arithmetic.
+ * We support up to 32 fraction bits, so that every fraction digit can be
+ * computed without overflowing 64 bits, and the exact decimal expansion (which
+ * has at most frac_bits digits) always fits in the conversion buffer.
+ */
+
+#define FIXED_POINT_MAX_FRAC_BITS 32
+#define FIXED_POINT_DEFAULT_PRECISION 6
+
+struct fixed_to_str_options {
+    bool is_negative : 1;
+    bool include_pos_sign : 1;
+    bool always_include_point : 1;
+};
+
+static struct string_view
+fixed_to_string_view(const uint64_t magnitude,
+                     const uint8_t frac_bits,
+                     const uint32_t precision,
+                     char buffer_in[static const LARGEST_BUFFER_LENGTH],
+                     const struct fixed_to_str_options options,
+                     uint32_t *const trailing_zeros_out)
 {
-    do {
-        switch (*iter) {
-            case ' ':
-                curr_spec->add_one_space_for_sign = true;
-                break;
-            case '-':
-                curr_spec->left_justify = true;
-                break;
-            case '+':
-                curr_spec->add_pos_sign = true;
-                break;
-            case '#':
-                curr_spec->add_base_prefix = true;
-                break;
-            case '0':
-                curr_spec->leftpad_zeros = true;
-                break;
-            default:
-                goto done;
-        }
+    uint64_t int_part = magnitude >> frac_bits;
 
-        iter++;
-        if (__builtin_expect(*iter == '\0', 0)) {
-            return false;
-        }
-    } while (true);
+    const uint64_t frac_mask = ((uint64_t)1 << frac_bits) - 1;
+    uint64_t frac = magnitude & frac_mask;
 
-done:
-    *iter_out = iter;
-    return true;
-}
+    // Every digit after the first frac_bits digits is exactly zero, so we
+    // leave writing them to the caller.
 
-static inline int
-read_int_from_fmt_string(const char *const c_str, const char **const iter_out) {
-    int result = 0;
-    c_string_foreach(c_str, iter) {
-        const uint8_t digit = *iter - '0';
-        if (digit >= 10) {
-            *iter_out = iter;
-            break;
-        }
+    const uint32_t digit_count =
+        precision < frac_bits ? precision : (uint32_t)frac_bits;
 
-        if (__builtin_expect(
-                !check_mul(result, 10, &result)
-                || !check_add(result, digit, &result), 0))
-        {
-            *iter_out = iter;
-            return -1;
-        }
+    *trailing_zeros_out = precision - digit_count;
+
+    const bool include_point = precision != 0 || options.always_include_point;
+    const int end = LARGEST_BUFFER_LENGTH - 1;
+    const int point_index = end - (int)digit_count - 1;
+
+    buffer_in[end] = '\0';
+    for (uint32_t i = 0; i != digit_count; i++) {
+        frac *= 10;
+        buffer_in[point_index + 1 + (int)i] = (char)('0' + (frac >> frac_bits));
+        frac &= frac_mask;
     }
 
-    return result;
-}
+    // Round the remainder half-to-even, like printf does for exact ties.
+    if (frac != 0) {
+        const uint64_t half = (uint64_t)1 << (frac_bits - 1);
+        const uint8_t last_digit =
+            digit_count != 0 ? buffer_in[end - 1] - '0' : (uint8_t)int_part;
+
+        if (frac > half || (frac == half && (last_digit & 1) != 0)) {
+            int i = end - 1;
+            for (; i != point_index; i--) {
+                if (buffer_in[i] != '9') {
+                    buffer_in[i]++;
+                    break;
+                }
 
-static bool
-parse_width(struct printf_spec_info *const curr_spec,
-            struct va_list_struct *const list_struct,
-            const char *iter,
-            const char **const iter_out)
-{
-    if (*iter != '*') {
-        const int width = read_int_from_fmt_string(iter, &iter);
-        if (__builtin_expect(width == -1, 0)) {
-            return false;
+                buffer_in[i] = '0';
+            }
+
+            if (i == point_index) {
+                int_part++;
+            }
         }
+    }
 
-        curr_spec->width = (uint32_t)width;
+    int i = point_index;
+    if (include_point) {
+        buffer_in[point_index] = '.';
     } else {
-        const int value = va_arg(list_struct->list, int);
-        curr_spec->width = value >= 0 ? (uint32_t)value : 0;
-
-        iter++;
+        i++;
     }
 
-    if (__builtin_expect(*iter == '\0', 0)) {
-        // If we have an incomplete spec, then we exit without writing anything.
-        return false;
+    i = u64_to_decimal_digits(int_part, buffer_in, i);
+    if (options.is_negative) {
+        i -= 1;
+        buffer_in[i] = '-';
+    } else if (options.include_pos_sign) {
+        i -= 1;
+        buffer_in[i] = '+';
     }
 
-    *iter_out = iter;
-    return true;
+    /* Make end point to the null-terminator */
+    return sv_create_end(buffer_in + i, buffer_in + end);
 }
 
-static bool
-parse_precision(struct printf_spec_info *const curr_spec,
-                const char *iter,
-                struct va_list_struct *const list_struct,
-                const char **const iter_out)
-{
-    if (*iter != '.') {
-        curr_spec->precision = -1;
-        return true;
-    }
+#endif /* PRINTF_ENABLE_FIXED_POINT */
 
-    iter++;
-    switch (*iter) {
-        case '\0':
-            return false;
-        case '*':
-            // Don't bother reading if we have an incomplete spec
-            if (__builtin_expect(iter[1] == '\0', 0)) {
-                return false;
-            }
+#if PRINTF_ENABLE_TIMESTAMP
+
+/*
+ * Timestamps are given as nanoseconds since the Unix epoch, and are written as
+ * ISO-8601 in UTC, e.g. "2023-11-14T22:13:20.123456Z".
+ *
+ * Log lines are written far more often than the minute changes, so we keep a
+ * per-thread cache of the formatted "YYYY-MM-DDTHH:MM:" prefix for the last
+ * minute we saw, and only format the seconds and sub-second digits otherwise.
+ */
+
+#ifndef PRINTF_THREAD_LOCAL
+    #define PRINTF_THREAD_LOCAL _Thread_local
+#endif /* PRINTF_THREAD_LOCAL */
+
+#define TIMESTAMP_PREFIX_LENGTH 17
+#define TIMESTAMP_MAX_PRECISION 9
+#define TIMESTAMP_DEFAULT_PRECISION 6
+
+struct timestamp_cache {
+    int32_t minute;
+    char prefix[TIMESTAMP_PREFIX_LENGTH];
+};
+
+static PRINTF_THREAD_LOCAL struct timestamp_cache timestamp_cache = {
+    .minute = INT32_MIN,
+};
+
+/*
+ * Divide a 64-bit integer by a 16-bit divisor with long division on 16-bit
+ * digits, so every step is a 32-bit division.
+ */
+
+static inline uint64_t
+udiv64_by_u16(const uint64_t number,
+              const uint16_t divisor,
+              uint32_t *const rem_out)
+{
+    uint64_t quotient = 0;
+    uint32_t rem = 0;
+
+    for (int shift = 48; shift >= 0; shift -= 16) {
+        const uint32_t part = (rem << 16) | (uint16_t)(number >> shift);
+
+        quotient = (quotient << 16) | (part / divisor);
+        rem = part % divisor;
+    }
+
+    *rem_out = rem;
+    return quotient;
+}
+
+static inline void write_two_digits(char *const out, const uint32_t number) {
+    __builtin_memcpy(out, decimal_digit_pairs + (number * 2), 2);
+}
+
+/*
+ * Write the "YYYY-MM-DDTHH:MM:" prefix for a minute since the epoch. The date
+ * conversion is Howard Hinnant's civil_from_days algorithm.
+ */
+
+static void
+write_timestamp_prefix(const int32_t minute, char *const out) {
+    int32_t days = minute / 1440;
+    int32_t minute_of_day = minute % 1440;
+
+    if (minute_of_day < 0) {
+        days -= 1;
+        minute_of_day += 1440;
+    }
+
+    const int32_t z = days + 719468;
+    const int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const uint32_t doe = (uint32_t)(z - era * 146097);
+    const uint32_t yoe =
+        (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const uint32_t mp = (5 * doy + 2) / 153;
+    const uint32_t day = doy - (153 * mp + 2) / 5 + 1;
+    const uint32_t month = mp < 10 ? mp + 3 : mp - 9;
+    const uint32_t year =
+        (uint32_t)((int32_t)yoe + era * 400) + (month <= 2 ? 1 : 0);
+
+    write_two_digits(out, year / 100);
+    write_two_digits(out + 2, year % 100);
+    out[4] = '-';
+    write_two_digits(out + 5, month);
+    out[7] = '-';
+    write_two_digits(out + 8, day);
+    out[10] = 'T';
+    write_two_digits(out + 11, (uint32_t)minute_of_day / 60);
+    out[13] = ':';
+    write_two_digits(out + 14, (uint32_t)minute_of_day % 60);
+    out[16] = ':';
+}
+
+static struct string_view
+timestamp_to_string_view(const int64_t nanoseconds,
+                         uint32_t precision,
+                         char buffer_in[static const LARGEST_BUFFER_LENGTH])
+{
+    // Split into whole seconds and nanoseconds, rounding towards negative
+    // infinity, so times before the epoch still have a positive fraction.
+
+    uint64_t magnitude =
+        nanoseconds >= 0 ? (uint64_t)nanoseconds : 0 - (uint64_t)nanoseconds;
+
+    uint32_t frac_ns = 0;
+    uint64_t seconds = udiv64_by_decimal_chunk(magnitude, &frac_ns);
+
+    uint32_t second_of_minute = 0;
+    uint64_t minutes = udiv64_by_u16(seconds, 60, &second_of_minute);
+
+    int32_t minute = (int32_t)minutes;
+    if (nanoseconds < 0) {
+        if (frac_ns != 0) {
+            frac_ns = DECIMAL_CHUNK_DIVISOR - frac_ns;
+            second_of_minute += 1;
+        }
+
+        minute = -minute;
+        if (second_of_minute != 0) {
+            minute -= 1;
+            second_of_minute = 60 - second_of_minute;
+        }
+    }
+
+    struct timestamp_cache *const cache = &timestamp_cache;
+    if (__builtin_expect(cache->minute != minute, 0)) {
+        write_timestamp_prefix(minute, cache->prefix);
+        cache->minute = minute;
+    }
+
+    __builtin_memcpy(buffer_in, cache->prefix, TIMESTAMP_PREFIX_LENGTH);
+    write_two_digits(buffer_in + TIMESTAMP_PREFIX_LENGTH, second_of_minute);
+
+    uint32_t length = TIMESTAMP_PREFIX_LENGTH + 2;
+    if (precision > TIMESTAMP_MAX_PRECISION) {
+        precision = TIMESTAMP_MAX_PRECISION;
+    }
+
+    if (precision != 0) {
+        // Sub-second digits are truncated, so the seconds never roll over.
+        buffer_in[length] = '.';
+        u32_to_decimal_chunk(frac_ns,
+                             buffer_in,
+                             (int)length + 1 + DECIMAL_CHUNK_DIGITS);
+
+        length += 1 + precision;
+    }
+
+    buffer_in[length] = 'Z';
+    length += 1;
+
+    return sv_create_length(buffer_in, length);
+}
+
+#endif /* PRINTF_ENABLE_TIMESTAMP */
+
+// Size in bytes of an integer argument, from its length modifier.
+static uint32_t raw_field_size(const struct printf_spec_info *const spec) {
+    switch (spec->length_info_len) {
+        case 0:
+            return sizeof(int);
+        case 1:
+            switch (*spec->length_info) {
+                case 'h':
+                    return sizeof(short);
+                case 'l':
+                    return sizeof(long);
+                case 'j':
+                    return sizeof(intmax_t);
+                case 'z':
+                    return sizeof(size_t);
+                case 't':
+                    return sizeof(ptrdiff_t);
+            }
+
+            break;
+        case 2:
+            return *spec->length_info == 'h' ? 1 : sizeof(long long);
+    }
+
+    return sizeof(int);
+}
+
+#if PRINTF_ENABLE_RAW_FIELDS
+
+#define RAW_FIELD_MAX_BYTES 8
+#define VARINT_MAX_BYTES 10
+
+/*
+ * Write number as a binary field: %r and %R as raw little- and big-endian
+ * bytes, %v as an unsigned LEB128 varint and %V as a signed one. For %r/%R,
+ * width is the number of bytes (1-8). For %v/%V, width is the minimum number
+ * of bytes, padded with redundant continuation bytes so fields can be patched
+ * in place.
+ */
+
+static struct string_view
+raw_field_to_string_view(const char spec,
+                         uint64_t number,
+                         const uint32_t size,
+                         const uint32_t width,
+                         char buffer_in[static const LARGEST_BUFFER_LENGTH])
+{
+    uint32_t length = 0;
+    switch (spec) {
+        case 'r':
+        case 'R': {
+            length = width != 0 ? width : size;
+            if (length > RAW_FIELD_MAX_BYTES) {
+                length = RAW_FIELD_MAX_BYTES;
+            }
+
+            for (uint32_t i = 0; i != length; i++) {
+                const uint32_t shift =
+                    spec == 'r' ? 8 * i : 8 * (length - 1 - i);
+
+                buffer_in[i] = (char)(uint8_t)(number >> shift);
+            }
+
+            return sv_create_length(buffer_in, length);
+        }
+        case 'v':
+            if (size < sizeof(uint64_t)) {
+                number &= ((uint64_t)1 << (8 * size)) - 1;
+            }
+
+            do {
+                buffer_in[length++] = (char)(0x80 | (number & 0x7f));
+                number >>= 7;
+            } while (number != 0);
+
+            break;
+        case 'V': {
+            // Sign-extend from the argument's size.
+            const uint32_t unused_bits = 64 - 8 * size;
+            int64_t value = (int64_t)(number << unused_bits) >> unused_bits;
+
+            while (true) {
+                const uint8_t byte = (uint8_t)(value & 0x7f);
+                value >>= 7;
+
+                buffer_in[length++] = (char)(0x80 | byte);
+                if ((value == 0 && (byte & 0x40) == 0)
+                    || (value == -1 && (byte & 0x40) != 0))
+                {
+                    break;
+                }
+            }
+
+            number = value < 0 ? UINT64_MAX : 0;
+            break;
+        }
+    }
+
+    // Pad varints with bytes that only extend the sign (or zero).
+    const uint32_t min_length =
+        width < VARINT_MAX_BYTES ? width : VARINT_MAX_BYTES;
+
+    while (length < min_length) {
+        buffer_in[length++] = (char)(0x80 | (number & 0x7f));
+    }
+
+    // The last byte has no continuation bit.
+    buffer_in[length - 1] &= 0x7f;
+    return sv_create_length(buffer_in, length);
+}
+
+#endif /* PRINTF_ENABLE_RAW_FIELDS */
+
+static bool
+parse_flags(struct printf_spec_info *const curr_spec,
+            const char *iter,
+            const char **const iter_out)
+{
+    do {
+        switch (*iter) {
+            case ' ':
+                curr_spec->add_one_space_for_sign = true;
+                break;
+            case '-':
+                curr_spec->left_justify = true;
+                break;
+            case '+':
+                curr_spec->add_pos_sign = true;
+                break;
+            case '#':
+                curr_spec->add_base_prefix = true;
+                break;
+            case '0':
+                curr_spec->leftpad_zeros = true;
+                break;
+            case '\'':
+                // Without grouping, the flag is still accepted, and ignored.
+#if PRINTF_ENABLE_DIGIT_GROUPING
+                curr_spec->group_digits = true;
+#endif /* PRINTF_ENABLE_DIGIT_GROUPING */
+                break;
+            default:
+                goto done;
+        }
+
+        iter++;
+        if (__builtin_expect(*iter == '\0', 0)) {
+            return false;
+        }
+    } while (true);
+
+done:
+    *iter_out = iter;
+    return true;
+}
+
+static inline int
+read_int_from_fmt_string(const char *const c_str, const char **const iter_out) {
+    int result = 0;
+    c_string_foreach(c_str, iter) {
+        const uint8_t digit = *iter - '0';
+        if (digit >= 10) {
+            *iter_out = iter;
+            break;
+        }
+
+        if (__builtin_expect(
+                !check_mul(result, 10, &result)
+                || !check_add(result, digit, &result), 0))
+        {
+            *iter_out = iter;
+            return -1;
+        }
+    }
+
+    return result;
+}
+
+/*
+ * Read a 1-based argument position in the form "n$". Returns 0 if iter doesn't
+ * point to a valid position.
+ */
+
+static uint32_t
+read_positional_index(const char *iter, const char **const iter_out) {
+    uint32_t position = 0;
+    for (; *iter >= '0' && *iter <= '9'; iter++) {
+        position = position * 10 + (uint32_t)(*iter - '0');
+        if (position > PRINTF_MAX_POSITIONAL_ARGS) {
+            return 0;
+        }
+    }
+
+    if (*iter != '$') {
+        return 0;
+    }
+
+    *iter_out = iter + 1;
+    return position;
+}
+
+static bool
+read_positional_arg_index(struct va_list_struct *const list_struct,
+                          const char *const iter,
+                          const char **const iter_out)
+{
+    const uint32_t position = read_positional_index(iter, iter_out);
+    if (position == 0) {
+        return false;
+    }
+
+    list_struct->positional_index = position - 1;
+    return true;
+}
+
+// A negative width is a '-' flag followed by a positive width.
+static inline void
+set_width_from_arg(struct printf_spec_info *const curr_spec, const int value) {
+    if (value < 0) {
+        curr_spec->left_justify = true;
+        curr_spec->width = -(uint32_t)value;
+    } else {
+        curr_spec->width = (uint32_t)value;
+    }
+}
+
+// A negative precision is taken as if it were omitted.
+static inline void
+set_precision_from_arg(struct printf_spec_info *const curr_spec,
+                       const int value)
+{
+    curr_spec->precision = value < 0 ? -1 : value;
+}
+
+static bool
+parse_width(struct printf_spec_info *const curr_spec,
+            struct va_list_struct *const list_struct,
+            const char *iter,
+            const char **const iter_out)
+{
+    if (*iter != '*') {
+        const int width = read_int_from_fmt_string(iter, &iter);
+        if (__builtin_expect(width == -1, 0)) {
+            return false;
+        }
+
+        curr_spec->width = (uint32_t)width;
+    } else {
+        iter++;
+        if (list_struct->positional) {
+            if (!read_positional_arg_index(list_struct, iter, &iter)) {
+                return false;
+            }
+        }
+
+        set_width_from_arg(curr_spec, next_int_arg(list_struct, int));
+    }
+
+    if (__builtin_expect(*iter == '\0', 0)) {
+        // If we have an incomplete spec, then we exit without writing anything.
+        return false;
+    }
+
+    *iter_out = iter;
+    return true;
+}
+
+static bool
+parse_precision(struct printf_spec_info *const curr_spec,
+                const char *iter,
+                struct va_list_struct *const list_struct,
+                const char **const iter_out)
+{
+    if (*iter != '.') {
+        curr_spec->precision = -1;
+        return true;
+    }
+
+    iter++;
+    switch (*iter) {
+        case '\0':
+            return false;
+        case '*':
+            // Don't bother reading if we have an incomplete spec
+            if (__builtin_expect(iter[1] == '\0', 0)) {
+                return false;
+            }
 
-            curr_spec->precision = va_arg(list_struct->list, int);
             iter++;
+            if (list_struct->positional) {
+                if (!read_positional_arg_index(list_struct, iter, &iter)) {
+                    return false;
+                }
+            }
+
+            set_precision_from_arg(curr_spec, next_int_arg(list_struct, int));
 
             break;
         default:
@@ -336,7 +1110,43 @@ parse_precision(struct printf_spec_info *const curr_spec,
     return true;
 }
 
+/*
+ * %n takes a pointer rather than a value, so its length modifier only records
+ * the type to write back, and handle_spec() reads the pointer itself.
+ */
+
 static bool
+parse_write_back_length(struct printf_spec_info *const curr_spec,
+                        const char *const iter,
+                        const char **const iter_out)
+{
+    const char *end = iter;
+    switch (*end) {
+        case 'h':
+        case 'l':
+            end += end[1] == end[0] ? 2 : 1;
+            break;
+        case 'j':
+        case 'z':
+        case 't':
+            end++;
+            break;
+        default:
+            return false;
+    }
+
+    if (*end != 'n') {
+        return false;
+    }
+
+    curr_spec->length_info = iter;
+    curr_spec->length_info_len = (uint8_t)(end - iter);
+
+    *iter_out = end;
+    return true;
+}
+
+static inline bool
 parse_length(struct printf_spec_info *const curr_spec,
              const char *iter,
              const char **const iter_out,
@@ -350,6 +1160,10 @@ parse_length(struct printf_spec_info *const curr_spec,
             // anything.
             return false;
         case 'h': {
+            if (parse_write_back_length(curr_spec, iter, iter_out)) {
+                return true;
+            }
+
             iter++;
             switch (*iter) {
                 case '\0':
@@ -358,12 +1172,12 @@ parse_length(struct printf_spec_info *const curr_spec,
                     return false;
                 case 'h': {
                     const uint64_t number =
-                        (uint64_t)va_arg(list_struct->list, int);
+                        (uint64_t)next_int_arg(list_struct, int);
 
                     *number_out = number;
                     *is_zero_out = number == 0;
 
-                    curr_spec->length_info = iter - 2;
+                    curr_spec->length_info = iter - 1;
                     curr_spec->length_info_len = 2;
 
                     iter++;
@@ -371,7 +1185,7 @@ parse_length(struct printf_spec_info *const curr_spec,
                 }
                 default: {
                     const uint64_t number =
-                        (uint64_t)va_arg(list_struct->list, int);
+                        (uint64_t)next_int_arg(list_struct, int);
 
                     *number_out = number;
                     *is_zero_out = number == 0;
@@ -386,18 +1200,25 @@ parse_length(struct printf_spec_info *const curr_spec,
             break;
         }
         case 'l':
+            if (parse_write_back_length(curr_spec, iter, iter_out)) {
+                return true;
+            }
+
             iter++;
             switch (*iter) {
                 case '\0':
                     return false;
                 case 'l': {
+#if !PRINTF_ENABLE_LONGLONG
+                    return false;
+#endif /* !PRINTF_ENABLE_LONGLONG */
                     const uint64_t number =
-                        (uint64_t)va_arg(list_struct->list, long long int);
+                        (uint64_t)next_int_arg(list_struct, long long int);
 
                     *number_out = number;
                     *is_zero_out = number == 0;
 
-                    curr_spec->length_info = iter - 2;
+                    curr_spec->length_info = iter - 1;
                     curr_spec->length_info_len = 2;
 
                     iter++;
@@ -405,7 +1226,7 @@ parse_length(struct printf_spec_info *const curr_spec,
                 }
                 default: {
                     const uint64_t number =
-                        (uint64_t)va_arg(list_struct->list, long int);
+                        (uint64_t)next_int_arg(list_struct, long int);
 
                     *number_out = number;
                     *is_zero_out = number == 0;
@@ -419,8 +1240,15 @@ parse_length(struct printf_spec_info *const curr_spec,
 
             break;
         case 'j': {
+            if (parse_write_back_length(curr_spec, iter, iter_out)) {
+                return true;
+            }
+
+#if !PRINTF_ENABLE_LONGLONG
+            return false;
+#endif /* !PRINTF_ENABLE_LONGLONG */
             const uint64_t number =
-                (uint64_t)va_arg(list_struct->list, intmax_t);
+                (uint64_t)next_int_arg(list_struct, intmax_t);
 
             *number_out = number;
             *is_zero_out = number == 0;
@@ -432,7 +1260,11 @@ parse_length(struct printf_spec_info *const curr_spec,
             break;
         }
         case 'z': {
-            const uint64_t number = (uint64_t)va_arg(list_struct->list, size_t);
+            if (parse_write_back_length(curr_spec, iter, iter_out)) {
+                return true;
+            }
+
+            const uint64_t number = (uint64_t)next_int_arg(list_struct, size_t);
 
             *number_out = number;
             *is_zero_out = number == 0;
@@ -444,8 +1276,12 @@ parse_length(struct printf_spec_info *const curr_spec,
             break;
         }
         case 't': {
-            const uint64_t number =
-                (uint64_t)va_arg(list_struct->list, ptrdiff_t);
+            if (parse_write_back_length(curr_spec, iter, iter_out)) {
+                return true;
+            }
+
+            const uint64_t number =
+                (uint64_t)next_int_arg(list_struct, ptrdiff_t);
 
             *number_out = number;
             *is_zero_out = number == 0;
@@ -467,6 +1303,57 @@ parse_length(struct printf_spec_info *const curr_spec,
     return true;
 }
 
+/*
+ * Arguments are read at the width of their promoted type, so narrow them to
+ * the type the length modifier names, as "%hhu" of -1 prints 255.
+ */
+
+static uint64_t
+narrow_int_arg(const struct printf_spec_info *const curr_spec,
+               const uint64_t number)
+{
+    const uint32_t size = raw_field_size(curr_spec);
+    if (size >= sizeof(uint64_t)) {
+        return number;
+    }
+
+    const uint32_t shift = 64 - size * 8;
+    if (curr_spec->spec == 'd' || curr_spec->spec == 'i') {
+        return (uint64_t)((int64_t)(number << shift) >> shift);
+    }
+
+    return (number << shift) >> shift;
+}
+
+// Conversions that were removed by printf_config.h.
+static inline bool is_disabled_specifier(const char spec) {
+    switch (spec) {
+#if !PRINTF_ENABLE_BINARY
+        case 'b':
+        case 'B':
+#endif /* !PRINTF_ENABLE_BINARY */
+#if !PRINTF_ENABLE_FIXED_POINT
+        case 'k':
+        case 'K':
+#endif /* !PRINTF_ENABLE_FIXED_POINT */
+#if !PRINTF_ENABLE_TIMESTAMP
+        case 'T':
+#endif /* !PRINTF_ENABLE_TIMESTAMP */
+#if !PRINTF_ENABLE_RAW_FIELDS
+        case 'r':
+        case 'R':
+        case 'v':
+        case 'V':
+#endif /* !PRINTF_ENABLE_RAW_FIELDS */
+#if !PRINTF_ENABLE_N
+        case 'n':
+#endif /* !PRINTF_ENABLE_N */
+            return true;
+    }
+
+    return false;
+}
+
 enum handle_spec_result {
     E_HANDLE_SPEC_OK,
     E_HANDLE_SPEC_REACHED_END,
@@ -478,17 +1365,40 @@ handle_spec(struct printf_spec_info *const curr_spec,
             char *const buffer,
             uint64_t number,
             struct va_list_struct *const list_struct,
-            const uint32_t written_out,
+            const uint64_t written_out,
             struct string_view *const parsed_out,
+            uint32_t *const trailing_zeros_out,
             bool *const is_zero_out,
             bool *const is_null_out)
 {
+    // Only used by conversions that may be disabled.
+    (void)written_out;
+    (void)trailing_zeros_out;
+
+    switch (curr_spec->spec) {
+        case 'b':
+        case 'B':
+        case 'd':
+        case 'i':
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+            if (curr_spec->length_info_len != 0) {
+                number = narrow_int_arg(curr_spec, number);
+                *is_zero_out = number == 0;
+            }
+
+            break;
+    }
+
     switch (curr_spec->spec) {
         case '\0':
             return E_HANDLE_SPEC_REACHED_END;
+#if PRINTF_ENABLE_BINARY
         case 'b':
             if (curr_spec->length_info_len == 0) {
-                number = (uint64_t)va_arg(list_struct->list, unsigned);
+                number = (uint64_t)next_int_arg(list_struct, unsigned);
                 *is_zero_out = number == 0;
             }
 
@@ -500,7 +1410,7 @@ handle_spec(struct printf_spec_info *const curr_spec,
             break;
         case 'B':
             if (curr_spec->length_info_len == 0) {
-                number = (uint64_t)va_arg(list_struct->list, unsigned);
+                number = (uint64_t)next_int_arg(list_struct, unsigned);
                 *is_zero_out = number == 0;
             }
 
@@ -512,10 +1422,11 @@ handle_spec(struct printf_spec_info *const curr_spec,
                                           .capitalize = true
                                         });
             break;
+#endif /* PRINTF_ENABLE_BINARY */
         case 'd':
         case 'i':
             if (curr_spec->length_info_len == 0) {
-                number = (uint64_t)va_arg(list_struct->list, int);
+                number = (uint64_t)next_int_arg(list_struct, int);
                 *is_zero_out = number == 0;
             }
 
@@ -526,11 +1437,13 @@ handle_spec(struct printf_spec_info *const curr_spec,
                                       (struct num_to_str_options){
                                         .include_pos_sign =
                                             curr_spec->add_pos_sign,
+                                        .group_digits =
+                                            curr_spec->group_digits,
                                       });
             break;
         case 'u':
             if (curr_spec->length_info_len == 0) {
-                number = va_arg(list_struct->list, unsigned);
+                number = next_int_arg(list_struct, unsigned);
                 *is_zero_out = number == 0;
             }
 
@@ -538,11 +1451,14 @@ handle_spec(struct printf_spec_info *const curr_spec,
                 unsigned_to_string_view(number,
                                         NUMERIC_BASE_10,
                                         buffer,
-                                        NUM_TO_STR_OPTIONS_INIT());
+                                        (struct num_to_str_options){
+                                            .group_digits =
+                                                curr_spec->group_digits
+                                        });
             break;
         case 'o':
             if (curr_spec->length_info_len == 0) {
-                number = va_arg(list_struct->list, unsigned);
+                number = next_int_arg(list_struct, unsigned);
                 *is_zero_out = number == 0;
             }
 
@@ -554,7 +1470,7 @@ handle_spec(struct printf_spec_info *const curr_spec,
             break;
         case 'x':
             if (curr_spec->length_info_len == 0) {
-                number = va_arg(list_struct->list, unsigned);
+                number = next_int_arg(list_struct, unsigned);
                 *is_zero_out = number == 0;
             }
 
@@ -566,7 +1482,7 @@ handle_spec(struct printf_spec_info *const curr_spec,
             break;
         case 'X':
             if (curr_spec->length_info_len == 0) {
-                number = va_arg(list_struct->list, unsigned);
+                number = next_int_arg(list_struct, unsigned);
                 *is_zero_out = number == 0;
             }
 
@@ -578,22 +1494,123 @@ handle_spec(struct printf_spec_info *const curr_spec,
                                             .capitalize = true
                                         });
             break;
+#if PRINTF_ENABLE_FIXED_POINT
+        case 'k':
+        case 'K': {
+            // Fixed-point arguments are the value, then the fraction-bit count.
+            if (curr_spec->length_info_len == 0) {
+                if (curr_spec->spec == 'k') {
+                    number = (uint64_t)next_int_arg(list_struct, int);
+                } else {
+                    number = next_int_arg(list_struct, unsigned);
+                }
+            }
+
+            // An invalid count most likely means the arguments don't match
+            // the format, so stop rather than print the rest from them.
+            const int frac_bits = next_int_arg(list_struct, int);
+            if (frac_bits < 0 || frac_bits > FIXED_POINT_MAX_FRAC_BITS) {
+                return E_HANDLE_SPEC_REACHED_END;
+            }
+
+            const bool is_negative =
+                curr_spec->spec == 'k' && (int64_t)number < 0;
+
+            if (is_negative) {
+                number = 0 - number;
+            }
+
+            const uint32_t precision =
+                curr_spec->precision != -1 ?
+                    (uint32_t)curr_spec->precision :
+                    FIXED_POINT_DEFAULT_PRECISION;
+
+            // A zero fixed-point number with no precision still prints "0".
+            *is_zero_out = false;
+            *parsed_out =
+                fixed_to_string_view(number,
+                                     (uint8_t)frac_bits,
+                                     precision,
+                                     buffer,
+                                     (struct fixed_to_str_options){
+                                        .is_negative = is_negative,
+                                        .include_pos_sign =
+                                            curr_spec->add_pos_sign,
+                                        .always_include_point =
+                                            curr_spec->add_base_prefix
+                                     },
+                                     trailing_zeros_out);
+            break;
+        }
+#endif /* PRINTF_ENABLE_FIXED_POINT */
+#if PRINTF_ENABLE_TIMESTAMP
+        case 'T': {
+            // The argument is always an int64_t. A length modifier has already
+            // read an argument of its own type, so every later one would be
+            // off.
+            if (curr_spec->length_info_len != 0) {
+                return E_HANDLE_SPEC_REACHED_END;
+            }
+
+            const int64_t nanoseconds = next_int_arg(list_struct, int64_t);
+            const uint32_t precision =
+                curr_spec->precision != -1 ?
+                    (uint32_t)curr_spec->precision :
+                    TIMESTAMP_DEFAULT_PRECISION;
+
+            *parsed_out =
+                timestamp_to_string_view(nanoseconds, precision, buffer);
+            break;
+        }
+#endif /* PRINTF_ENABLE_TIMESTAMP */
+#if PRINTF_ENABLE_RAW_FIELDS
+        case 'r':
+        case 'R':
+        case 'v':
+        case 'V':
+            if (curr_spec->length_info_len == 0) {
+                if (curr_spec->spec == 'V') {
+                    number = (uint64_t)next_int_arg(list_struct, int);
+                } else {
+                    number = next_int_arg(list_struct, unsigned);
+                }
+            }
+
+            // A zero is still a field, even with a precision of 0.
+            *is_zero_out = false;
+            *parsed_out =
+                raw_field_to_string_view(curr_spec->spec,
+                                         number,
+                                         raw_field_size(curr_spec),
+                                         curr_spec->width,
+                                         buffer);
+
+            // The width belongs to the field, and isn't padding.
+            curr_spec->width = 0;
+            break;
+#endif /* PRINTF_ENABLE_RAW_FIELDS */
         case 'c':
-            buffer[0] = (char)va_arg(list_struct->list, int);
+            buffer[0] = (char)next_int_arg(list_struct, int);
             *parsed_out = sv_create_length(buffer, 1);
 
             break;
         case 's': {
-            const char *const str = va_arg(list_struct->list, const char *);
+            const char *const str = next_ptr_arg(list_struct, const char *);
             if (str != NULL) {
-                uint32_t length = 0;
+                size_t length = 0;
                 if (curr_spec->precision != -1) {
-                    length = strnlen(str, (size_t)curr_spec->precision);
+                    length = printf_strnlen(str, (size_t)curr_spec->precision);
                 } else {
-                    length = strlen(str);
+                    length = printf_strlen(str);
                 }
 
                 *parsed_out = sv_create_length(str, length);
+            } else if (curr_spec->precision >= 0
+                       && curr_spec->precision < (int)sizeof("(null)") - 1)
+            {
+                // Like glibc, don't print a partial "(null)".
+                *parsed_out = SV_STATIC("");
+                *is_null_out = true;
             } else {
                 *parsed_out = SV_STATIC("(null)");
                 *is_null_out = true;
@@ -602,15 +1619,14 @@ handle_spec(struct printf_spec_info *const curr_spec,
             break;
         }
         case 'p': {
-            const void *const arg = va_arg(list_struct->list, const void *);
+            const void *const arg = next_ptr_arg(list_struct, const void *);
             if (arg != NULL) {
                 const struct num_to_str_options options = {
-                    .capitalize = true,
                     .include_prefix = true
                 };
 
                 *parsed_out =
-                    unsigned_to_string_view((uint64_t)arg,
+                    unsigned_to_string_view((uint64_t)(uintptr_t)arg,
                                             NUMERIC_BASE_16,
                                             buffer,
                                             options);
@@ -621,9 +1637,10 @@ handle_spec(struct printf_spec_info *const curr_spec,
 
             break;
         }
+#if PRINTF_ENABLE_N
         case 'n':
             if (curr_spec->length_info_len == 0) {
-                *va_arg(list_struct->list, int *) = (int)written_out;
+                *next_ptr_arg(list_struct, int *) = (int)written_out;
                 return E_HANDLE_SPEC_CONTINUE;
             }
 
@@ -632,12 +1649,13 @@ handle_spec(struct printf_spec_info *const curr_spec,
                     // case 'hh'
                     if (curr_spec->length_info_len == 2) {
                         if (curr_spec->length_info[1] == 'h') {
-                            *va_arg(list_struct->list, signed char *) =
-                                written_out;
+                            *next_ptr_arg(list_struct, signed char *) =
+                                (signed char)written_out;
                             return E_HANDLE_SPEC_CONTINUE;
                         }
                     } else if (curr_spec->length_info_len == 1) {
-                        *va_arg(list_struct->list, short int *) = written_out;
+                        *next_ptr_arg(list_struct, short int *) =
+                            (short int)written_out;
                         return E_HANDLE_SPEC_CONTINUE;
                     }
 
@@ -646,13 +1664,13 @@ handle_spec(struct printf_spec_info *const curr_spec,
                     // case 'll'
                     if (curr_spec->length_info_len == 2) {
                         if (curr_spec->length_info[1] == 'l') {
-                            *va_arg(list_struct->list, signed char *) =
-                                written_out;
+                            *next_ptr_arg(list_struct, long long int *) =
+                                (long long int)written_out;
 
                             return E_HANDLE_SPEC_CONTINUE;
                         }
                     } else if (curr_spec->length_info_len == 1) {
-                        *va_arg(list_struct->list, long int *) =
+                        *next_ptr_arg(list_struct, long int *) =
                             (long int)written_out;
 
                         return E_HANDLE_SPEC_CONTINUE;
@@ -660,25 +1678,32 @@ handle_spec(struct printf_spec_info *const curr_spec,
 
                     break;
                 case 'j':
-                    *va_arg(list_struct->list, intmax_t *) =
+                    *next_ptr_arg(list_struct, intmax_t *) =
                         (intmax_t)written_out;
                     return E_HANDLE_SPEC_CONTINUE;
                 case 'z':
-                    *va_arg(list_struct->list, size_t *) = written_out;
+                    *next_ptr_arg(list_struct, size_t *) =
+                        (size_t)written_out;
                     return E_HANDLE_SPEC_CONTINUE;
                 case 't':
-                    *va_arg(list_struct->list, ptrdiff_t *) =
+                    *next_ptr_arg(list_struct, ptrdiff_t *) =
                         (ptrdiff_t)written_out;
                     return E_HANDLE_SPEC_CONTINUE;
             }
 
             break;
+#endif /* PRINTF_ENABLE_N */
         case '%':
             buffer[0] = '%';
             *parsed_out = sv_create_length(buffer, 1);
 
             break;
         default:
+            // A disabled conversion's argument can't be skipped, so stop.
+            if (is_disabled_specifier(curr_spec->spec)) {
+                return E_HANDLE_SPEC_REACHED_END;
+            }
+
             return E_HANDLE_SPEC_CONTINUE;
     }
 
@@ -701,60 +1726,76 @@ static inline bool is_int_specifier(const char spec) {
     return false;
 }
 
-static inline uint32_t
+static inline bool is_fixed_point_specifier(const char spec) {
+    return PRINTF_ENABLE_FIXED_POINT && (spec == 'k' || spec == 'K');
+}
+
+static inline uint64_t
+sink_write_char(const struct printf_sink *const sink,
+                struct printf_spec_info *const info,
+                const char ch,
+                const uint32_t times,
+                bool *const cont_out)
+{
+    return sink->write_char_cb(info, sink->char_cb_info, ch, times, cont_out);
+}
+
+static inline uint64_t
+sink_write_string(const struct printf_sink *const sink,
+                  struct printf_spec_info *const info,
+                  const char *const string,
+                  const size_t length,
+                  bool *const cont_out)
+{
+    return sink->write_string_cb(info,
+                                 sink->string_cb_info,
+                                 string,
+                                 length,
+                                 cont_out);
+}
+
+static inline uint64_t
 write_prefix_for_spec(struct printf_spec_info *const info,
-                      const printf_write_char_callback_t write_ch_cb,
-                      void *const ch_cb_info,
-                      const printf_write_string_callback_t write_sv_cb,
-                      void *const sv_cb_info,
+                      const struct printf_sink *const sink,
                       bool *const cont_out)
 {
-    uint32_t out = 0;
+    uint64_t out = 0;
     if (!info->add_base_prefix) {
         return out;
     }
 
     switch (info->spec) {
         case 'b':
-            out += write_sv_cb(info, sv_cb_info, "0b", /*length=*/2, cont_out);
+            out += sink_write_string(sink, info, "0b", /*length=*/2, cont_out);
             break;
         case 'B':
-            out += write_sv_cb(info, sv_cb_info, "0B", /*length=*/2, cont_out);
+            out += sink_write_string(sink, info, "0B", /*length=*/2, cont_out);
             break;
         case 'o':
-            out += write_ch_cb(info, ch_cb_info, '0', /*times=*/1, cont_out);
+            out += sink_write_char(sink, info, '0', /*times=*/1, cont_out);
             break;
         case 'x':
-            out += write_sv_cb(info, sv_cb_info, "0x", /*length=*/2, cont_out);
+            out += sink_write_string(sink, info, "0x", /*length=*/2, cont_out);
             break;
         case 'X':
-            out += write_sv_cb(info, sv_cb_info, "0X", /*length=*/2, cont_out);
+            out += sink_write_string(sink, info, "0X", /*length=*/2, cont_out);
             break;
     }
 
     return out;
 }
 
-static uint32_t
+static uint64_t
 pad_with_lead_zeros(struct printf_spec_info *const info,
                     struct string_view *const parsed,
                     const uint32_t zero_count,
                     const bool is_null,
-                    const printf_write_char_callback_t write_char_cb,
-                    void *const cb_info,
-                    const printf_write_string_callback_t write_sv_cb,
-                    void *const write_sv_cb_info,
+                    const struct printf_sink *const sink,
                     bool *const cont_out)
 {
-    uint32_t out = 0;
+    uint64_t out = 0;
     if (!is_null) {
-        out +=
-            write_prefix_for_spec(info,
-                                  write_char_cb,
-                                  cb_info,
-                                  write_sv_cb,
-                                  write_sv_cb_info,
-                                  cont_out);
+        out += write_prefix_for_spec(info, sink, cont_out);
     }
 
     if (zero_count == 0) {
@@ -763,14 +1804,14 @@ pad_with_lead_zeros(struct printf_spec_info *const info,
 
     const char front = *parsed->begin;
     if (front == '+') {
-        out += write_char_cb(info, cb_info, '+', /*amount=*/1, cont_out);
+        out += sink_write_char(sink, info, '+', /*times=*/1, cont_out);
         if (!cont_out) {
             return out;
         }
 
         *parsed = sv_drop_front(*parsed);
     } else if (front == '-') {
-        out += write_char_cb(info, cb_info, '-', /*amount=*/1, cont_out);
+        out += sink_write_char(sink, info, '-', /*times=*/1, cont_out);
         if (!cont_out) {
             return out;
         }
@@ -778,7 +1819,7 @@ pad_with_lead_zeros(struct printf_spec_info *const info,
         *parsed = sv_drop_front(*parsed);
     }
 
-    out += write_char_cb(info, cb_info, '0', zero_count, cont_out);
+    out += sink_write_char(sink, info, '0', zero_count, cont_out);
     if (!cont_out) {
         return out;
     }
@@ -786,324 +1827,1506 @@ pad_with_lead_zeros(struct printf_spec_info *const info,
     return out;
 }
 
-static inline uint32_t
+/*
+ * Lays out an integer field's sign, base prefix and leading zeros directly in
+ * front of its digits, which sit in the conversion buffer after
+ * FIELD_HEADROOM_LENGTH bytes of room, so the whole field can be written with
+ * one callback. Returns false, leaving parsed as is, if they don't fit.
+ */
+
+static inline bool
+assemble_int_field(const struct printf_spec_info *const info,
+                   const char *const field_buffer,
+                   struct string_view *const parsed,
+                   const uint32_t zero_count,
+                   const uint32_t lead_space_count)
+{
+    // The digits were converted into field_buffer, so they can be modified.
+    char *const begin = (char *)parsed->begin;
+
+    // The sign moves in front of the prefix and zeros.
+    const char sign = *begin;
+    const uint32_t has_sign =
+        parsed->length != 0 && (sign == '+' || sign == '-');
+
+    uint32_t prefix_length = 0;
+    if (info->add_base_prefix) {
+        switch (info->spec) {
+            case 'b':
+            case 'B':
+            case 'x':
+            case 'X':
+                prefix_length = 2;
+                break;
+            case 'o':
+                prefix_length = 1;
+                break;
+        }
+    }
+
+    const uint32_t extra_length = lead_space_count + prefix_length + zero_count;
+    if ((uint32_t)(begin - field_buffer) < extra_length) {
+        return false;
+    }
+
+    char *const digits = begin + has_sign;
+    char *const field = begin - extra_length;
+
+    for (char *zero = digits - zero_count; zero != digits; zero++) {
+        *zero = '0';
+    }
+
+    // The prefix is '0' followed by the specifier, except for octal.
+    char *const prefix = digits - zero_count - prefix_length;
+    if (prefix_length != 0) {
+        prefix[prefix_length - 1] = info->spec;
+        prefix[0] = '0';
+    }
+
+    if (has_sign) {
+        prefix[-1] = sign;
+    }
+
+    if (lead_space_count != 0) {
+        *field = ' ';
+    }
+
+    *parsed = sv_create_length(field, parsed->length + extra_length);
+    return true;
+}
+
+static inline uint64_t
 call_cb(struct printf_spec_info *const info,
         const struct string_view sv,
-        const printf_write_char_callback_t write_char_cb,
-        void *const char_cb_info,
-        const printf_write_string_callback_t write_sv_cb,
-        void *const sv_cb_info,
+        const struct printf_sink *const sink,
         bool *const cont_out)
 {
     if (sv.length == 0) {
+        return 0;
     }
 
     if (sv.length == 1) {
         const char ch = *sv.begin;
-        return write_char_cb(info, char_cb_info, ch, /*amount=*/1, cont_out);
+        return sink_write_char(sink, info, ch, /*times=*/1, cont_out);
     }
 
-    return write_sv_cb(info, sv_cb_info, sv.begin, sv.length, cont_out);
+    return sink_write_string(sink, info, sv.begin, sv.length, cont_out);
 }
-/******* PUBLIC FUNCTIONS *******/
-
-uint32_t
-parse_printf_format(const printf_write_char_callback_t write_char_cb,
-                    void *const write_char_cb_info,
-                    const printf_write_string_callback_t write_string_cb,
-                    void *const write_string_cb_info,
-                    const char *const fmt,
-                    va_list list)
-{
-    struct va_list_struct list_struct = {0};
-    va_copy(list_struct.list, list);
 
-    char buffer[LARGEST_BUFFER_LENGTH];
-    bzero(buffer, sizeof(buffer));
-
-    struct printf_spec_info curr_spec = PRINTF_SPEC_INFO_INIT();
-    const char *unformatted_start = fmt;
+/*
+ * A format uses positional arguments if its first conversion (ignoring "%%")
+ * starts with "n$". Per POSIX, formats can't mix positional and sequential
+ * conversions, so we don't need to look at any later conversions.
+ */
 
-    uint32_t written_out = 0;
-    bool should_continue = true;
+static bool format_is_positional(const char *iter) {
+#if !PRINTF_ENABLE_POSITIONAL
+    (void)iter;
+    return false;
+#endif /* !PRINTF_ENABLE_POSITIONAL */
 
-    const char *iter = strchr(fmt, '%');
-    for (; iter != NULL; iter = strchr(iter, '%')) {
-        const struct string_view unformatted =
-            sv_create_end(unformatted_start, iter);
+    while (iter != NULL && iter[1] == '%') {
+        iter = printf_find_percent(iter + 2);
+    }
 
-        written_out +=
-            call_cb(NULL,
-                    unformatted,
-                    write_char_cb,
-                    write_char_cb_info,
-                    write_string_cb,
-                    write_string_cb_info,
-                    &should_continue);
+    if (iter == NULL) {
+        return false;
+    }
 
-        if (!should_continue) {
-            break;
-        }
+    // Any "digits$" counts, even an index we can't use, so that it stops
+    // formatting instead of being read as a sequential width.
+    iter++;
+    if (*iter < '0' || *iter > '9') {
+        return false;
+    }
 
+    do {
         iter++;
-        if (*iter == '\0') {
-            // If we only got a percent sign, then we don't print anything
-            va_end(list_struct.list);
-            return written_out;
-        }
+    } while (*iter >= '0' && *iter <= '9');
 
-        // Format is %[flags][width][.precision][length]specifier
-        if (!parse_flags(&curr_spec, iter, &iter)) {
-            // If we have an incomplete spec, then we exit without writing
-            // anything.
-            va_end(list_struct.list);
-            return written_out;
-        }
+    return *iter == '$';
+}
 
-        if (!parse_width(&curr_spec, &list_struct, iter, &iter)) {
-            // If we have an incomplete spec, then we exit without writing
-            // anything.
-            va_end(list_struct.list);
-            return written_out;
-        }
+static bool
+arg_table_set_type(struct printf_arg_table *const table,
+                   const uint32_t position,
+                   const enum printf_arg_type type)
+{
+    if (position == 0 || position > PRINTF_MAX_POSITIONAL_ARGS) {
+        return false;
+    }
 
-        if (!parse_precision(&curr_spec, iter, &list_struct, &iter)) {
-            // If we have an incomplete spec, then we exit without writing
-            // anything.
-            va_end(list_struct.list);
-            return written_out;
-        }
+    uint8_t *const slot = &table->types[position - 1];
+    if (*slot != PRINTF_ARG_TYPE_NONE && *slot != type) {
+        return false;
+    }
 
-        uint64_t number = 0;
-        bool is_zero = false;
+    *slot = type;
+    if (position > table->count) {
+        table->count = position;
+    }
 
-        if (!parse_length(&curr_spec,
-                          iter,
-                          &iter,
-                          &list_struct,
-                          &number,
-                          &is_zero))
-        {
-            // If we have an incomplete spec, then we exit without writing
-            // anything.
-            va_end(list_struct.list);
-            return written_out;
-        }
+    return true;
+}
 
-        // Parse specifier
-        struct string_view parsed = SV_EMPTY();
-        bool is_null = false;
+static const char *skip_digits(const char *iter) {
+    while (*iter >= '0' && *iter <= '9') {
+        iter++;
+    }
 
-        curr_spec.spec = *iter;
-        unformatted_start = iter + 1;
+    return iter;
+}
 
-        const enum handle_spec_result handle_spec_result =
-            handle_spec(&curr_spec,
-                        buffer,
-                        number,
-                        &list_struct,
-                        written_out,
-                        &parsed,
-                        &is_zero,
-                        &is_null);
+static enum printf_arg_type
+arg_type_for_length(const char *const length_info, const uint8_t length) {
+    switch (length) {
+        case 0:
+            return PRINTF_ARG_TYPE_INT;
+        case 1:
+            switch (*length_info) {
+                case 'l':
+                    return PRINTF_ARG_TYPE_LONG;
+                case 'j':
+                    return PRINTF_ARG_TYPE_INTMAX;
+                case 'z':
+                    return PRINTF_ARG_TYPE_SIZE;
+                case 't':
+                    return PRINTF_ARG_TYPE_PTRDIFF;
+            }
 
-        switch (handle_spec_result) {
-            case E_HANDLE_SPEC_OK:
-                break;
-            case E_HANDLE_SPEC_REACHED_END:
-                va_end(list_struct.list);
-                return written_out;
-            case E_HANDLE_SPEC_CONTINUE:
-                curr_spec = PRINTF_SPEC_INFO_INIT();
-                continue;
-        }
+            break;
+        case 2:
+            if (*length_info == 'l') {
+                return PRINTF_ARG_TYPE_LONG_LONG;
+            }
 
-        // Move past specifier
-        iter++;
+            break;
+    }
 
-        uint32_t padded_zero_count = 0;
-        uint8_t parsed_length = parsed.length;
+    // 'h' and 'hh' arguments are promoted to int.
+    return PRINTF_ARG_TYPE_INT;
+}
 
-        // is_zero being true implies spec is an integer.
-        // We don't write anything if we have a '0' and precision is 0.
+/*
+ * Get the position of the next argument of a conversion, either from an "n$"
+ * at iter, or, for sequential formats (next_position isn't NULL), from the
+ * running count of arguments. Returns 0 on an invalid position.
+ */
 
-        const bool should_write_parsed = !(is_zero && curr_spec.precision == 0);
-        if (should_write_parsed) {
-            if (curr_spec.add_base_prefix) {
-                switch (curr_spec.spec) {
-                    case 'b':
-                    case 'B':
-                        parsed_length += 2;
-                        break;
-                    case 'o':
-                        parsed_length += 1;
-                        break;
-                    case 'x':
-                    case 'X':
-                        parsed_length += 2;
-                        break;
-                }
-            }
-        } else {
-            parsed_length = 0;
-        }
+static uint32_t
+next_arg_position(const char *const iter,
+                  const char **const iter_out,
+                  uint32_t *const next_position)
+{
+    if (next_position == NULL) {
+        return read_positional_index(iter, iter_out);
+    }
 
-        // We have to pad with either spaces or zeroes if we're not wider than
-        // the specified width,
+    *iter_out = iter;
+    if (*next_position == PRINTF_MAX_POSITIONAL_ARGS) {
+        return 0;
+    }
 
-        uint32_t space_pad_count = 0;
-        if (is_int_specifier(curr_spec.spec)) {
-            if (curr_spec.precision != -1) {
-                // The case for the string-spec was already handled above
-                // Total digit count doesn't include the sign/prefix.
+    *next_position += 1;
+    return *next_position;
+}
 
-                uint8_t total_digit_count = parsed.length;
-                if (*parsed.begin == '-' || *parsed.begin == '+') {
-                    total_digit_count -= 1;
-                }
+/*
+ * Scan one conversion, with iter pointing right past the '%'. next_position is
+ * NULL for positional formats, and otherwise counts the arguments of a
+ * sequential format.
+ *
+ * Returns false on an invalid conversion, and sets *done_out if the format
+ * ends before the conversion does.
+ */
 
-                if (total_digit_count < curr_spec.precision) {
-                    padded_zero_count =
-                        (uint32_t)curr_spec.precision - total_digit_count;
+static bool
+scan_spec(struct printf_arg_table *const table,
+          const char *iter,
+          const char **const iter_out,
+          bool *const done_out,
+          uint32_t *const next_position)
+{
+    // For sequential formats, the value comes after any '*' arguments.
+    uint32_t position = 0;
+    if (next_position == NULL) {
+        position = read_positional_index(iter, &iter);
+        if (position == 0) {
+            return false;
+        }
+    }
 
-                    parsed_length += padded_zero_count;
-                }
-            }
+    struct printf_spec_info spec = PRINTF_SPEC_INFO_INIT();
+    if (!parse_flags(&spec, iter, &iter)) {
+        *done_out = true;
+        return true;
+    }
 
-            if (parsed_length != 0 && curr_spec.add_one_space_for_sign) {
-                // Only add a sign if we have neither a '+' or '-'
-                if (*parsed.begin != '+' && *parsed.begin != '-') {
-                    space_pad_count += 1;
-                }
-            }
-        }
+    if (*iter == '*') {
+        const uint32_t width_position =
+            next_arg_position(iter + 1, &iter, next_position);
 
-        if (parsed_length < curr_spec.width) {
-            const bool pad_with_zeros =
-                curr_spec.leftpad_zeros
-                && is_int_specifier(curr_spec.spec)
-                && curr_spec.precision == -1
-                && !curr_spec.left_justify; // Zeros are never left-justified
+        if (!arg_table_set_type(table, width_position, PRINTF_ARG_TYPE_INT)) {
+            return false;
+        }
+    } else {
+        iter = skip_digits(iter);
+    }
 
-            if (pad_with_zeros) {
-                // We're always resetting padded_zero_count if it was set before
-                padded_zero_count = curr_spec.width - parsed_length;
-            } else {
-                space_pad_count += curr_spec.width - parsed_length;
+    if (*iter == '.') {
+        iter++;
+        if (*iter == '*') {
+            const uint32_t precision_position =
+                next_arg_position(iter + 1, &iter, next_position);
+
+            if (!arg_table_set_type(table,
+                                    precision_position,
+                                    PRINTF_ARG_TYPE_INT))
+            {
+                return false;
             }
+        } else {
+            iter = skip_digits(iter);
         }
+    }
 
-        if (curr_spec.left_justify) {
-            written_out +=
-                pad_with_lead_zeros(&curr_spec,
-                                    &parsed,
-                                    padded_zero_count,
-                                    is_null,
-                                    write_char_cb,
-                                    write_char_cb_info,
-                                    write_string_cb,
-                                    write_string_cb_info,
-                                    &should_continue);
+    const char *const length_info = iter;
+    while (*iter == 'h' || *iter == 'l' || *iter == 'j' || *iter == 'z'
+           || *iter == 't')
+    {
+        iter++;
+    }
 
-            if (!should_continue) {
-                va_end(list_struct.list);
-                return written_out;
-            }
+    const uint8_t length = (uint8_t)(iter - length_info);
+    enum printf_arg_type type = arg_type_for_length(length_info, length);
 
-            if (should_write_parsed) {
-                written_out +=
-                    call_cb(&curr_spec,
-                            parsed,
-                            write_char_cb,
-                            write_char_cb_info,
-                            write_string_cb,
-                            write_string_cb_info,
-                            &should_continue);
-
-                if (!should_continue) {
-                    va_end(list_struct.list);
-                    return written_out;
-                }
+    switch (*iter) {
+        case '\0':
+            *done_out = true;
+            return true;
+        case 'c':
+            type = PRINTF_ARG_TYPE_INT;
+            break;
+        case 's':
+            type = PRINTF_ARG_TYPE_STRING;
+            break;
+        case 'p':
+            type = PRINTF_ARG_TYPE_POINTER;
+            break;
+        case 'n':
+            type = PRINTF_ARG_TYPE_WRITE_BACK;
+            break;
+        case 'T':
+            type = PRINTF_ARG_TYPE_LONG_LONG;
+            break;
+        case 'k':
+        case 'K':
+        case 'r':
+        case 'R':
+        case 'v':
+        case 'V':
+            break;
+        default:
+            // Unknown specifiers only consume an argument if they have a
+            // length.
+            if (!is_int_specifier(*iter) && length == 0) {
+                type = PRINTF_ARG_TYPE_NONE;
             }
 
-            if (space_pad_count != 0) {
-                written_out +=
-                    write_char_cb(&curr_spec,
-                                  write_char_cb_info,
-                                  ' ',
-                                  space_pad_count,
-                                  &should_continue);
-
-                if (!should_continue) {
-                    va_end(list_struct.list);
-                    return written_out;
-                }
-            }
-        } else {
-            if (space_pad_count != 0) {
-                written_out +=
-                    write_char_cb(&curr_spec,
-                                  write_char_cb_info,
-                                  ' ',
-                                  space_pad_count,
-                                  &should_continue);
-
-                if (!should_continue) {
-                    va_end(list_struct.list);
-                    return written_out;
-                }
-            }
+            break;
+    }
 
-            written_out +=
-                pad_with_lead_zeros(&curr_spec,
-                                    &parsed,
-                                    padded_zero_count,
-                                    is_null,
-                                    write_char_cb,
-                                    write_char_cb_info,
-                                    write_string_cb,
-                                    write_string_cb_info,
-                                    &should_continue);
+    if (type != PRINTF_ARG_TYPE_NONE) {
+        if (next_position != NULL) {
+            position = next_arg_position(iter, &iter, next_position);
+        }
 
-            if (!should_continue) {
-                va_end(list_struct.list);
-                return written_out;
+        if (!arg_table_set_type(table, position, type)) {
+            return false;
+        }
+
+        // The fraction-bit count of a fixed-point value follows the value.
+        if (*iter == 'k' || *iter == 'K') {
+            if (next_position != NULL) {
+                next_arg_position(iter, &iter, next_position);
             }
 
-            if (should_write_parsed) {
-                written_out +=
-                    call_cb(&curr_spec,
-                            parsed,
-                            write_char_cb,
-                            write_char_cb_info,
-                            write_string_cb,
-                            write_string_cb_info,
-                            &should_continue);
-
-                if (!should_continue) {
-                    va_end(list_struct.list);
-                    return written_out;
-                }
+            if (!arg_table_set_type(table, position + 1, PRINTF_ARG_TYPE_INT))
+            {
+                return false;
             }
         }
-
-        curr_spec = PRINTF_SPEC_INFO_INIT();
     }
 
-    if (*unformatted_start != '\0') {
-        const struct string_view unformatted =
-            sv_create_length(unformatted_start, strlen(unformatted_start));
+    *iter_out = iter + 1;
+    return true;
+}
+
+static bool
+scan_format(struct printf_arg_table *const table,
+            const char *iter,
+            uint32_t *const next_position)
+{
+    for (; iter != NULL; iter = printf_find_percent(iter)) {
+        iter++;
+        if (*iter == '%') {
+            iter++;
+            continue;
+        }
+
+        // Like parse_printf_format(), stop at an incomplete spec.
+        bool done = false;
+        if (!scan_spec(table, iter, &iter, &done, next_position)) {
+            table->count = 0;
+            return false;
+        }
+
+        if (done) {
+            break;
+        }
+    }
+
+    // Every argument up to the last one used must have a known type.
+    for (uint8_t i = 0; i != table->count; i++) {
+        if (table->types[i] == PRINTF_ARG_TYPE_NONE) {
+            table->count = 0;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void
+load_positional_args(const struct printf_arg_table *const table,
+                     va_list list,
+                     uint64_t *const args_out)
+{
+    va_list copy;
+    va_copy(copy, list);
+
+    for (uint8_t i = 0; i != table->count; i++) {
+        switch ((enum printf_arg_type)table->types[i]) {
+            case PRINTF_ARG_TYPE_NONE:
+            case PRINTF_ARG_TYPE_INT:
+                args_out[i] = (uint64_t)va_arg(copy, int);
+                break;
+            case PRINTF_ARG_TYPE_LONG:
+                args_out[i] = (uint64_t)va_arg(copy, long int);
+                break;
+            case PRINTF_ARG_TYPE_LONG_LONG:
+                args_out[i] = (uint64_t)va_arg(copy, long long int);
+                break;
+            case PRINTF_ARG_TYPE_INTMAX:
+                args_out[i] = (uint64_t)va_arg(copy, intmax_t);
+                break;
+            case PRINTF_ARG_TYPE_SIZE:
+                args_out[i] = (uint64_t)va_arg(copy, size_t);
+                break;
+            case PRINTF_ARG_TYPE_PTRDIFF:
+                args_out[i] = (uint64_t)va_arg(copy, ptrdiff_t);
+                break;
+            case PRINTF_ARG_TYPE_POINTER:
+            case PRINTF_ARG_TYPE_STRING:
+            case PRINTF_ARG_TYPE_WRITE_BACK:
+                args_out[i] = (uint64_t)(uintptr_t)va_arg(copy, void *);
+                break;
+        }
+    }
+
+    va_end(copy);
+}
+
+/*
+ * Read the argument of the conversion at iter, which points to its length
+ * modifier, and write the field. Sets *iter_out past the specifier, and
+ * returns false if formatting should stop.
+ *
+ * Both format loops get their own copy, as a call per conversion measurably
+ * slows down the runtime parser.
+ */
+
+__attribute__((always_inline)) static inline bool
+format_conversion(const struct printf_sink *const sink,
+                  struct printf_spec_info *const curr_spec,
+                  char *const field_buffer,
+                  struct va_list_struct *const list_struct,
+                  const char *iter,
+                  const char **const iter_out,
+                  uint64_t *const written_out)
+{
+    char *const buffer = field_buffer + FIELD_HEADROOM_LENGTH;
+    bool should_continue = true;
+
+    uint64_t number = 0;
+    bool is_zero = false;
+
+    if (!parse_length(curr_spec,
+                      iter,
+                      &iter,
+                      list_struct,
+                      &number,
+                      &is_zero))
+    {
+        // If we have an incomplete spec, then we exit without writing
+        // anything.
+        return false;
+    }
+
+    // Parse specifier
+    struct string_view parsed = SV_EMPTY();
+    uint32_t trailing_zero_count = 0;
+    bool is_null = false;
+
+    curr_spec->spec = *iter;
+
+    const enum handle_spec_result handle_spec_result =
+        handle_spec(curr_spec,
+                    buffer,
+                    number,
+                    list_struct,
+                    *written_out,
+                    &parsed,
+                    &trailing_zero_count,
+                    &is_zero,
+                    &is_null);
+
+    switch (handle_spec_result) {
+        case E_HANDLE_SPEC_OK:
+            break;
+        case E_HANDLE_SPEC_REACHED_END:
+            return false;
+        case E_HANDLE_SPEC_CONTINUE:
+            *iter_out = iter + 1;
+            return true;
+    }
+
+    *iter_out = iter + 1;
+
+    uint32_t padded_zero_count = 0;
+    uint32_t parsed_length = parsed.length + trailing_zero_count;
+
+    // is_zero being true implies spec is an integer.
+    // We don't write anything if we have a '0' and precision is 0.
+
+    bool should_write_parsed = !(is_zero && curr_spec->precision == 0);
+    if (!should_write_parsed && *parsed.begin == '+') {
+        // A zero without digits still gets its sign.
+        parsed.length = 1;
+        parsed_length = 1;
+        should_write_parsed = true;
+    }
+
+    // '#' doesn't prefix a zero, and for octal, only makes sure the first
+    // digit is a zero, which a zero value or a wider precision already do.
+    if (curr_spec->add_base_prefix && is_int_specifier(curr_spec->spec)) {
+        if (curr_spec->spec == 'o') {
+            if (is_zero) {
+                should_write_parsed = true;
+                curr_spec->add_base_prefix = false;
+            } else if (curr_spec->precision > (int)parsed.length) {
+                curr_spec->add_base_prefix = false;
+            }
+        } else if (is_zero) {
+            curr_spec->add_base_prefix = false;
+        }
+    }
+
+    if (should_write_parsed) {
+        if (curr_spec->add_base_prefix) {
+            switch (curr_spec->spec) {
+                case 'b':
+                case 'B':
+                    parsed_length += 2;
+                    break;
+                case 'o':
+                    parsed_length += 1;
+                    break;
+                case 'x':
+                case 'X':
+                    parsed_length += 2;
+                    break;
+            }
+        }
+    } else {
+        parsed_length = 0;
+    }
+
+    // We have to pad with either spaces or zeroes if we're not wider than
+    // the specified width,
+
+    const bool is_fixed_point = is_fixed_point_specifier(curr_spec->spec);
+
+    uint32_t space_pad_count = 0;
+    uint32_t sign_space_count = 0;
+
+    if (is_int_specifier(curr_spec->spec) || is_fixed_point) {
+        if (curr_spec->precision != -1 && !is_fixed_point) {
+            // The case for the string-spec was already handled above
+            // Total digit count doesn't include the sign/prefix.
+
+            uint8_t total_digit_count = parsed.length;
+            if (*parsed.begin == '-' || *parsed.begin == '+') {
+                total_digit_count -= 1;
+            }
+
+            if (total_digit_count < curr_spec->precision) {
+                padded_zero_count =
+                    (uint32_t)curr_spec->precision - total_digit_count;
+
+                parsed_length += padded_zero_count;
+            }
+        }
+
+        // Only signed conversions get a space in place of a sign.
+        const bool is_signed = curr_spec->spec == 'd'
+                               || curr_spec->spec == 'i'
+                               || is_fixed_point;
+
+        if (curr_spec->add_one_space_for_sign && is_signed) {
+            // Only add a sign if we have neither a '+' or '-'
+            if (*parsed.begin != '+' && *parsed.begin != '-') {
+                sign_space_count = 1;
+                parsed_length += 1;
+            }
+        }
+    }
+
+    if (parsed_length < curr_spec->width) {
+        // For fixed-point numbers, precision only controls the fraction
+        // digits, so it doesn't disable zero-padding.
+
+        const bool pad_with_zeros =
+            curr_spec->leftpad_zeros
+            && ((is_int_specifier(curr_spec->spec)
+                 && curr_spec->precision == -1)
+                || is_fixed_point)
+            && !curr_spec->left_justify; // Zeros are never left-justified
+
+        if (pad_with_zeros) {
+            // We're always resetting padded_zero_count if it was set before
+            padded_zero_count = curr_spec->width - parsed_length;
+        } else {
+            space_pad_count += curr_spec->width - parsed_length;
+        }
+    }
+
+    // Integers are written as at most one run of spaces and one string.
+    // When left-justified, the space for a sign is part of the string.
+    if (!should_write_parsed) {
+        parsed.length = 0;
+    }
+
+    if (is_int_specifier(curr_spec->spec)
+        && !is_null
+        && assemble_int_field(curr_spec,
+                              field_buffer,
+                              &parsed,
+                              padded_zero_count,
+                              curr_spec->left_justify ? sign_space_count
+                                                     : 0))
+    {
+        if (!curr_spec->left_justify) {
+            space_pad_count += sign_space_count;
+        }
+
+        if (!curr_spec->left_justify && space_pad_count != 0) {
+            *written_out +=
+                sink_write_char(sink,
+                              curr_spec,
+                              ' ',
+                              space_pad_count,
+                              &should_continue);
+
+            if (!should_continue) {
+                return false;
+            }
+        }
+
+        if (parsed.length != 0) {
+            *written_out +=
+                call_cb(curr_spec,
+                        parsed,
+                        sink,
+                        &should_continue);
+
+            if (!should_continue) {
+                return false;
+            }
+        }
+
+        if (curr_spec->left_justify && space_pad_count != 0) {
+            *written_out +=
+                sink_write_char(sink,
+                              curr_spec,
+                              ' ',
+                              space_pad_count,
+                              &should_continue);
+
+            if (!should_continue) {
+                return false;
+            }
+        }
+    } else if (curr_spec->left_justify) {
+        if (sign_space_count != 0) {
+            *written_out +=
+                sink_write_char(sink,
+                              curr_spec,
+                              ' ',
+                              sign_space_count,
+                              &should_continue);
+
+            if (!should_continue) {
+                return false;
+            }
+        }
+
+        *written_out +=
+            pad_with_lead_zeros(curr_spec,
+                                &parsed,
+                                padded_zero_count,
+                                is_null,
+                                sink,
+                                &should_continue);
+
+        if (!should_continue) {
+            return false;
+        }
+
+        if (should_write_parsed) {
+            *written_out +=
+                call_cb(curr_spec,
+                        parsed,
+                        sink,
+                        &should_continue);
+
+            if (!should_continue) {
+                return false;
+            }
+        }
+
+        if (trailing_zero_count != 0) {
+            *written_out +=
+                sink_write_char(sink,
+                              curr_spec,
+                              '0',
+                              trailing_zero_count,
+                              &should_continue);
+
+            if (!should_continue) {
+                return false;
+            }
+        }
+
+        if (space_pad_count != 0) {
+            *written_out +=
+                sink_write_char(sink,
+                              curr_spec,
+                              ' ',
+                              space_pad_count,
+                              &should_continue);
+
+            if (!should_continue) {
+                return false;
+            }
+        }
+    } else {
+        // The space for a sign goes after any padding spaces.
+        space_pad_count += sign_space_count;
+        if (space_pad_count != 0) {
+            *written_out +=
+                sink_write_char(sink,
+                              curr_spec,
+                              ' ',
+                              space_pad_count,
+                              &should_continue);
+
+            if (!should_continue) {
+                return false;
+            }
+        }
+
+        *written_out +=
+            pad_with_lead_zeros(curr_spec,
+                                &parsed,
+                                padded_zero_count,
+                                is_null,
+                                sink,
+                                &should_continue);
+
+        if (!should_continue) {
+            return false;
+        }
+
+        if (should_write_parsed) {
+            *written_out +=
+                call_cb(curr_spec,
+                        parsed,
+                        sink,
+                        &should_continue);
+
+            if (!should_continue) {
+                return false;
+            }
+        }
+
+        if (trailing_zero_count != 0) {
+            *written_out +=
+                sink_write_char(sink,
+                              curr_spec,
+                              '0',
+                              trailing_zero_count,
+                              &should_continue);
+
+            if (!should_continue) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Arguments come from args if it isn't NULL, and from list otherwise. table is
+ * only used for list.
+ *
+ * field_buffer and list_struct are working memory, which a struct
+ * printf_context keeps between calls. Their contents don't matter, as every
+ * conversion writes the digits it reads back.
+ */
+
+static uint64_t
+format_with_state(const struct printf_sink *const sink,
+                  char *const field_buffer,
+                  struct va_list_struct *const list_struct,
+                  const char *const fmt,
+                  const struct printf_arg_table *table,
+                  const uint64_t *const args,
+                  va_list list)
+{
+    const char *iter = printf_find_percent(fmt);
+    const bool positional = __builtin_expect(format_is_positional(iter), 0);
+
+    // Only pre-scan the format if the caller didn't give us a table.
+    struct printf_arg_table local_table;
+    if (args == NULL && table == NULL && positional) {
+        if (!printf_arg_table_init(&local_table, fmt)) {
+            return 0;
+        }
+
+        table = &local_table;
+    }
+
+    va_copy(list_struct->list, list);
+
+    list_struct->positional = positional;
+    list_struct->positional_args = args;
+    list_struct->positional_index = 0;
+
+    uint64_t loaded_args[PRINTF_MAX_POSITIONAL_ARGS];
+    if (args == NULL && table != NULL && table->count != 0) {
+        load_positional_args(table, list, loaded_args);
+        list_struct->positional_args = loaded_args;
+    }
+
+    // Positional arguments can only be read from a table.
+    if (positional && list_struct->positional_args == NULL) {
+        va_end(list_struct->list);
+        return 0;
+    }
+
+    struct printf_spec_info curr_spec = PRINTF_SPEC_INFO_INIT();
+    const char *unformatted_start = fmt;
+
+    uint64_t written_out = 0;
+    bool should_continue = true;
+
+    for (; iter != NULL; iter = printf_find_percent(iter)) {
+        const struct string_view unformatted =
+            sv_create_end(unformatted_start, iter);
+
+        written_out +=
+            call_cb(NULL,
+                    unformatted,
+                    sink,
+                    &should_continue);
+
+        if (!should_continue) {
+            break;
+        }
+
+        iter++;
+        if (*iter == '\0') {
+            // If we only got a percent sign, then we don't print anything
+            va_end(list_struct->list);
+            return written_out;
+        }
+
+        // Format is %[position$][flags][width][.precision][length]specifier
+        uint32_t value_position = 0;
+        if (list_struct->positional && *iter != '%') {
+            value_position = read_positional_index(iter, &iter);
+            if (value_position == 0) {
+                va_end(list_struct->list);
+                return written_out;
+            }
+        }
+
+        if (!parse_flags(&curr_spec, iter, &iter)) {
+            // If we have an incomplete spec, then we exit without writing
+            // anything.
+            va_end(list_struct->list);
+            return written_out;
+        }
+
+        if (!parse_width(&curr_spec, list_struct, iter, &iter)) {
+            // If we have an incomplete spec, then we exit without writing
+            // anything.
+            va_end(list_struct->list);
+            return written_out;
+        }
+
+        if (!parse_precision(&curr_spec, iter, list_struct, &iter)) {
+            // If we have an incomplete spec, then we exit without writing
+            // anything.
+            va_end(list_struct->list);
+            return written_out;
+        }
+
+        if (value_position != 0) {
+            list_struct->positional_index = value_position - 1;
+        }
+
+        if (!format_conversion(sink,
+                               &curr_spec,
+                               field_buffer,
+                               list_struct,
+                               iter,
+                               &iter,
+                               &written_out))
+        {
+            va_end(list_struct->list);
+            return written_out;
+        }
+
+        unformatted_start = iter;
+
+        curr_spec = PRINTF_SPEC_INFO_INIT();
+    }
+
+    if (*unformatted_start != '\0') {
+        const struct string_view unformatted =
+            sv_create_length(unformatted_start,
+                             printf_strlen(unformatted_start));
 
         written_out +=
             call_cb(NULL,
                     unformatted,
-                    write_char_cb,
-                    write_char_cb_info,
-                    write_string_cb,
-                    write_string_cb_info,
+                    sink,
                     &should_continue);
     }
 
-    va_end(list_struct.list);
+    va_end(list_struct->list);
+    return written_out;
+}
+
+static inline uint64_t
+format_with_args(const struct printf_sink *const sink,
+                 const char *const fmt,
+                 const struct printf_arg_table *const table,
+                 const uint64_t *const args,
+                 va_list list)
+{
+    char field_buffer[FIELD_HEADROOM_LENGTH + LARGEST_BUFFER_LENGTH];
+    struct va_list_struct list_struct;
+
+    return format_with_state(sink,
+                             field_buffer,
+                             &list_struct,
+                             fmt,
+                             table,
+                             args,
+                             list);
+}
+
+/*
+ * Adapt 32-bit callbacks, passed in a struct printf_sink32, to the engine.
+ * Fills are never wider than a field's width, which fits in 32 bits, but
+ * strings are passed in pieces if they're 4 GiB or longer.
+ */
+
+static size_t
+write_char_cb32(struct printf_spec_info *const spec_info,
+                void *const info,
+                const char ch,
+                const size_t times,
+                bool *const should_continue_out)
+{
+    const struct printf_sink32 *const sink = (const struct printf_sink32 *)info;
+    return sink->write_char_cb(spec_info,
+                               sink->char_cb_info,
+                               ch,
+                               (uint32_t)times,
+                               should_continue_out);
+}
+
+static size_t
+write_string_cb32(struct printf_spec_info *const spec_info,
+                  void *const info,
+                  const char *string,
+                  size_t length,
+                  bool *const should_continue_out)
+{
+    const struct printf_sink32 *const sink = (const struct printf_sink32 *)info;
+    if (__builtin_expect(length <= UINT32_MAX, 1)) {
+        return sink->write_string_cb(spec_info,
+                                     sink->string_cb_info,
+                                     string,
+                                     (uint32_t)length,
+                                     should_continue_out);
+    }
+
+    size_t out = 0;
+    while (length != 0 && *should_continue_out) {
+        const uint32_t amount =
+            length > UINT32_MAX ? UINT32_MAX : (uint32_t)length;
+
+        out += sink->write_string_cb(spec_info,
+                                     sink->string_cb_info,
+                                     string,
+                                     amount,
+                                     should_continue_out);
+
+        string += amount;
+        length -= amount;
+    }
+
+    return out;
+}
+
+#define PRINTF_SINK_FOR_SINK32(sink32) \
+    ((struct printf_sink){ \
+        .write_char_cb = write_char_cb32, \
+        .char_cb_info = (void *)(sink32), \
+        .write_string_cb = write_string_cb32, \
+        .string_cb_info = (void *)(sink32) \
+    })
+
+// Only used to get a valid, empty va_list.
+static uint64_t
+format_with_args_only(const struct printf_sink *const sink,
+                      const char *const fmt,
+                      const uint64_t *const args,
+                      ...)
+{
+    va_list list;
+    va_start(list, args);
+
+    const uint64_t result =
+        format_with_args(sink, fmt, /*table=*/NULL, args, list);
+
+    va_end(list);
+    return result;
+}
+
+/*
+ * If widths isn't NULL, conversion i is at least widths[i] wide. If lengths
+ * isn't NULL, lengths[i] is set to the length of conversion i.
+ */
+
+static uint64_t
+format_compiled_specs(const struct printf_sink *const sink,
+                      const struct printf_compiled_format *const compiled,
+                      const uint32_t *const widths,
+                      uint32_t *const lengths,
+                      struct va_list_struct *const list_struct)
+{
+    char field_buffer[FIELD_HEADROOM_LENGTH + LARGEST_BUFFER_LENGTH];
+
+    uint64_t written_out = 0;
+    bool should_continue = true;
+
+    for (uint32_t i = 0; i != compiled->spec_count; i++) {
+        const struct printf_compiled_spec *const spec = &compiled->specs[i];
+
+        written_out +=
+            call_cb(NULL,
+                    sv_create_length(spec->literal, spec->literal_length),
+                    sink,
+                    &should_continue);
+
+        if (!should_continue) {
+            return written_out;
+        }
+
+        struct printf_spec_info curr_spec = spec->info;
+        if (spec->width_from_arg) {
+            set_width_from_arg(&curr_spec, next_int_arg(list_struct, int));
+        }
+
+        if (spec->precision_from_arg) {
+            set_precision_from_arg(&curr_spec,
+                                   next_int_arg(list_struct, int));
+        }
+
+        if (widths != NULL && curr_spec.width < widths[i]) {
+            curr_spec.width = widths[i];
+        }
+
+        const uint64_t conversion_start = written_out;
+        const char *iter = NULL;
+
+        const bool keep_going =
+            format_conversion(sink,
+                              &curr_spec,
+                              field_buffer,
+                              list_struct,
+                              spec->conversion,
+                              &iter,
+                              &written_out);
+
+        if (lengths != NULL) {
+            lengths[i] = (uint32_t)(written_out - conversion_start);
+        }
+
+        if (!keep_going) {
+            return written_out;
+        }
+    }
+
+    written_out +=
+        call_cb(NULL,
+                sv_create_length(compiled->trailing,
+                                 compiled->trailing_length),
+                sink,
+                &should_continue);
+
     return written_out;
+}
+
+static uint64_t
+format_compiled(const struct printf_sink *const sink,
+                const struct printf_compiled_format *const compiled,
+                va_list list)
+{
+    struct va_list_struct list_struct = {0};
+    va_copy(list_struct.list, list);
+
+    const uint64_t result =
+        format_compiled_specs(sink,
+                              compiled,
+                              /*widths=*/NULL,
+                              /*lengths=*/NULL,
+                              &list_struct);
+
+    va_end(list_struct.list);
+    return result;
+}
+
+// Only used to get a valid, empty va_list.
+static uint64_t
+format_compiled_with_args_only(
+    const struct printf_sink *const sink,
+    const struct printf_compiled_format *const compiled,
+    const uint32_t *const widths,
+    uint32_t *const lengths,
+    const uint64_t *const args,
+    ...)
+{
+    struct va_list_struct list_struct = {
+        .positional_args = args
+    };
+
+    va_start(list_struct.list, args);
+
+    const uint64_t result =
+        format_compiled_specs(sink, compiled, widths, lengths, &list_struct);
+
+    va_end(list_struct.list);
+    return result;
+}
+
+/******* PUBLIC FUNCTIONS *******/
+
+void printf_set_digit_grouping(const char separator, const uint8_t group_size) {
+#if PRINTF_ENABLE_DIGIT_GROUPING
+    digit_grouping.separator = separator;
+    digit_grouping.size = group_size;
+#else
+    (void)separator;
+    (void)group_size;
+#endif /* PRINTF_ENABLE_DIGIT_GROUPING */
+}
+
+bool
+printf_arg_table_init(struct printf_arg_table *const table,
+                      const char *const fmt)
+{
+    table->count = 0;
+    printf_memset(table->types, 0, sizeof(table->types));
+
+    const char *const iter = printf_find_percent(fmt);
+    if (!format_is_positional(iter)) {
+        return true;
+    }
+
+    return scan_format(table, iter, /*next_position=*/NULL);
+}
+
+bool
+printf_arg_table_scan(struct printf_arg_table *const table,
+                      const char *const fmt)
+{
+    table->count = 0;
+    printf_memset(table->types, 0, sizeof(table->types));
+
+    const char *const iter = printf_find_percent(fmt);
+    if (format_is_positional(iter)) {
+        return scan_format(table, iter, /*next_position=*/NULL);
+    }
+
+    uint32_t next_position = 0;
+    return scan_format(table, iter, &next_position);
+}
+
+uint32_t
+parse_printf_format(const printf_write_char_callback_t write_char_cb,
+                    void *const write_char_cb_info,
+                    const printf_write_string_callback_t write_string_cb,
+                    void *const write_string_cb_info,
+                    const char *const fmt,
+                    va_list list)
+{
+    return parse_printf_format_with_arg_table(write_char_cb,
+                                              write_char_cb_info,
+                                              write_string_cb,
+                                              write_string_cb_info,
+                                              fmt,
+                                              /*table=*/NULL,
+                                              list);
+}
+
+uint32_t
+parse_printf_format_with_arg_table(
+    const printf_write_char_callback_t write_char_cb,
+    void *const write_char_cb_info,
+    const printf_write_string_callback_t write_string_cb,
+    void *const write_string_cb_info,
+    const char *const fmt,
+    const struct printf_arg_table *const table,
+    va_list list)
+{
+    const struct printf_sink32 sink32 = {
+        .write_char_cb = write_char_cb,
+        .char_cb_info = write_char_cb_info,
+        .write_string_cb = write_string_cb,
+        .string_cb_info = write_string_cb_info
+    };
+
+    const struct printf_sink sink = PRINTF_SINK_FOR_SINK32(&sink32);
+    return (uint32_t)format_with_args(&sink, fmt, table, /*args=*/NULL, list);
+}
+
+uint32_t
+parse_printf_format_with_args(
+    const printf_write_char_callback_t write_char_cb,
+    void *const write_char_cb_info,
+    const printf_write_string_callback_t write_string_cb,
+    void *const write_string_cb_info,
+    const char *const fmt,
+    const uint64_t *const args)
+{
+    const struct printf_sink32 sink32 = {
+        .write_char_cb = write_char_cb,
+        .char_cb_info = write_char_cb_info,
+        .write_string_cb = write_string_cb,
+        .string_cb_info = write_string_cb_info
+    };
+
+    const struct printf_sink sink = PRINTF_SINK_FOR_SINK32(&sink32);
+    return (uint32_t)format_with_args_only(&sink, fmt, args);
+}
+
+uint64_t
+parse_printf_format64(const printf_write_char_callback64_t write_char_cb,
+                      void *const write_char_cb_info,
+                      const printf_write_string_callback64_t write_string_cb,
+                      void *const write_string_cb_info,
+                      const char *const fmt,
+                      va_list list)
+{
+    return parse_printf_format_with_arg_table64(write_char_cb,
+                                                write_char_cb_info,
+                                                write_string_cb,
+                                                write_string_cb_info,
+                                                fmt,
+                                                /*table=*/NULL,
+                                                list);
+}
+
+uint64_t
+parse_printf_format_with_arg_table64(
+    const printf_write_char_callback64_t write_char_cb,
+    void *const write_char_cb_info,
+    const printf_write_string_callback64_t write_string_cb,
+    void *const write_string_cb_info,
+    const char *const fmt,
+    const struct printf_arg_table *const table,
+    va_list list)
+{
+    const struct printf_sink sink = {
+        .write_char_cb = write_char_cb,
+        .char_cb_info = write_char_cb_info,
+        .write_string_cb = write_string_cb,
+        .string_cb_info = write_string_cb_info
+    };
+
+    return format_with_args(&sink, fmt, table, /*args=*/NULL, list);
+}
+
+uint64_t
+parse_printf_format_with_args64(
+    const printf_write_char_callback64_t write_char_cb,
+    void *const write_char_cb_info,
+    const printf_write_string_callback64_t write_string_cb,
+    void *const write_string_cb_info,
+    const char *const fmt,
+    const uint64_t *const args)
+{
+    const struct printf_sink sink = {
+        .write_char_cb = write_char_cb,
+        .char_cb_info = write_char_cb_info,
+        .write_string_cb = write_string_cb,
+        .string_cb_info = write_string_cb_info
+    };
+
+    return format_with_args_only(&sink, fmt, args);
+}
+
+bool
+printf_compile_format(struct printf_compiled_format *const compiled,
+                      struct printf_compiled_spec *const specs,
+                      const uint32_t capacity,
+                      const char *const fmt)
+{
+    const char *iter = printf_find_percent(fmt);
+    if (format_is_positional(iter)) {
+        return false;
+    }
+
+    const char *literal = fmt;
+    uint32_t count = 0;
+
+    // Mirrors the parsing in format_with_args(), without reading arguments.
+    for (; iter != NULL; iter = printf_find_percent(iter)) {
+        if (count == capacity) {
+            return false;
+        }
+
+        struct printf_compiled_spec *const spec = &specs[count];
+        *spec = (struct printf_compiled_spec){
+            .literal = literal,
+            .literal_length = (uint32_t)(iter - literal),
+            .info = PRINTF_SPEC_INFO_INIT()
+        };
+
+        iter++;
+        if (!parse_flags(&spec->info, iter, &iter)) {
+            return false;
+        }
+
+        if (*iter == '*') {
+            spec->width_from_arg = true;
+            iter++;
+        } else {
+            const int width = read_int_from_fmt_string(iter, &iter);
+            if (width == -1) {
+                return false;
+            }
+
+            spec->info.width = (uint32_t)width;
+        }
+
+        if (*iter == '\0') {
+            return false;
+        }
+
+        spec->info.precision = -1;
+        if (*iter == '.') {
+            iter++;
+            if (*iter == '*') {
+                spec->precision_from_arg = true;
+                iter++;
+            } else {
+                spec->info.precision = read_int_from_fmt_string(iter, &iter);
+                if (spec->info.precision == -1) {
+                    return false;
+                }
+            }
+
+            if (*iter == '\0') {
+                return false;
+            }
+        }
+
+        spec->conversion = iter;
+        while (*iter == 'h' || *iter == 'l' || *iter == 'j' || *iter == 'z'
+               || *iter == 't')
+        {
+            iter++;
+        }
+
+        if (*iter == '\0') {
+            return false;
+        }
+
+        iter++;
+        literal = iter;
+        count++;
+    }
+
+    *compiled = (struct printf_compiled_format){
+        .specs = specs,
+        .spec_count = count,
+        .trailing = literal,
+        .trailing_length = (uint32_t)printf_strlen(literal)
+    };
+
+    return true;
+}
+
+uint32_t
+parse_printf_compiled(const printf_write_char_callback_t write_char_cb,
+                      void *const write_char_cb_info,
+                      const printf_write_string_callback_t write_string_cb,
+                      void *const write_string_cb_info,
+                      const struct printf_compiled_format *const compiled,
+                      const char *const fmt,
+                      va_list list)
+{
+    const struct printf_sink32 sink32 = {
+        .write_char_cb = write_char_cb,
+        .char_cb_info = write_char_cb_info,
+        .write_string_cb = write_string_cb,
+        .string_cb_info = write_string_cb_info
+    };
+
+    const struct printf_sink sink = PRINTF_SINK_FOR_SINK32(&sink32);
+    if (compiled == NULL) {
+        return (uint32_t)format_with_args(&sink,
+                                          fmt,
+                                          /*table=*/NULL,
+                                          /*args=*/NULL,
+                                          list);
+    }
+
+    return (uint32_t)format_compiled(&sink, compiled, list);
+}
+
+uint64_t
+parse_printf_compiled64(const printf_write_char_callback64_t write_char_cb,
+                        void *const write_char_cb_info,
+                        const printf_write_string_callback64_t write_string_cb,
+                        void *const write_string_cb_info,
+                        const struct printf_compiled_format *const compiled,
+                        const char *const fmt,
+                        va_list list)
+{
+    const struct printf_sink sink = {
+        .write_char_cb = write_char_cb,
+        .char_cb_info = write_char_cb_info,
+        .write_string_cb = write_string_cb,
+        .string_cb_info = write_string_cb_info
+    };
+
+    if (compiled == NULL) {
+        return format_with_args(&sink,
+                                fmt,
+                                /*table=*/NULL,
+                                /*args=*/NULL,
+                                list);
+    }
+
+    return format_compiled(&sink, compiled, list);
+}
+
+void
+printf_context_init(struct printf_context *const context,
+                    const printf_write_char_callback64_t write_char_cb,
+                    void *const write_char_cb_info,
+                    const printf_write_string_callback64_t write_string_cb,
+                    void *const write_string_cb_info)
+{
+    context->sink = (struct printf_sink){
+        .write_char_cb = write_char_cb,
+        .char_cb_info = write_char_cb_info,
+        .write_string_cb = write_string_cb,
+        .string_cb_info = write_string_cb_info
+    };
+}
+
+uint64_t
+parse_printf_format_with_context(struct printf_context *const context,
+                                 const char *const fmt,
+                                 va_list list)
+{
+    return format_with_state(&context->sink,
+                             context->field_buffer,
+                             &context->list_struct,
+                             fmt,
+                             /*table=*/NULL,
+                             /*args=*/NULL,
+                             list);
+}
+
+uint32_t
+parse_printf_compiled_with_args(
+    const printf_write_char_callback_t write_char_cb,
+    void *const write_char_cb_info,
+    const printf_write_string_callback_t write_string_cb,
+    void *const write_string_cb_info,
+    const struct printf_compiled_format *const compiled,
+    const uint32_t *const widths,
+    uint32_t *const lengths,
+    const uint64_t *const args)
+{
+    const struct printf_sink32 sink32 = {
+        .write_char_cb = write_char_cb,
+        .char_cb_info = write_char_cb_info,
+        .write_string_cb = write_string_cb,
+        .string_cb_info = write_string_cb_info
+    };
+
+    const struct printf_sink sink = PRINTF_SINK_FOR_SINK32(&sink32);
+    return (uint32_t)format_compiled_with_args_only(&sink,
+                                                    compiled,
+                                                    widths,
+                                                    lengths,
+                                                    args);
+}
+
+uint64_t
+parse_printf_compiled_with_args64(
+    const printf_write_char_callback64_t write_char_cb,
+    void *const write_char_cb_info,
+    const printf_write_string_callback64_t write_string_cb,
+    void *const write_string_cb_info,
+    const struct printf_compiled_format *const compiled,
+    const uint32_t *const widths,
+    uint32_t *const lengths,
+    const uint64_t *const args)
+{
+    const struct printf_sink sink = {
+        .write_char_cb = write_char_cb,
+        .char_cb_info = write_char_cb_info,
+        .write_string_cb = write_string_cb,
+        .string_cb_info = write_string_cb_info
+    };
+
+    return format_compiled_with_args_only(&sink,
+                                          compiled,
+                                          widths,
+                                          lengths,
+                                          args);
 }
\ No newline at end of file
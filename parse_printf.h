@@ -24,14 +24,18 @@ SOFTWARE.
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#include "printf_config.h"
+
 struct printf_spec_info {
     bool add_one_space_for_sign : 1;
     bool left_justify : 1;
     bool add_pos_sign : 1;
     bool add_base_prefix : 1;
     bool leftpad_zeros : 1;
+    bool group_digits : 1;
 
     char spec;
     uint32_t width;
@@ -47,6 +51,7 @@ struct printf_spec_info {
         .left_justify = false, \
         .add_pos_sign = false, \
         .leftpad_zeros = false, \
+        .group_digits = false, \
         .spec = '\0', \
         .width = 0, \
         .precision = 0, \
@@ -82,3 +87,298 @@ parse_printf_format(printf_write_char_callback_t write_char_cb,
                     void *sv_cb_info,
                     const char *fmt,
                     va_list list);
+
+/*
+ * 64-bit counterparts of the callbacks and functions in this header, for
+ * output that can pass 4 GiB, like long reports streamed to a file.
+ *
+ * Callbacks get size_t lengths, the total is counted and returned in 64 bits,
+ * and %ln, %lln, %jn, %zn and %tn store the full count (narrower %n
+ * conversions are truncated, as with the 32-bit functions). Otherwise they
+ * behave just like their 32-bit counterparts.
+ */
+
+typedef size_t
+(*printf_write_char_callback64_t)(struct printf_spec_info *spec_info,
+                                  void *info,
+                                  char ch,
+                                  size_t times,
+                                  bool *should_continue_out);
+
+typedef size_t
+(*printf_write_string_callback64_t)(struct printf_spec_info *spec_info,
+                                    void *info,
+                                    const char *string,
+                                    size_t length,
+                                    bool *should_continue_out);
+
+uint64_t
+parse_printf_format64(printf_write_char_callback64_t write_char_cb,
+                      void *char_cb_info,
+                      printf_write_string_callback64_t write_string_cb,
+                      void *sv_cb_info,
+                      const char *fmt,
+                      va_list list);
+
+/*
+ * Set the separator and group size used for the ' (digit-grouping) flag, which
+ * defaults to ',' and 3. A group size of 0 disables grouping.
+ *
+ * This setting is process-wide and read without synchronization, so it must be
+ * set before any thread starts formatting.
+ */
+
+void printf_set_digit_grouping(char separator, uint8_t group_size);
+
+/*
+ * Positional arguments (%n$, *n$) are supported without allocation.
+ *
+ * When parse_printf_format() sees a positional format, it pre-scans the format
+ * once to build a table of argument types on the stack. Callers that format the
+ * same string repeatedly can build the table once with printf_arg_table_init()
+ * and pass it to parse_printf_format_with_arg_table() to skip the pre-scan.
+ *
+ * Formats without positional arguments get a table with a count of zero, and
+ * are formatted exactly as parse_printf_format() would.
+ */
+
+#define PRINTF_MAX_POSITIONAL_ARGS 32
+
+enum printf_arg_type {
+    PRINTF_ARG_TYPE_NONE,
+    PRINTF_ARG_TYPE_INT,
+    PRINTF_ARG_TYPE_LONG,
+    PRINTF_ARG_TYPE_LONG_LONG,
+    PRINTF_ARG_TYPE_INTMAX,
+    PRINTF_ARG_TYPE_SIZE,
+    PRINTF_ARG_TYPE_PTRDIFF,
+    PRINTF_ARG_TYPE_POINTER,
+    PRINTF_ARG_TYPE_STRING,
+
+    // The pointer argument of %n.
+    PRINTF_ARG_TYPE_WRITE_BACK,
+};
+
+// types holds an enum printf_arg_type for each argument.
+struct printf_arg_table {
+    uint8_t count;
+    uint8_t types[PRINTF_MAX_POSITIONAL_ARGS];
+};
+
+/*
+ * Returns false if fmt mixes up positional argument types, skips an argument,
+ * or refers to an argument past PRINTF_MAX_POSITIONAL_ARGS.
+ */
+
+bool printf_arg_table_init(struct printf_arg_table *table, const char *fmt);
+
+uint32_t
+parse_printf_format_with_arg_table(printf_write_char_callback_t write_char_cb,
+                                   void *char_cb_info,
+                                   printf_write_string_callback_t write_sv_cb,
+                                   void *sv_cb_info,
+                                   const char *fmt,
+                                   const struct printf_arg_table *table,
+                                   va_list list);
+
+uint64_t
+parse_printf_format_with_arg_table64(
+    printf_write_char_callback64_t write_char_cb,
+    void *char_cb_info,
+    printf_write_string_callback64_t write_sv_cb,
+    void *sv_cb_info,
+    const char *fmt,
+    const struct printf_arg_table *table,
+    va_list list);
+
+/*
+ * Like printf_arg_table_init(), but also records the arguments of sequential
+ * formats, in the order they're consumed. A sequential table can still be
+ * passed to parse_printf_format_with_arg_table().
+ */
+
+bool printf_arg_table_scan(struct printf_arg_table *table, const char *fmt);
+
+/*
+ * Format with arguments that were already decoded, e.g. from a stored record,
+ * rather than from a va_list. args[i] holds argument i + 1, as typed by
+ * printf_arg_table_scan(): integers are sign- or zero-extended to 64 bits, and
+ * pointers are stored as uintptr_t. args must hold every argument fmt uses.
+ */
+
+uint32_t
+parse_printf_format_with_args(printf_write_char_callback_t write_char_cb,
+                              void *char_cb_info,
+                              printf_write_string_callback_t write_sv_cb,
+                              void *sv_cb_info,
+                              const char *fmt,
+                              const uint64_t *args);
+
+uint64_t
+parse_printf_format_with_args64(printf_write_char_callback64_t write_char_cb,
+                                void *char_cb_info,
+                                printf_write_string_callback64_t write_sv_cb,
+                                void *sv_cb_info,
+                                const char *fmt,
+                                const uint64_t *args);
+
+/*
+ * A format parsed ahead of time, so it can be formatted without being parsed
+ * again. Tables for literal formats are generated at build time by the
+ * printf_precompile tool (see printf_compiled.h), and placed in read-only
+ * memory.
+ *
+ * Each spec is the literal text before a conversion, and the conversion's
+ * flags, width and precision, as parse_printf_format() would parse them.
+ */
+
+struct printf_compiled_spec {
+    const char *literal;
+    uint32_t literal_length;
+
+    // Set if the width or precision is read from a '*' argument.
+    bool width_from_arg : 1;
+    bool precision_from_arg : 1;
+
+    struct printf_spec_info info;
+
+    // The length modifier and specifier, e.g. "lld".
+    const char *conversion;
+};
+
+struct printf_compiled_format {
+    const struct printf_compiled_spec *specs;
+    uint32_t spec_count;
+
+    // The literal text after the last conversion.
+    const char *trailing;
+    uint32_t trailing_length;
+};
+
+/*
+ * Parse fmt into compiled, using up to capacity specs. The literals and
+ * conversions point into fmt.
+ *
+ * Returns false if fmt has more conversions than capacity, ends in an
+ * incomplete conversion, or uses positional arguments, which must be
+ * formatted with parse_printf_format() instead.
+ */
+
+bool
+printf_compile_format(struct printf_compiled_format *compiled,
+                      struct printf_compiled_spec *specs,
+                      uint32_t capacity,
+                      const char *fmt);
+
+// Format compiled, or parse fmt as parse_printf_format() does if it's NULL.
+uint32_t
+parse_printf_compiled(printf_write_char_callback_t write_char_cb,
+                      void *char_cb_info,
+                      printf_write_string_callback_t write_sv_cb,
+                      void *sv_cb_info,
+                      const struct printf_compiled_format *compiled,
+                      const char *fmt,
+                      va_list list);
+
+uint64_t
+parse_printf_compiled64(printf_write_char_callback64_t write_char_cb,
+                        void *char_cb_info,
+                        printf_write_string_callback64_t write_sv_cb,
+                        void *sv_cb_info,
+                        const struct printf_compiled_format *compiled,
+                        const char *fmt,
+                        va_list list);
+
+/*
+ * Format compiled with arguments that were already decoded, as
+ * parse_printf_format_with_args() does.
+ *
+ * If widths isn't NULL, conversion i is padded to at least widths[i], as if it
+ * had that width. If lengths isn't NULL, lengths[i] is set to the length of
+ * conversion i, for each conversion that's written.
+ */
+
+uint32_t
+parse_printf_compiled_with_args(
+    printf_write_char_callback_t write_char_cb,
+    void *char_cb_info,
+    printf_write_string_callback_t write_sv_cb,
+    void *sv_cb_info,
+    const struct printf_compiled_format *compiled,
+    const uint32_t *widths,
+    uint32_t *lengths,
+    const uint64_t *args);
+
+uint64_t
+parse_printf_compiled_with_args64(
+    printf_write_char_callback64_t write_char_cb,
+    void *char_cb_info,
+    printf_write_string_callback64_t write_sv_cb,
+    void *sv_cb_info,
+    const struct printf_compiled_format *compiled,
+    const uint32_t *widths,
+    uint32_t *lengths,
+    const uint64_t *args);
+
+/*
+ * Where output goes. The engine counts in 64 bits and only calls the 64-bit
+ * callbacks.
+ */
+
+struct printf_sink {
+    printf_write_char_callback64_t write_char_cb;
+    void *char_cb_info;
+
+    printf_write_string_callback64_t write_string_cb;
+    void *string_cb_info;
+};
+
+// The arguments of a format being formatted.
+struct va_list_struct {
+    va_list list;
+
+    // Set when the arguments were loaded up-front, either because the format
+    // uses positional arguments, or because the caller passed them in.
+    const uint64_t *positional_args;
+    uint32_t positional_index;
+
+    // Set if the format uses positional (%n$) arguments.
+    bool positional;
+};
+
+#ifndef PRINTF_CACHE_LINE_SIZE
+    #define PRINTF_CACHE_LINE_SIZE 64
+#endif /* PRINTF_CACHE_LINE_SIZE */
+
+// Room for the largest conversion, with its sign, base prefix and zeros.
+#define PRINTF_FIELD_BUFFER_LENGTH 100
+
+/*
+ * The sink and working memory of parse_printf_format_with_context(), set up
+ * once with printf_context_init() and reused by every call, so a thread that
+ * formats often keeps it hot in its own cache, e.g. as a _Thread_local.
+ *
+ * Contexts are aligned to, and padded to a multiple of, a cache line
+ * (PRINTF_CACHE_LINE_SIZE), so contexts of different threads never share one,
+ * even in an array. A context must only be used by one thread at a time.
+ */
+
+struct printf_context {
+    struct printf_sink sink;
+    struct va_list_struct list_struct;
+
+    char field_buffer[PRINTF_FIELD_BUFFER_LENGTH];
+} __attribute__((aligned(PRINTF_CACHE_LINE_SIZE)));
+
+void
+printf_context_init(struct printf_context *context,
+                    printf_write_char_callback64_t write_char_cb,
+                    void *char_cb_info,
+                    printf_write_string_callback64_t write_sv_cb,
+                    void *sv_cb_info);
+
+// Same as parse_printf_format64(), but writes through context's sink.
+uint64_t
+parse_printf_format_with_context(struct printf_context *context,
+                                 const char *fmt,
+                                 va_list list);
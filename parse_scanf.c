@@ -0,0 +1,669 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "parse_scanf.h"
+
+/******* PRIVATE FUNCTIONS *******/
+
+/*
+ * On little-endian targets, digits are classified and converted eight at a
+ * time in a 64-bit word (SWAR), whenever eight bytes of input are left.
+ */
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    #define SCANF_USE_SWAR 1
+#else
+    #define SCANF_USE_SWAR 0
+#endif
+
+#define SWAR_BYTES(byte) (0x0101010101010101ull * (uint8_t)(byte))
+#define SWAR_HIGH_BITS SWAR_BYTES(0x80)
+
+enum scanf_length {
+    SCANF_LENGTH_NONE,
+    SCANF_LENGTH_HH,
+    SCANF_LENGTH_H,
+    SCANF_LENGTH_L,
+    SCANF_LENGTH_LL,
+    SCANF_LENGTH_J,
+    SCANF_LENGTH_Z,
+    SCANF_LENGTH_T,
+};
+
+enum scan_result {
+    E_SCAN_OK,
+
+    // The input didn't match the format.
+    E_SCAN_MATCHING_FAILURE,
+
+    // The input ran out.
+    E_SCAN_INPUT_FAILURE,
+};
+
+struct scan_input {
+    const char *iter;
+    const char *end;
+};
+
+static const uint64_t powers_of_ten[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000
+};
+
+static inline bool is_space(const char ch) {
+    return ch == ' ' || (ch >= '\t' && ch <= '\r');
+}
+
+static void skip_space(struct scan_input *const input) {
+    while (input->iter != input->end && is_space(*input->iter)) {
+        input->iter++;
+    }
+}
+
+static inline uint32_t digit_value(const char ch) {
+    if (ch >= '0' && ch <= '9') {
+        return (uint32_t)(ch - '0');
+    }
+
+    const char lower = ch | 0x20;
+    if (lower >= 'a' && lower <= 'f') {
+        return (uint32_t)(lower - 'a' + 10);
+    }
+
+    return UINT32_MAX;
+}
+
+#if SCANF_USE_SWAR
+
+static inline uint64_t load_chunk(const char *const iter) {
+    uint64_t chunk;
+    memcpy(&chunk, iter, sizeof(chunk));
+
+    return chunk;
+}
+
+/*
+ * Set the high bit of each byte of chunk that isn't a decimal digit. XOR-ing
+ * with '0' maps digits to 0-9, and adding 0x80 - 10 to the low seven bits of
+ * each byte sets its high bit if it's 10 or more, without carrying into the
+ * next byte.
+ */
+
+static inline uint64_t non_decimal_mask(const uint64_t chunk) {
+    const uint64_t value = chunk ^ SWAR_BYTES('0');
+    const uint64_t low = value & SWAR_BYTES(0x7f);
+
+    return ((low + SWAR_BYTES(0x80 - 10)) | value) & SWAR_HIGH_BITS;
+}
+
+// Same as non_decimal_mask(), but also lets through 'a'-'f' and 'A'-'F'.
+static inline uint64_t non_hex_mask(const uint64_t chunk) {
+    // Letters map to 1-6.
+    const uint64_t letter = (chunk | SWAR_BYTES(0x20)) ^ SWAR_BYTES(0x60);
+    const uint64_t low = letter & SWAR_BYTES(0x7f);
+    const uint64_t non_letter =
+        (letter
+         | (low + SWAR_BYTES(0x80 - 7))
+         | ~(low + SWAR_BYTES(0x7f)))
+        & SWAR_HIGH_BITS;
+
+    return non_decimal_mask(chunk) & non_letter;
+}
+
+/*
+ * Convert the first count (1-8) digits of chunk, which are in memory order so
+ * the most significant digit is in the lowest byte.
+ *
+ * The digits are moved to the top of the word, so the bytes shifted in act as
+ * leading zeros, and then adjacent digits, pairs and quads are combined.
+ */
+
+static inline uint64_t
+parse_decimal_chunk(uint64_t chunk, const uint32_t count) {
+    // Only bytes past the digits can borrow, and they're shifted out.
+    chunk -= SWAR_BYTES('0');
+    chunk <<= 8 * (8 - count);
+
+    chunk = (chunk * 10 + (chunk >> 8)) & 0x00ff00ff00ff00ffull;
+    chunk = (chunk * 100 + (chunk >> 16)) & 0x0000ffff0000ffffull;
+    chunk = (chunk * 10000 + (chunk >> 32)) & 0x00000000ffffffffull;
+
+    return chunk;
+}
+
+static inline uint64_t
+parse_hex_chunk(uint64_t chunk, const uint32_t count) {
+    // Letters have bit 6 set, and their low nibble is 9 less than their value.
+    const uint64_t letters = (chunk & SWAR_BYTES(0x40)) >> 6;
+
+    chunk = (chunk & SWAR_BYTES(0x0f)) + letters * 9;
+    chunk <<= 8 * (8 - count);
+
+    chunk = ((chunk << 4) | (chunk >> 8)) & 0x00ff00ff00ff00ffull;
+    chunk = ((chunk << 8) | (chunk >> 16)) & 0x0000ffff0000ffffull;
+    chunk = ((chunk << 16) | (chunk >> 32)) & 0x00000000ffffffffull;
+
+    return chunk;
+}
+
+#endif /* SCANF_USE_SWAR */
+
+static inline bool
+append_digits(uint64_t *const value,
+              const uint64_t digits,
+              const uint32_t count,
+              const uint32_t base)
+{
+    // Hexadecimal and octal digits are shifted in, 4 or 3 bits at a time.
+    if (base != 10) {
+        const uint32_t shift = (base == 16 ? 4 : 3) * count;
+        if ((*value >> (64 - shift)) != 0) {
+            return false;
+        }
+
+        *value = (*value << shift) | digits;
+        return true;
+    }
+
+    return !__builtin_mul_overflow(*value, powers_of_ten[count], value)
+        && !__builtin_add_overflow(*value, digits, value);
+}
+
+/*
+ * Read up to limit digits of base from the input into *value_out. Returns the
+ * number of digits read, and sets *overflow_out if the value doesn't fit.
+ */
+
+static uint32_t
+scan_digits(struct scan_input *const input,
+            uint32_t limit,
+            const uint32_t base,
+            uint64_t *const value_out,
+            bool *const overflow_out)
+{
+    const char *const begin = input->iter;
+    uint64_t value = 0;
+
+#if SCANF_USE_SWAR
+    if (base == 10 || base == 16) {
+        while (limit != 0 && input->end - input->iter >= 8) {
+            const uint64_t chunk = load_chunk(input->iter);
+            const uint64_t mask =
+                base == 10 ? non_decimal_mask(chunk) : non_hex_mask(chunk);
+
+            uint32_t count =
+                mask != 0 ? (uint32_t)__builtin_ctzll(mask) / 8 : 8;
+
+            if (count > limit) {
+                count = limit;
+            }
+
+            if (count == 0) {
+                break;
+            }
+
+            const uint64_t digits =
+                base == 10 ? parse_decimal_chunk(chunk, count)
+                           : parse_hex_chunk(chunk, count);
+
+            if (!append_digits(&value, digits, count, base)) {
+                *overflow_out = true;
+            }
+
+            input->iter += count;
+            limit -= count;
+
+            if (count != 8) {
+                *value_out = value;
+                return (uint32_t)(input->iter - begin);
+            }
+        }
+    }
+#endif /* SCANF_USE_SWAR */
+
+    while (limit != 0 && input->iter != input->end) {
+        const uint32_t digit = digit_value(*input->iter);
+        if (digit >= base) {
+            break;
+        }
+
+        if (!append_digits(&value, digit, 1, base)) {
+            *overflow_out = true;
+        }
+
+        input->iter++;
+        limit--;
+    }
+
+    *value_out = value;
+    return (uint32_t)(input->iter - begin);
+}
+
+/*
+ * Read an integer in base, or detect the base like strtol() if base is 0.
+ * width is the most characters to read, including any sign and "0x".
+ */
+
+static enum scan_result
+scan_integer(struct scan_input *const input,
+             const uint32_t width,
+             uint32_t base,
+             uint64_t *const value_out)
+{
+    skip_space(input);
+    if (input->iter == input->end) {
+        return E_SCAN_INPUT_FAILURE;
+    }
+
+    uint32_t limit = width != 0 ? width : UINT32_MAX;
+    bool is_negative = false;
+
+    if (*input->iter == '-' || *input->iter == '+') {
+        is_negative = *input->iter == '-';
+
+        input->iter++;
+        limit--;
+    }
+
+    const char *const iter = input->iter;
+    const ptrdiff_t left = input->end - iter;
+
+    // Like glibc, a "0x" without digits after it is read as 0.
+    const bool has_hex_prefix =
+        (base == 0 || base == 16)
+        && limit >= 2
+        && left >= 2
+        && iter[0] == '0'
+        && (iter[1] | 0x20) == 'x';
+
+    if (has_hex_prefix) {
+        base = 16;
+        input->iter += 2;
+        limit -= 2;
+    } else if (base == 0) {
+        base = left != 0 && iter[0] == '0' ? 8 : 10;
+    }
+
+    uint64_t value = 0;
+    bool overflow = false;
+
+    const uint32_t digit_count =
+        scan_digits(input, limit, base, &value, &overflow);
+
+    if ((digit_count == 0 && !has_hex_prefix) || overflow) {
+        return E_SCAN_MATCHING_FAILURE;
+    }
+
+    *value_out = is_negative ? 0 - value : value;
+    return E_SCAN_OK;
+}
+
+static void
+store_integer(va_list *const list,
+              const enum scanf_length length,
+              const uint64_t value)
+{
+    switch (length) {
+        case SCANF_LENGTH_NONE:
+            *va_arg(*list, int *) = (int)value;
+            break;
+        case SCANF_LENGTH_HH:
+            *va_arg(*list, signed char *) = (signed char)value;
+            break;
+        case SCANF_LENGTH_H:
+            *va_arg(*list, short *) = (short)value;
+            break;
+        case SCANF_LENGTH_L:
+            *va_arg(*list, long *) = (long)value;
+            break;
+        case SCANF_LENGTH_LL:
+            *va_arg(*list, long long *) = (long long)value;
+            break;
+        case SCANF_LENGTH_J:
+            *va_arg(*list, intmax_t *) = (intmax_t)value;
+            break;
+        case SCANF_LENGTH_Z:
+            *va_arg(*list, size_t *) = (size_t)value;
+            break;
+        case SCANF_LENGTH_T:
+            *va_arg(*list, ptrdiff_t *) = (ptrdiff_t)value;
+            break;
+    }
+}
+
+static const char *
+parse_length(const char *const iter, enum scanf_length *const length_out) {
+    switch (*iter) {
+        case 'h':
+            if (iter[1] == 'h') {
+                *length_out = SCANF_LENGTH_HH;
+                return iter + 2;
+            }
+
+            *length_out = SCANF_LENGTH_H;
+            return iter + 1;
+        case 'l':
+            if (iter[1] == 'l') {
+                *length_out = SCANF_LENGTH_LL;
+                return iter + 2;
+            }
+
+            *length_out = SCANF_LENGTH_L;
+            return iter + 1;
+        case 'j':
+            *length_out = SCANF_LENGTH_J;
+            return iter + 1;
+        case 'z':
+            *length_out = SCANF_LENGTH_Z;
+            return iter + 1;
+        case 't':
+            *length_out = SCANF_LENGTH_T;
+            return iter + 1;
+    }
+
+    *length_out = SCANF_LENGTH_NONE;
+    return iter;
+}
+
+/*
+ * Parse a %[...] scanset, with iter right past the '['. Returns NULL if the
+ * set isn't closed.
+ */
+
+static const char *
+parse_scanset(const char *iter, uint8_t set[static const 32]) {
+    bool invert = false;
+    if (*iter == '^') {
+        invert = true;
+        iter++;
+    }
+
+    memset(set, 0, 32);
+
+    // A ']' right at the start is part of the set.
+    if (*iter == ']') {
+        set[']' / 8] |= 1u << (']' % 8);
+        iter++;
+    }
+
+    for (; *iter != ']'; iter++) {
+        if (*iter == '\0') {
+            return NULL;
+        }
+
+        uint8_t first = (uint8_t)*iter;
+        uint8_t last = first;
+
+        // A '-' is a range unless it's at either end of the set.
+        if (iter[1] == '-' && iter[2] != ']' && iter[2] != '\0') {
+            last = (uint8_t)iter[2];
+            iter += 2;
+        }
+
+        for (uint32_t ch = first; ch <= last; ch++) {
+            set[ch / 8] |= 1u << (ch % 8);
+        }
+    }
+
+    if (invert) {
+        for (uint32_t i = 0; i != 32; i++) {
+            set[i] = ~set[i];
+        }
+    }
+
+    return iter + 1;
+}
+
+static inline bool in_scanset(const uint8_t set[static 32], const char ch) {
+    const uint8_t byte = (uint8_t)ch;
+    return (set[byte / 8] >> (byte % 8)) & 1;
+}
+
+static uint32_t read_width(const char *iter, const char **const iter_out) {
+    uint32_t width = 0;
+    while (*iter >= '0' && *iter <= '9') {
+        if (__builtin_mul_overflow(width, 10, &width)
+            || __builtin_add_overflow(width, (uint32_t)(*iter - '0'), &width))
+        {
+            width = UINT32_MAX;
+        }
+
+        iter++;
+    }
+
+    *iter_out = iter;
+    return width;
+}
+
+/******* PUBLIC FUNCTIONS *******/
+
+int
+parse_scanf_format(const char *const input,
+                   const uint32_t input_length,
+                   const char *const fmt,
+                   ...)
+{
+    va_list list;
+    va_start(list, fmt);
+
+    const int result = parse_scanf_vformat(input, input_length, fmt, list);
+
+    va_end(list);
+    return result;
+}
+
+int
+parse_scanf_vformat(const char *const input_begin,
+                    const uint32_t input_length,
+                    const char *const fmt,
+                    va_list list_in)
+{
+    struct scan_input input = {
+        .iter = input_begin,
+        .end = input_begin + input_length
+    };
+
+    va_list list;
+    va_copy(list, list_in);
+
+    int stored = 0;
+
+    enum scan_result result = E_SCAN_OK;
+    for (const char *iter = fmt; *iter != '\0' && result == E_SCAN_OK; ) {
+        if (is_space(*iter)) {
+            skip_space(&input);
+            while (is_space(*iter)) {
+                iter++;
+            }
+
+            continue;
+        }
+
+        if (*iter != '%' || iter[1] == '%') {
+            if (*iter == '%') {
+                skip_space(&input);
+                iter++;
+            }
+
+            if (input.iter == input.end) {
+                result = E_SCAN_INPUT_FAILURE;
+            } else if (*input.iter != *iter) {
+                result = E_SCAN_MATCHING_FAILURE;
+            } else {
+                input.iter++;
+                iter++;
+            }
+
+            continue;
+        }
+
+        // Format is %[*][width][length]specifier
+        iter++;
+
+        const bool suppress = *iter == '*';
+        if (suppress) {
+            iter++;
+        }
+
+        const uint32_t width = read_width(iter, &iter);
+
+        enum scanf_length length = SCANF_LENGTH_NONE;
+        iter = parse_length(iter, &length);
+
+        const char spec = *iter;
+        if (spec == '\0') {
+            break;
+        }
+
+        iter++;
+        switch (spec) {
+            case 'd':
+            case 'i':
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X': {
+                uint32_t base = 10;
+                switch (spec) {
+                    case 'i':
+                        base = 0;
+                        break;
+                    case 'o':
+                        base = 8;
+                        break;
+                    case 'x':
+                    case 'X':
+                        base = 16;
+                        break;
+                }
+
+                uint64_t value = 0;
+                result = scan_integer(&input, width, base, &value);
+
+                if (result == E_SCAN_OK && !suppress) {
+                    store_integer(&list, length, value);
+                    stored++;
+                }
+
+                break;
+            }
+            case 's': {
+                skip_space(&input);
+                if (input.iter == input.end) {
+                    result = E_SCAN_INPUT_FAILURE;
+                    break;
+                }
+
+                const char *const begin = input.iter;
+                const uint32_t limit = width != 0 ? width : UINT32_MAX;
+
+                while (input.iter != input.end
+                       && !is_space(*input.iter)
+                       && (uint32_t)(input.iter - begin) != limit)
+                {
+                    input.iter++;
+                }
+
+                if (!suppress) {
+                    *va_arg(list, struct scanf_capture *) =
+                        (struct scanf_capture){
+                            .begin = begin,
+                            .length = (uint32_t)(input.iter - begin)
+                        };
+
+                    stored++;
+                }
+
+                break;
+            }
+            case 'c': {
+                if (input.iter == input.end) {
+                    result = E_SCAN_INPUT_FAILURE;
+                    break;
+                }
+
+                // Like glibc, take what's left if the input ends early.
+                uint32_t count = width != 0 ? width : 1;
+                if ((uint64_t)(input.end - input.iter) < count) {
+                    count = (uint32_t)(input.end - input.iter);
+                }
+
+                if (!suppress) {
+                    *va_arg(list, struct scanf_capture *) =
+                        (struct scanf_capture){
+                            .begin = input.iter,
+                            .length = count
+                        };
+
+                    stored++;
+                }
+
+                input.iter += count;
+                break;
+            }
+            case '[': {
+                uint8_t set[32];
+
+                iter = parse_scanset(iter, set);
+                if (iter == NULL) {
+                    result = E_SCAN_MATCHING_FAILURE;
+                    break;
+                }
+
+                if (input.iter == input.end) {
+                    result = E_SCAN_INPUT_FAILURE;
+                    break;
+                }
+
+                const char *const begin = input.iter;
+                const uint32_t limit = width != 0 ? width : UINT32_MAX;
+
+                while (input.iter != input.end
+                       && in_scanset(set, *input.iter)
+                       && (uint32_t)(input.iter - begin) != limit)
+                {
+                    input.iter++;
+                }
+
+                if (input.iter == begin) {
+                    result = E_SCAN_MATCHING_FAILURE;
+                    break;
+                }
+
+                if (!suppress) {
+                    *va_arg(list, struct scanf_capture *) =
+                        (struct scanf_capture){
+                            .begin = begin,
+                            .length = (uint32_t)(input.iter - begin)
+                        };
+
+                    stored++;
+                }
+
+                break;
+            }
+            case 'n':
+                // %n doesn't count as a conversion.
+                if (!suppress) {
+                    store_integer(&list,
+                                  length,
+                                  (uint64_t)(input.iter - input_begin));
+                }
+
+                continue;
+            default:
+                result = E_SCAN_MATCHING_FAILURE;
+                break;
+        }
+    }
+
+    va_end(list);
+
+    // Like glibc, skipped fields don't count as conversions here.
+    if (result == E_SCAN_INPUT_FAILURE && stored == 0) {
+        return -1;
+    }
+
+    return stored;
+}
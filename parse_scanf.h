@@ -0,0 +1,64 @@
+/*
+Copyright (c) 2023 Suhas Pai
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdint.h>
+
+/*
+ * The scanf() counterpart to parse_printf_format(), for parsing formatted
+ * output back into fields without allocating.
+ *
+ * Strings aren't copied. %s, %c and %[...] store a struct scanf_capture that
+ * points into the input, and isn't null-terminated.
+ */
+
+struct scanf_capture {
+    const char *begin;
+    uint32_t length;
+};
+
+/*
+ * Parse input_length bytes of input, which needn't be null-terminated, against
+ * fmt, as sscanf() would.
+ *
+ * Supports %d %i %u %o %x %X (with the hh, h, l, ll, j, z and t length
+ * modifiers), %s, %c, %[...], %n and %%, along with field widths and '*' to
+ * skip a field. Integers are stored truncated to the argument's type, and a
+ * number that overflows 64 bits fails its conversion.
+ *
+ * Returns the number of fields stored, or -1 if the input ran out before the
+ * first conversion.
+ */
+
+int
+parse_scanf_format(const char *input,
+                   uint32_t input_length,
+                   const char *fmt,
+                   ...);
+
+int
+parse_scanf_vformat(const char *input,
+                    uint32_t input_length,
+                    const char *fmt,
+                    va_list list);
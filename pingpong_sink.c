@@ -0,0 +1,153 @@
+#include <string.h>
+
+#include "pingpong_sink.h"
+
+void
+pingpong_sink_init(struct pingpong_sink *const sink,
+                   char *const buffer,
+                   const uint32_t half_size,
+                   const pingpong_sink_start_transmit_t start_transmit,
+                   const pingpong_sink_idle_t idle,
+                   void *const transmit_info)
+{
+    sink->halves[0] = buffer;
+    sink->halves[1] = buffer + half_size;
+    sink->half_size = half_size;
+
+    sink->active = 0;
+    sink->used = 0;
+    sink->transmitting = false;
+
+    sink->start_transmit = start_transmit;
+    sink->idle = idle;
+    sink->transmit_info = transmit_info;
+
+    sink->wait_count = 0;
+}
+
+void pingpong_sink_transmit_done(struct pingpong_sink *const sink) {
+    __atomic_store_n(&sink->transmitting, false, __ATOMIC_RELEASE);
+}
+
+void pingpong_sink_wait_idle(struct pingpong_sink *const sink) {
+    if (!__atomic_load_n(&sink->transmitting, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    sink->wait_count++;
+    do {
+        if (sink->idle != NULL) {
+            sink->idle(sink->transmit_info);
+        }
+    } while (__atomic_load_n(&sink->transmitting, __ATOMIC_ACQUIRE));
+}
+
+void pingpong_sink_flush(struct pingpong_sink *const sink) {
+    if (sink->used == 0) {
+        return;
+    }
+
+    // The other half may still be transmitting, and there's only one
+    // transmitter.
+    pingpong_sink_wait_idle(sink);
+
+    const uint32_t index = sink->active;
+    const uint32_t length = sink->used;
+
+    __atomic_store_n(&sink->transmitting, true, __ATOMIC_RELAXED);
+
+    sink->active = index ^ 1;
+    sink->used = 0;
+
+    sink->start_transmit(sink->transmit_info, sink->halves[index], length);
+}
+
+uint32_t
+pingpong_sink_write_ch_callback(struct printf_spec_info *const spec_info,
+                                void *const info,
+                                const char ch,
+                                const uint32_t times,
+                                bool *const should_continue_out)
+{
+    (void)spec_info;
+    (void)should_continue_out;
+
+    struct pingpong_sink *const sink = (struct pingpong_sink *)info;
+    uint32_t left = times;
+
+    while (left != 0) {
+        if (sink->used == sink->half_size) {
+            pingpong_sink_flush(sink);
+        }
+
+        const uint32_t room = sink->half_size - sink->used;
+        const uint32_t amount = left < room ? left : room;
+
+        memset(sink->halves[sink->active] + sink->used, ch, amount);
+
+        sink->used += amount;
+        left -= amount;
+    }
+
+    return times;
+}
+
+uint32_t
+pingpong_sink_write_string_callback(struct printf_spec_info *const spec_info,
+                                    void *const info,
+                                    const char *const string,
+                                    const uint32_t length,
+                                    bool *const should_continue_out)
+{
+    (void)spec_info;
+    (void)should_continue_out;
+
+    struct pingpong_sink *const sink = (struct pingpong_sink *)info;
+    uint32_t done = 0;
+
+    while (done != length) {
+        if (sink->used == sink->half_size) {
+            pingpong_sink_flush(sink);
+        }
+
+        const uint32_t room = sink->half_size - sink->used;
+        const uint32_t left = length - done;
+        const uint32_t amount = left < room ? left : room;
+
+        memcpy(sink->halves[sink->active] + sink->used, string + done, amount);
+
+        sink->used += amount;
+        done += amount;
+    }
+
+    return length;
+}
+
+uint32_t
+pingpong_sink_format(struct pingpong_sink *const sink,
+                     const char *const format,
+                     ...)
+{
+    va_list list;
+    va_start(list, format);
+
+    const uint32_t result = pingpong_sink_vformat(sink, format, list);
+
+    va_end(list);
+    return result;
+}
+
+uint32_t
+pingpong_sink_vformat(struct pingpong_sink *const sink,
+                      const char *const format,
+                      va_list list)
+{
+    const uint32_t length =
+        parse_printf_format(pingpong_sink_write_ch_callback,
+                            sink,
+                            pingpong_sink_write_string_callback,
+                            sink,
+                            format,
+                            list);
+    return length;
+}
@@ -0,0 +1,119 @@
+/*
+Copyright (c) 2023 Suhas Pai
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "parse_printf.h"
+
+/*
+ * A double-buffered (ping-pong) sink for DMA or UART style transmitters.
+ *
+ * Output is formatted into one half of the buffer while the other half is
+ * being transmitted. When the half being filled is full, the sink waits for
+ * the transmission in progress (if any) to finish, hands the full half to
+ * start_transmit, and keeps formatting into the other half.
+ *
+ * start_transmit should only start the transfer. Once the transfer is done,
+ * the driver (usually the DMA completion interrupt) must call
+ * pingpong_sink_transmit_done().
+ */
+
+typedef void
+(*pingpong_sink_start_transmit_t)(void *info,
+                                  const char *data,
+                                  uint32_t length);
+
+/*
+ * Called repeatedly while waiting for a transmission to finish, for example to
+ * sleep until the next interrupt. May be NULL.
+ */
+
+typedef void (*pingpong_sink_idle_t)(void *info);
+
+struct pingpong_sink {
+    char *halves[2];
+    uint32_t half_size;
+
+    // The half being formatted into, and how much of it is used.
+    uint32_t active;
+    uint32_t used;
+
+    // Set while a half is being transmitted. Cleared by
+    // pingpong_sink_transmit_done().
+    bool transmitting;
+
+    pingpong_sink_start_transmit_t start_transmit;
+    pingpong_sink_idle_t idle;
+    void *transmit_info;
+
+    // Number of times the sink had to wait for a transmission to finish.
+    uint64_t wait_count;
+};
+
+/*
+ * buffer must point to 2 * half_size bytes.
+ */
+
+void
+pingpong_sink_init(struct pingpong_sink *sink,
+                   char *buffer,
+                   uint32_t half_size,
+                   pingpong_sink_start_transmit_t start_transmit,
+                   pingpong_sink_idle_t idle,
+                   void *transmit_info);
+
+// Safe to call from an interrupt handler, or from another thread.
+void pingpong_sink_transmit_done(struct pingpong_sink *sink);
+
+// Start transmitting the half being filled, even if it isn't full.
+void pingpong_sink_flush(struct pingpong_sink *sink);
+
+// Wait until there's no transmission in progress.
+void pingpong_sink_wait_idle(struct pingpong_sink *sink);
+
+uint32_t
+pingpong_sink_write_ch_callback(struct printf_spec_info *spec_info,
+                                void *info,
+                                char ch,
+                                uint32_t times,
+                                bool *should_continue_out);
+
+uint32_t
+pingpong_sink_write_string_callback(struct printf_spec_info *spec_info,
+                                    void *info,
+                                    const char *string,
+                                    uint32_t length,
+                                    bool *should_continue_out);
+
+__attribute__((format(printf, 2, 3)))
+uint32_t
+pingpong_sink_format(struct pingpong_sink *sink, const char *format, ...);
+
+uint32_t
+pingpong_sink_vformat(struct pingpong_sink *sink,
+                      const char *format,
+                      va_list list);
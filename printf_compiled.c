@@ -0,0 +1,53 @@
+#include <string.h>
+
+#include "printf_compiled.h"
+
+/*
+ * Without a generated database linked in, these weak references are NULL.
+ * Weak definitions wouldn't do, as a const one can be folded into the lookup.
+ */
+
+extern const struct printf_compiled_entry printf_compiled_database[]
+    __attribute__((weak));
+
+extern const uint32_t printf_compiled_database_length
+    __attribute__((weak));
+
+/******* PUBLIC FUNCTIONS *******/
+
+const struct printf_compiled_format *
+printf_compiled_lookup(const uint32_t token,
+                       const char *const format,
+                       const uint32_t length)
+{
+    if (&printf_compiled_database_length == NULL) {
+        return NULL;
+    }
+
+    uint32_t low = 0;
+    uint32_t high = printf_compiled_database_length;
+
+    while (low != high) {
+        const uint32_t middle = low + (high - low) / 2;
+        const struct printf_compiled_entry *const entry =
+            &printf_compiled_database[middle];
+
+        if (entry->token < token) {
+            low = middle + 1;
+        } else if (entry->token > token) {
+            high = middle;
+        } else {
+            // A format that wasn't compiled could still share a token.
+            if (entry->format_length != length
+                || (entry->format != format
+                    && memcmp(entry->format, format, length) != 0))
+            {
+                return NULL;
+            }
+
+            return &entry->compiled;
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,110 @@
+/*
+Copyright (c) 2023 Suhas Pai
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <stdint.h>
+
+#include "example.h"
+#include "parse_printf.h"
+#include "printf_token.h"
+
+/*
+ * Formats compiled at build time, for targets that can't spare the time to
+ * parse formats, or the RAM to cache them.
+ *
+ * The printf_precompile tool scans sources for calls to format_to_buffer(),
+ * parse_printf_format() and PRINTF_COMPILED() with literal formats, and
+ * generates a C file with a const, pre-parsed struct printf_compiled_format
+ * for each of them:
+ *
+ *   ./printf_precompile file.c [file.c ...] > formats.c
+ *
+ * Including this header routes calls to format_to_buffer() and
+ * parse_printf_format() to those tables. A table is found by the hash that
+ * PRINTF_TOKEN() computes at compile time, and a binary search over the
+ * generated database. Formats that aren't literals, or weren't compiled, are
+ * parsed at runtime as usual. Define PRINTF_COMPILED_NO_ROUTING before
+ * including this header to only use PRINTF_COMPILED() explicitly.
+ */
+
+struct printf_compiled_entry {
+    uint32_t token;
+    const char *format;
+    uint32_t format_length;
+
+    struct printf_compiled_format compiled;
+};
+
+/*
+ * Generated by printf_precompile, and sorted by token. Without a generated
+ * file, the database is empty, and every format is parsed at runtime.
+ */
+
+extern const struct printf_compiled_entry printf_compiled_database[];
+extern const uint32_t printf_compiled_database_length;
+
+/*
+ * Returns the table for format, which is length bytes long, or NULL if it
+ * wasn't compiled.
+ */
+
+const struct printf_compiled_format *
+printf_compiled_lookup(uint32_t token, const char *format, uint32_t length);
+
+// Only arrays, like string literals, can be hashed at compile time.
+#define PRINTF_COMPILED_IS_LITERAL(format) \
+    (!__builtin_types_compatible_p(__typeof__(format), \
+                                   __typeof__(&*(format))))
+
+// The table for format, or NULL if it isn't a compiled literal.
+#define PRINTF_COMPILED(format) \
+    __builtin_choose_expr( \
+        PRINTF_COMPILED_IS_LITERAL(format), \
+        printf_compiled_lookup(PRINTF_TOKEN(format), \
+                               format, \
+                               sizeof(format) - 1), \
+        (const struct printf_compiled_format *)NULL)
+
+#ifndef PRINTF_COMPILED_NO_ROUTING
+    #define format_to_buffer(buffer_in, buffer_len, format, ...) \
+        format_to_buffer_compiled(buffer_in, \
+                                  buffer_len, \
+                                  PRINTF_COMPILED(format), \
+                                  format, \
+                                  ##__VA_ARGS__)
+
+    #define parse_printf_format(write_char_cb, \
+                                char_cb_info, \
+                                write_string_cb, \
+                                sv_cb_info, \
+                                format, \
+                                list) \
+        parse_printf_compiled(write_char_cb, \
+                              char_cb_info, \
+                              write_string_cb, \
+                              sv_cb_info, \
+                              PRINTF_COMPILED(format), \
+                              format, \
+                              list)
+#endif /* PRINTF_COMPILED_NO_ROUTING */
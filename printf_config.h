@@ -0,0 +1,102 @@
+/*
+Copyright (c) 2023 Suhas Pai
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+/*
+ * Compile-time selection of the conversions the engine supports. Disabled
+ * paths are removed from the build, which shrinks the code and its hot loop
+ * on small targets.
+ *
+ * Every feature is enabled by default. Defining PRINTF_CONFIG_MINIMAL turns
+ * them all off, leaving %d %i %u %o %x %X %c %s %p and %% with the h, hh, l, z
+ * and t length modifiers. Either way, a feature can be set on its own with
+ * -DPRINTF_ENABLE_<feature>=0 or 1, and the same settings must be used for
+ * every file that includes parse_printf.h.
+ *
+ * A disabled conversion or length modifier stops formatting where it appears,
+ * since its argument can't be skipped.
+ */
+
+#ifdef PRINTF_CONFIG_MINIMAL
+    #define PRINTF_CONFIG_DEFAULT 0
+#else
+    #define PRINTF_CONFIG_DEFAULT 1
+#endif /* PRINTF_CONFIG_MINIMAL */
+
+// %b and %B.
+#ifndef PRINTF_ENABLE_BINARY
+    #define PRINTF_ENABLE_BINARY PRINTF_CONFIG_DEFAULT
+#endif /* PRINTF_ENABLE_BINARY */
+
+// %n.
+#ifndef PRINTF_ENABLE_N
+    #define PRINTF_ENABLE_N PRINTF_CONFIG_DEFAULT
+#endif /* PRINTF_ENABLE_N */
+
+// The ll and j length modifiers.
+#ifndef PRINTF_ENABLE_LONGLONG
+    #define PRINTF_ENABLE_LONGLONG PRINTF_CONFIG_DEFAULT
+#endif /* PRINTF_ENABLE_LONGLONG */
+
+// %k and %K.
+#ifndef PRINTF_ENABLE_FIXED_POINT
+    #define PRINTF_ENABLE_FIXED_POINT PRINTF_CONFIG_DEFAULT
+#endif /* PRINTF_ENABLE_FIXED_POINT */
+
+// %T.
+#ifndef PRINTF_ENABLE_TIMESTAMP
+    #define PRINTF_ENABLE_TIMESTAMP PRINTF_CONFIG_DEFAULT
+#endif /* PRINTF_ENABLE_TIMESTAMP */
+
+// %r, %R, %v and %V.
+#ifndef PRINTF_ENABLE_RAW_FIELDS
+    #define PRINTF_ENABLE_RAW_FIELDS PRINTF_CONFIG_DEFAULT
+#endif /* PRINTF_ENABLE_RAW_FIELDS */
+
+// The ' flag. printf_set_digit_grouping() does nothing without it.
+#ifndef PRINTF_ENABLE_DIGIT_GROUPING
+    #define PRINTF_ENABLE_DIGIT_GROUPING PRINTF_CONFIG_DEFAULT
+#endif /* PRINTF_ENABLE_DIGIT_GROUPING */
+
+/*
+ * Positional arguments (%1$d) in formats. Argument tables are still available
+ * to callers of parse_printf_format_with_args(), which tokenized logging uses.
+ */
+
+#ifndef PRINTF_ENABLE_POSITIONAL
+    #define PRINTF_ENABLE_POSITIONAL PRINTF_CONFIG_DEFAULT
+#endif /* PRINTF_ENABLE_POSITIONAL */
+
+/*
+ * Use the word-at-a-time primitives in printf_string.c instead of libc's
+ * string functions. Chosen automatically for -ffreestanding builds.
+ */
+
+#ifndef PRINTF_FREESTANDING
+    #if defined(__STDC_HOSTED__) && __STDC_HOSTED__ == 0
+        #define PRINTF_FREESTANDING 1
+    #else
+        #define PRINTF_FREESTANDING 0
+    #endif
+#endif /* PRINTF_FREESTANDING */
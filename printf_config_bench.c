@@ -0,0 +1,67 @@
+/*
+ * Times the conversions every configuration keeps, for `make config_report`,
+ * which builds this once per printf_config.h preset.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "example.h"
+
+#define CONFIG_BENCH_ITERATIONS 2000000
+#define CONFIG_BENCH_ROUNDS 5
+
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Keep the compiler from optimizing away the formatted output.
+static volatile char bench_sink;
+
+int main(const int argc, const char *const argv[]) {
+    const char *const name = argc > 1 ? argv[1] : "";
+    char buffer[128];
+
+    format_to_buffer(buffer,
+                     sizeof(buffer),
+                     "%d %u %x %s",
+                     -42,
+                     42u,
+                     42u,
+                     "ok");
+    if (strcmp(buffer, "-42 42 2a ok") != 0) {
+        printf("%s: wrong output \"%s\"\n", name, buffer);
+        return 1;
+    }
+
+    // Report the fastest round, to keep other load out of the comparison.
+    uint64_t best = UINT64_MAX;
+    for (uint32_t round = 0; round != CONFIG_BENCH_ROUNDS; round++) {
+        const uint64_t start = get_time_ns();
+        for (uint32_t i = 0; i != CONFIG_BENCH_ITERATIONS; i++) {
+            format_to_buffer(buffer,
+                             sizeof(buffer),
+                             "id=%d len=%u crc=%x state=%s",
+                             (int)i - 1000,
+                             i,
+                             i * 2654435761u,
+                             "idle");
+            bench_sink = buffer[0];
+        }
+
+        const uint64_t elapsed = get_time_ns() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    printf("%-10s %8.2f ns/op\n",
+           name,
+           (double)best / CONFIG_BENCH_ITERATIONS);
+    return 0;
+}
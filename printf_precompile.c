@@ -0,0 +1,288 @@
+/*
+ * Extracts the literal formats passed to format_to_buffer(),
+ * parse_printf_format() and PRINTF_COMPILED() from C sources, parses them
+ * with printf_compile_format(), and writes the pre-parsed tables to stdout as
+ * a C source file, for linking into the firmware. See printf_compiled.h.
+ *
+ * Usage: printf_precompile file.c [file.c ...] > formats.c
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parse_printf.h"
+#include "printf_source.h"
+#include "printf_token.h"
+
+static const struct printf_source_call precompile_calls[] = {
+    { "format_to_buffer", 2 },
+    { "parse_printf_format", 4 },
+    { "PRINTF_COMPILED", 0 },
+};
+
+struct format_entry {
+    uint32_t token;
+    char *format;
+    uint32_t length;
+
+    struct printf_compiled_format compiled;
+    struct printf_compiled_spec *specs;
+};
+
+static struct format_entry *entries;
+static uint32_t entries_used;
+static uint32_t entries_capacity;
+
+/*
+ * A format can have at most one conversion per '%'. Returns false if the
+ * format can't be compiled, and should be left to the runtime parser.
+ */
+
+static bool compile_entry(struct format_entry *const entry) {
+    uint32_t capacity = 0;
+    for (uint32_t i = 0; i != entry->length; i++) {
+        if (entry->format[i] == '%') {
+            capacity++;
+        }
+    }
+
+    const size_t size = (capacity != 0 ? capacity : 1) * sizeof(*entry->specs);
+
+    entry->specs = malloc(size);
+    if (entry->specs == NULL) {
+        return false;
+    }
+
+    return printf_compile_format(&entry->compiled,
+                                 entry->specs,
+                                 capacity,
+                                 entry->format);
+}
+
+static bool
+add_format(void *const info, char *const format, const uint32_t length) {
+    (void)info;
+
+    // PRINTF_COMPILED() hashes the literal, including any embedded NULs.
+    const uint32_t token = printf_token_hash(format, length);
+    format[length] = '\0';
+
+    for (uint32_t i = 0; i != entries_used; i++) {
+        if (entries[i].token != token) {
+            continue;
+        }
+
+        if (entries[i].length != length
+            || memcmp(entries[i].format, format, length) != 0)
+        {
+            // printf_compiled_lookup() checks the format, so this one is just
+            // parsed at runtime.
+            fprintf(stderr,
+                    "printf_precompile: token %08x is shared by two formats\n",
+                    token);
+        }
+
+        free(format);
+        return true;
+    }
+
+    if (entries_used == entries_capacity) {
+        entries_capacity = entries_capacity != 0 ? entries_capacity * 2 : 64;
+        entries = realloc(entries, entries_capacity * sizeof(*entries));
+
+        if (entries == NULL) {
+            return false;
+        }
+    }
+
+    struct format_entry *const entry = &entries[entries_used];
+    *entry = (struct format_entry){
+        .token = token,
+        .format = format,
+        .length = length
+    };
+
+    if (!compile_entry(entry)) {
+        free(entry->specs);
+        free(format);
+
+        return true;
+    }
+
+    entries_used++;
+    return true;
+}
+
+static int compare_entries(const void *const lhs, const void *const rhs) {
+    const uint32_t lhs_token = ((const struct format_entry *)lhs)->token;
+    const uint32_t rhs_token = ((const struct format_entry *)rhs)->token;
+
+    return (lhs_token > rhs_token) - (lhs_token < rhs_token);
+}
+
+// The length modifier and specifier that conversion starts with.
+static uint32_t conversion_length(const char *const conversion) {
+    uint32_t length = 0;
+    while (conversion[length] == 'h' || conversion[length] == 'l'
+           || conversion[length] == 'j' || conversion[length] == 'z'
+           || conversion[length] == 't')
+    {
+        length++;
+    }
+
+    return length + 1;
+}
+
+static void write_spec_info(const struct printf_spec_info *const info) {
+    printf("{ ");
+    if (info->add_one_space_for_sign) {
+        printf(".add_one_space_for_sign = true, ");
+    }
+
+    if (info->left_justify) {
+        printf(".left_justify = true, ");
+    }
+
+    if (info->add_pos_sign) {
+        printf(".add_pos_sign = true, ");
+    }
+
+    if (info->add_base_prefix) {
+        printf(".add_base_prefix = true, ");
+    }
+
+    if (info->leftpad_zeros) {
+        printf(".leftpad_zeros = true, ");
+    }
+
+    if (info->group_digits) {
+        printf(".group_digits = true, ");
+    }
+
+    printf(".width = %u, .precision = %d }", info->width, info->precision);
+}
+
+static void write_specs(const uint32_t index) {
+    const struct printf_compiled_format *const compiled =
+        &entries[index].compiled;
+
+    if (compiled->spec_count == 0) {
+        return;
+    }
+
+    printf("static const struct printf_compiled_spec specs_%u[] = {\n", index);
+    for (uint32_t i = 0; i != compiled->spec_count; i++) {
+        const struct printf_compiled_spec *const spec = &compiled->specs[i];
+
+        printf("    {\n        .literal = ");
+        printf_source_write_c_string(spec->literal, spec->literal_length);
+        printf(",\n        .literal_length = %u,\n", spec->literal_length);
+
+        if (spec->width_from_arg) {
+            printf("        .width_from_arg = true,\n");
+        }
+
+        if (spec->precision_from_arg) {
+            printf("        .precision_from_arg = true,\n");
+        }
+
+        printf("        .info = ");
+        write_spec_info(&spec->info);
+        printf(",\n        .conversion = ");
+        printf_source_write_c_string(spec->conversion,
+                                     conversion_length(spec->conversion));
+        printf("\n    },\n");
+    }
+
+    printf("};\n\n");
+}
+
+static void write_entry(const uint32_t index) {
+    const struct format_entry *const entry = &entries[index];
+    const struct printf_compiled_format *const compiled = &entry->compiled;
+
+    printf("    {\n        .token = 0x%08xu,\n", entry->token);
+    printf("        .format = ");
+    printf_source_write_c_string(entry->format, entry->length);
+    printf(",\n        .format_length = %u,\n", entry->length);
+    printf("        .compiled = {\n");
+
+    if (compiled->spec_count != 0) {
+        printf("            .specs = specs_%u,\n", index);
+    } else {
+        printf("            .specs = NULL,\n");
+    }
+
+    printf("            .spec_count = %u,\n", compiled->spec_count);
+    printf("            .trailing = ");
+    printf_source_write_c_string(compiled->trailing, compiled->trailing_length);
+    printf(",\n            .trailing_length = %u\n", compiled->trailing_length);
+    printf("        }\n    },\n");
+}
+
+int main(const int argc, const char *const argv[]) {
+    if (argc < 2) {
+        fprintf(stderr,
+                "Usage: %s file.c [file.c ...] > formats.c\n",
+                argv[0]);
+        return 1;
+    }
+
+    for (int i = 1; i != argc; i++) {
+        size_t length = 0;
+        char *const source = printf_source_read_file(argv[i], &length);
+
+        if (source == NULL) {
+            fprintf(stderr, "printf_precompile: failed to read %s\n", argv[i]);
+            return 1;
+        }
+
+        const bool scanned =
+            printf_source_scan(source,
+                               precompile_calls,
+                               sizeof(precompile_calls)
+                                   / sizeof(*precompile_calls),
+                               add_format,
+                               /*info=*/NULL);
+
+        if (!scanned) {
+            fprintf(stderr, "printf_precompile: failed on %s\n", argv[i]);
+            return 1;
+        }
+
+        free(source);
+    }
+
+    // The literals and conversions point into each entry's format, which
+    // doesn't move.
+    qsort(entries, entries_used, sizeof(*entries), compare_entries);
+
+    printf("// Generated by printf_precompile. Do not edit.\n\n");
+    printf("#include <stddef.h>\n\n");
+    printf("#include \"printf_compiled.h\"\n\n");
+
+    for (uint32_t i = 0; i != entries_used; i++) {
+        write_specs(i);
+    }
+
+    printf("const struct printf_compiled_entry "
+           "printf_compiled_database[] = {\n");
+
+    for (uint32_t i = 0; i != entries_used; i++) {
+        write_entry(i);
+    }
+
+    // C doesn't allow empty arrays.
+    if (entries_used == 0) {
+        printf("    { .token = 0 },\n");
+    }
+
+    printf("};\n\n");
+    printf("const uint32_t printf_compiled_database_length = %u;\n",
+           entries_used);
+
+    return 0;
+}
@@ -0,0 +1,559 @@
+/*
+ * A drop-in replacement for the snprintf() family, built as a shared library
+ * to be loaded with LD_PRELOAD, or linked ahead of libc.
+ *
+ * Formats are checked before formatting, and anything the engine can't
+ * reproduce byte-for-byte (floating-point, wide characters, positional
+ * arguments, locale-dependent flags, glibc extensions) is passed on to the
+ * next definition of the symbol, which is usually libc's.
+ *
+ * The _FORTIFY_SOURCE entry points (__snprintf_chk() and friends) are
+ * replaced as well, since that is what optimized distribution binaries call.
+ */
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "example.h"
+#include "fd_sink.h"
+#include "parse_printf.h"
+
+#define SHIM_EXPORT __attribute__((visibility("default")))
+
+// Large enough for a typical line, and small enough for the stack.
+#define SHIM_FD_BUFFER_SIZE 1024
+
+extern void __chk_fail(void) __attribute__((noreturn));
+
+struct shim_buffer {
+    char *buffer;
+
+    // Bytes that can be written, not including the null-terminator.
+    size_t capacity;
+
+    // Bytes the output would take, which may be more than capacity.
+    size_t length;
+};
+
+/******* PRIVATE FUNCTIONS *******/
+
+/*
+ * Returns true if every spec in fmt is one the engine formats exactly as glibc
+ * does. %n is only accepted when allow_n is set, since fortified callers
+ * restrict it.
+ */
+
+static bool shim_format_is_supported(const char *iter, const bool allow_n) {
+    // This runs before every call, so it's a plain loop instead of strchr().
+    while (true) {
+        while (*iter != '%') {
+            if (*iter == '\0') {
+                return true;
+            }
+
+            iter++;
+        }
+
+        iter++;
+        if (*iter == '%') {
+            iter++;
+            continue;
+        }
+
+        // glibc applies '+', ' ', '0' and precision to %p as it does to %x,
+        // which the engine doesn't.
+        bool has_numeric_flag = false;
+        while (*iter == '-' || *iter == '+' || *iter == ' ' || *iter == '#'
+               || *iter == '0')
+        {
+            has_numeric_flag |= *iter == '+' || *iter == ' ' || *iter == '0';
+            iter++;
+        }
+
+        if (*iter == '*') {
+            iter++;
+        } else {
+            while (*iter >= '0' && *iter <= '9') {
+                iter++;
+            }
+        }
+
+        // Positional arguments.
+        if (*iter == '$') {
+            return false;
+        }
+
+        const bool has_precision = *iter == '.';
+        if (has_precision) {
+            iter++;
+            if (*iter == '*') {
+                iter++;
+            } else {
+                while (*iter >= '0' && *iter <= '9') {
+                    iter++;
+                }
+            }
+        }
+
+        bool has_length = true;
+        switch (*iter) {
+            case 'h':
+            case 'l':
+                if (iter[1] == iter[0]) {
+                    iter++;
+                }
+
+                iter++;
+                break;
+            case 'j':
+            case 'z':
+            case 't':
+                iter++;
+                break;
+            default:
+                has_length = false;
+                break;
+        }
+
+        switch (*iter) {
+            case 'd':
+            case 'i':
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+                break;
+            case 'c':
+            case 's':
+                // %lc and %ls take wide characters.
+                if (has_length) {
+                    return false;
+                }
+
+                break;
+            case 'p':
+                if (has_length || has_numeric_flag || has_precision) {
+                    return false;
+                }
+
+                break;
+            case 'n':
+                if (!allow_n) {
+                    return false;
+                }
+
+                break;
+            default:
+                return false;
+        }
+
+        iter++;
+    }
+}
+
+static void *real_symbol(void **const slot, const char *const name) {
+    void *symbol = __atomic_load_n(slot, __ATOMIC_RELAXED);
+    if (symbol == NULL) {
+        symbol = dlsym(RTLD_NEXT, name);
+        __atomic_store_n(slot, symbol, __ATOMIC_RELAXED);
+    }
+
+    return symbol;
+}
+
+/*
+ * Looks up the next definition of name, and caches it in a static. Evaluates
+ * to NULL if there's no other definition.
+ */
+
+#define REAL_SYMBOL(type, name) \
+    ({ \
+        static void *real_##name; \
+        (type)real_symbol(&real_##name, #name); \
+    })
+
+static size_t
+shim_buffer_write_ch_callback(struct printf_spec_info *const spec_info,
+                              void *const info,
+                              const char ch,
+                              const size_t times,
+                              bool *const should_continue_out)
+{
+    (void)spec_info;
+
+    struct shim_buffer *const buffer = (struct shim_buffer *)info;
+    if (buffer->length < buffer->capacity) {
+        size_t amount = buffer->capacity - buffer->length;
+        if (amount > times) {
+            amount = times;
+        }
+
+        memset(buffer->buffer + buffer->length, ch, amount);
+    }
+
+    // Keep counting past the end, as snprintf() returns the full length.
+    buffer->length += times;
+    if (buffer->length > INT_MAX) {
+        *should_continue_out = false;
+    }
+
+    return times;
+}
+
+static size_t
+shim_buffer_write_string_callback(struct printf_spec_info *const spec_info,
+                                  void *const info,
+                                  const char *const string,
+                                  const size_t length,
+                                  bool *const should_continue_out)
+{
+    (void)spec_info;
+
+    struct shim_buffer *const buffer = (struct shim_buffer *)info;
+    if (buffer->length < buffer->capacity) {
+        size_t amount = buffer->capacity - buffer->length;
+        if (amount > length) {
+            amount = length;
+        }
+
+        memcpy(buffer->buffer + buffer->length, string, amount);
+    }
+
+    buffer->length += length;
+    if (buffer->length > INT_MAX) {
+        *should_continue_out = false;
+    }
+
+    return length;
+}
+
+/*
+ * Formats into buffer, which holds size bytes including the null-terminator.
+ * Returns the length of the full output, which may be more than fits, or -1
+ * if that length doesn't fit in an int.
+ */
+
+static int
+shim_format_to_buffer(char *const buffer,
+                      const size_t size,
+                      const char *const format,
+                      va_list list)
+{
+    struct shim_buffer info = {
+        .buffer = buffer,
+        .capacity = size != 0 ? size - 1 : 0,
+        .length = 0
+    };
+
+    parse_printf_format64(shim_buffer_write_ch_callback,
+                          &info,
+                          shim_buffer_write_string_callback,
+                          &info,
+                          format,
+                          list);
+
+    if (size != 0) {
+        const size_t end =
+            info.length < info.capacity ? info.length : info.capacity;
+
+        buffer[end] = '\0';
+    }
+
+    if (info.length > INT_MAX) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    return (int)info.length;
+}
+
+static int
+shim_format_to_fd(const int fd, const char *const format, va_list list) {
+    char buffer[SHIM_FD_BUFFER_SIZE];
+
+    struct fd_sink sink;
+    fd_sink_init(&sink, fd, buffer, sizeof(buffer), FD_SINK_FLUSH_ON_FULL);
+
+    const uint64_t length = fd_sink_vformat64(&sink, format, list);
+    if (!fd_sink_flush(&sink) || length > INT_MAX) {
+        return -1;
+    }
+
+    return (int)length;
+}
+
+static int
+shim_format_to_allocation(char **const string_out,
+                          const char *const format,
+                          va_list list)
+{
+    va_list copy;
+    va_copy(copy, list);
+
+    const uint64_t length = get_length_of_printf_vformat64(format, copy);
+    va_end(copy);
+
+    if (length > INT_MAX) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    char *const string = malloc((size_t)length + 1);
+    if (string == NULL) {
+        return -1;
+    }
+
+    *string_out = string;
+    return shim_format_to_buffer(string, (size_t)length + 1, format, list);
+}
+
+/******* PUBLIC FUNCTIONS *******/
+
+typedef int (*vsnprintf_t)(char *, size_t, const char *, va_list);
+typedef int (*vsprintf_t)(char *, const char *, va_list);
+typedef int (*vdprintf_t)(int, const char *, va_list);
+typedef int (*vasprintf_t)(char **, const char *, va_list);
+
+typedef int (*vsnprintf_chk_t)(char *, size_t, int, size_t, const char *,
+                               va_list);
+typedef int (*vsprintf_chk_t)(char *, int, size_t, const char *, va_list);
+typedef int (*vdprintf_chk_t)(int, int, const char *, va_list);
+typedef int (*vasprintf_chk_t)(char **, int, const char *, va_list);
+
+SHIM_EXPORT int
+vsnprintf(char *const buffer,
+          const size_t size,
+          const char *const format,
+          va_list list)
+{
+    if (!shim_format_is_supported(format, /*allow_n=*/true)) {
+        return REAL_SYMBOL(vsnprintf_t, vsnprintf)(buffer, size, format, list);
+    }
+
+    return shim_format_to_buffer(buffer, size, format, list);
+}
+
+SHIM_EXPORT int
+snprintf(char *const buffer, const size_t size, const char *const format, ...)
+{
+    va_list list;
+    va_start(list, format);
+
+    const int result = vsnprintf(buffer, size, format, list);
+
+    va_end(list);
+    return result;
+}
+
+SHIM_EXPORT int
+vsprintf(char *const buffer, const char *const format, va_list list) {
+    if (!shim_format_is_supported(format, /*allow_n=*/true)) {
+        return REAL_SYMBOL(vsprintf_t, vsprintf)(buffer, format, list);
+    }
+
+    return shim_format_to_buffer(buffer, SIZE_MAX, format, list);
+}
+
+SHIM_EXPORT int sprintf(char *const buffer, const char *const format, ...) {
+    va_list list;
+    va_start(list, format);
+
+    const int result = vsprintf(buffer, format, list);
+
+    va_end(list);
+    return result;
+}
+
+SHIM_EXPORT int vdprintf(const int fd, const char *const format, va_list list) {
+    if (!shim_format_is_supported(format, /*allow_n=*/true)) {
+        return REAL_SYMBOL(vdprintf_t, vdprintf)(fd, format, list);
+    }
+
+    return shim_format_to_fd(fd, format, list);
+}
+
+SHIM_EXPORT int dprintf(const int fd, const char *const format, ...) {
+    va_list list;
+    va_start(list, format);
+
+    const int result = vdprintf(fd, format, list);
+
+    va_end(list);
+    return result;
+}
+
+SHIM_EXPORT int
+vasprintf(char **const string_out, const char *const format, va_list list) {
+    if (!shim_format_is_supported(format, /*allow_n=*/true)) {
+        return REAL_SYMBOL(vasprintf_t, vasprintf)(string_out, format, list);
+    }
+
+    return shim_format_to_allocation(string_out, format, list);
+}
+
+SHIM_EXPORT int asprintf(char **const string_out, const char *const format, ...)
+{
+    va_list list;
+    va_start(list, format);
+
+    const int result = vasprintf(string_out, format, list);
+
+    va_end(list);
+    return result;
+}
+
+/*
+ * The _FORTIFY_SOURCE variants. A positive flag forbids %n in writable
+ * formats, so those are left to libc, which knows where format lives.
+ */
+
+SHIM_EXPORT int
+__vsnprintf_chk(char *const buffer,
+                const size_t size,
+                const int flag,
+                const size_t object_size,
+                const char *const format,
+                va_list list)
+{
+    if (object_size < size) {
+        __chk_fail();
+    }
+
+    if (!shim_format_is_supported(format, /*allow_n=*/flag <= 0)) {
+        return REAL_SYMBOL(vsnprintf_chk_t, __vsnprintf_chk)(buffer,
+                                                             size,
+                                                             flag,
+                                                             object_size,
+                                                             format,
+                                                             list);
+    }
+
+    return shim_format_to_buffer(buffer, size, format, list);
+}
+
+SHIM_EXPORT int
+__snprintf_chk(char *const buffer,
+               const size_t size,
+               const int flag,
+               const size_t object_size,
+               const char *const format,
+               ...)
+{
+    va_list list;
+    va_start(list, format);
+
+    const int result =
+        __vsnprintf_chk(buffer, size, flag, object_size, format, list);
+
+    va_end(list);
+    return result;
+}
+
+SHIM_EXPORT int
+__vsprintf_chk(char *const buffer,
+               const int flag,
+               const size_t object_size,
+               const char *const format,
+               va_list list)
+{
+    if (!shim_format_is_supported(format, /*allow_n=*/flag <= 0)) {
+        return REAL_SYMBOL(vsprintf_chk_t, __vsprintf_chk)(buffer,
+                                                           flag,
+                                                           object_size,
+                                                           format,
+                                                           list);
+    }
+
+    // Nothing is written past object_size, but the overflow is still fatal.
+    const int result =
+        shim_format_to_buffer(buffer, object_size, format, list);
+
+    if (result >= 0 && (size_t)result >= object_size) {
+        __chk_fail();
+    }
+
+    return result;
+}
+
+SHIM_EXPORT int
+__sprintf_chk(char *const buffer,
+              const int flag,
+              const size_t object_size,
+              const char *const format,
+              ...)
+{
+    va_list list;
+    va_start(list, format);
+
+    const int result =
+        __vsprintf_chk(buffer, flag, object_size, format, list);
+
+    va_end(list);
+    return result;
+}
+
+SHIM_EXPORT int
+__vdprintf_chk(const int fd,
+               const int flag,
+               const char *const format,
+               va_list list)
+{
+    if (!shim_format_is_supported(format, /*allow_n=*/flag <= 0)) {
+        return REAL_SYMBOL(vdprintf_chk_t, __vdprintf_chk)(fd,
+                                                           flag,
+                                                           format,
+                                                           list);
+    }
+
+    return shim_format_to_fd(fd, format, list);
+}
+
+SHIM_EXPORT int
+__dprintf_chk(const int fd, const int flag, const char *const format, ...) {
+    va_list list;
+    va_start(list, format);
+
+    const int result = __vdprintf_chk(fd, flag, format, list);
+
+    va_end(list);
+    return result;
+}
+
+SHIM_EXPORT int
+__vasprintf_chk(char **const string_out,
+                const int flag,
+                const char *const format,
+                va_list list)
+{
+    if (!shim_format_is_supported(format, /*allow_n=*/flag <= 0)) {
+        return REAL_SYMBOL(vasprintf_chk_t, __vasprintf_chk)(string_out,
+                                                             flag,
+                                                             format,
+                                                             list);
+    }
+
+    return shim_format_to_allocation(string_out, format, list);
+}
+
+SHIM_EXPORT int
+__asprintf_chk(char **const string_out,
+               const int flag,
+               const char *const format,
+               ...)
+{
+    va_list list;
+    va_start(list, format);
+
+    const int result = __vasprintf_chk(string_out, flag, format, list);
+
+    va_end(list);
+    return result;
+}
@@ -0,0 +1,207 @@
+/*
+ * An ordinary program that only uses libc's snprintf() family. `make
+ * shim_run` runs it with and without libprintf_shim.so preloaded, and compares
+ * the output byte-for-byte. Timings go to stderr, so they aren't compared.
+ */
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wchar.h>
+
+#define BENCH_ITERATIONS 200000
+#define BENCH_ROUNDS 10
+
+static void print_result(const char *const name, const int result) {
+    printf("%s -> %d\n", name, result);
+}
+
+/*
+ * Formats into a buffer of each size from 0 up to the full length, so every
+ * truncation point is compared.
+ */
+
+#define CHECK(format, ...) \
+    do { \
+        char full[512]; \
+        const int length = snprintf(full, sizeof(full), format, __VA_ARGS__); \
+        print_result(format, length); \
+        printf("[%s]\n", full); \
+        for (int size = 0; size <= length && size < 64; size++) { \
+            char buffer[64]; \
+            memset(buffer, '@', sizeof(buffer)); \
+            const int result = snprintf(buffer, size, format, __VA_ARGS__); \
+            if (result != length || \
+                memcmp(buffer, full, size != 0 ? size - 1 : 0) != 0 || \
+                (size != 0 && buffer[size - 1] != '\0') || \
+                buffer[size] != '@') \
+            { \
+                printf("mismatch at size %d\n", size); \
+            } \
+        } \
+    } while (false)
+
+static int call_vsnprintf(char *const buffer, const size_t size, ...) {
+    va_list list;
+    va_start(list, size);
+
+    const int result = vsnprintf(buffer, size, "%s=%-6d|%#x", list);
+
+    va_end(list);
+    return result;
+}
+
+// Undefined or odd combinations are compared too, as callers rely on them.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat"
+
+static void check_integers(void) {
+    CHECK("%d %i %u", 0, -1, 4000000000u);
+    CHECK("%d %d", INT_MIN, INT_MAX);
+    CHECK("%ld %lu", LONG_MIN, ULONG_MAX);
+    CHECK("%lld %llu", LLONG_MIN, ULLONG_MAX);
+    CHECK("%hhd %hhu %hd %hu", 200, -1, 70000, -1);
+    CHECK("%jd %zu %td", (intmax_t)-5, (size_t)5, (ptrdiff_t)-5);
+    CHECK("%o %x %X", 8, 0xbeef, 0xbeef);
+    CHECK("%#o %#x %#X %#o %#x", 8, 0xbeef, 0xbeef, 0, 0);
+    CHECK("%5d|%-5d|%05d|%+d|% d", 42, 42, 42, 42, 42);
+    CHECK("%+5d|%-+5d|% 05d|%+05d", -42, 42, 42, 42);
+    CHECK("%.3d|%.0d|%.0x|%#.0o|%8.3d", 7, 0, 0, 0, -7);
+    CHECK("%08.3d|%-8.3x|%#08x|%#-8o", 7, 7, 255, 8);
+    CHECK("%*d|%-*d|%*d", 6, 1, 6, 2, -6, 3);
+    CHECK("%.*d|%.*d", 4, 5, -1, 5);
+    CHECK("%+u|% u|%+x", 5u, 5u, 5u);
+    CHECK("%- d|%- 5d|% .0d|% 5.3d|%+.0d|%+3.0d", 42, 42, 0, 7, 0, 0);
+    CHECK("%#5.0o|%#.5o|%#5x|%#-6X|", 0, 8, 0, 0);
+    CHECK("%hhx %hho %#hX %.*d", 0x1ff, 0x1ff, 0x1ffff, -2, 5);
+}
+
+static void check_strings(void) {
+    const char *const null_string = NULL;
+
+    CHECK("%s|%10s|%-10s|%.3s", "hello", "hello", "hello", "hello");
+    CHECK("%.*s|%*s", 2, "hello", -8, "hi");
+    CHECK("%s|%.3s|%.6s|%8s", null_string, null_string, null_string,
+          null_string);
+    CHECK("%c%c%c|%3c|%-3c|", 'a', 'b', 'c', 'x', 'y');
+    CHECK("%p|%p|%20p|%-20p|", (void *)0x1234, NULL, (void *)0xabc, NULL);
+    CHECK("100%% %s", "done");
+    CHECK("%s", "");
+    CHECK("no specs at all%s", "");
+}
+
+static void check_fallbacks(void) {
+    CHECK("%f|%.2e|%g|%a", 3.25, 1e10, 0.5, 1.0);
+    CHECK("%2$s %1$s", "world", "hello");
+    CHECK("%'d", 1234567);
+    CHECK("%ls|%lc", L"wide", (wint_t)L'w');
+    CHECK("%Lf", 1.5L);
+    CHECK("%+p|% p|%08p|%.5p|", (void *)0x1234, (void *)0x1234,
+          (void *)0x1234, (void *)0x1234);
+    CHECK("%+p|% 20p|%.0p|%-+8.3p|", NULL, NULL, NULL, (void *)0xab);
+    CHECK("%m%s", "");
+}
+
+#pragma GCC diagnostic pop
+
+static void check_entry_points(void) {
+    char buffer[128];
+    int count = 0;
+    short short_count = 0;
+
+    print_result("sprintf", sprintf(buffer, "%s-%04d%n", "id", 7, &count));
+    printf("[%s] n=%d\n", buffer, count);
+
+    print_result("snprintf %hn",
+                 snprintf(buffer, 4, "%s%hn", "abcdef", &short_count));
+    printf("[%s] n=%d\n", buffer, short_count);
+
+    print_result("vsnprintf", call_vsnprintf(buffer, 9, "key", 12, 255));
+    printf("[%s]\n", buffer);
+
+    char *allocated = NULL;
+    print_result("asprintf", asprintf(&allocated, "%s %d %#x", "x", 1, 2));
+    printf("[%s]\n", allocated);
+    free(allocated);
+
+    allocated = NULL;
+    print_result("asprintf fallback", asprintf(&allocated, "%.1f", 2.25));
+    printf("[%s]\n", allocated);
+    free(allocated);
+
+    fflush(stdout);
+    const int written =
+        dprintf(STDOUT_FILENO, "dprintf %s %d %5x\n", "to fd", -3, 0xf);
+
+    print_result("dprintf", written);
+
+    print_result("dprintf bad fd", dprintf(-1, "%d\n", 1));
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void bench(void) {
+    char buffer[128];
+    uint64_t checksum = 0;
+
+    // Report the fastest round, to keep other load out of the comparison.
+    uint64_t best = UINT64_MAX;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        const uint64_t start = now_ns();
+        for (int i = 0; i < BENCH_ITERATIONS; i++) {
+            checksum +=
+                (uint64_t)snprintf(buffer,
+                                   sizeof(buffer),
+                                   "[%s] conn=%d bytes=%zu addr=%#x "
+                                   "status=%-4u\n",
+                                   "http",
+                                   i,
+                                   (size_t)i * 1500,
+                                   (unsigned)i * 2654435761u,
+                                   (unsigned)(i % 600));
+        }
+
+        const uint64_t elapsed = now_ns() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    printf("bench checksum %llu\n", (unsigned long long)checksum);
+
+    Dl_info info;
+    const char *library = "?";
+    if (dladdr((void *)snprintf, &info) != 0 && info.dli_fname != NULL) {
+        library = info.dli_fname;
+    }
+
+    fprintf(stderr,
+            "snprintf from %s: %.1f ns/call\n",
+            library,
+            (double)best / BENCH_ITERATIONS);
+}
+
+int main(void) {
+    check_integers();
+    check_strings();
+    check_fallbacks();
+    check_entry_points();
+    bench();
+
+    return 0;
+}
@@ -0,0 +1,421 @@
+/*
+Copyright (c) 2023 Suhas Pai
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+
+extern "C" {
+    #include "parse_printf.h"
+}
+
+/*
+ * Header-only C++ adapters, which format through parse_printf_format64()
+ * into standard containers and iterators:
+ *
+ * - append_format() appends to a std::string, std::vector<char>, or any other
+ *   container of char, reserving room for an estimate of the length first.
+ * - basic_builder builds a string with any allocator. pmr::builder takes a
+ *   std::pmr::memory_resource, e.g. a monotonic buffer on the stack.
+ * - format_to_span() writes into a fixed std::span<char>, and truncates.
+ * - format_to() writes to an output iterator, in batches.
+ *
+ * Every function returns, or reports, the length of the output, counted in 64
+ * bits. Nothing is null-terminated, except by the container. Exceptions from
+ * the container or iterator, like std::bad_alloc, stop formatting and are
+ * rethrown to the caller.
+ */
+
+namespace embedded_printf {
+
+namespace detail {
+
+    /*
+     * Exceptions can't unwind through the C engine, so the callbacks catch
+     * them, stop formatting, and vformat() rethrows them once the engine has
+     * returned.
+     */
+
+    template <typename Sink>
+    struct callback_info {
+        Sink &sink;
+        std::exception_ptr error;
+    };
+
+    // Sinks have write() overloads for runs of one character, and strings.
+    template <typename Sink>
+    std::size_t
+    write_ch_callback(struct printf_spec_info *const spec_info,
+                      void *const info,
+                      const char ch,
+                      const std::size_t times,
+                      bool *const should_continue_out)
+    {
+        (void)spec_info;
+
+        auto *const callback = static_cast<callback_info<Sink> *>(info);
+        try {
+            return callback->sink.write(ch, times, should_continue_out);
+        } catch (...) {
+            callback->error = std::current_exception();
+            *should_continue_out = false;
+
+            return 0;
+        }
+    }
+
+    template <typename Sink>
+    std::size_t
+    write_string_callback(struct printf_spec_info *const spec_info,
+                          void *const info,
+                          const char *const string,
+                          const std::size_t length,
+                          bool *const should_continue_out)
+    {
+        (void)spec_info;
+
+        auto *const callback = static_cast<callback_info<Sink> *>(info);
+        try {
+            return callback->sink.write(string, length, should_continue_out);
+        } catch (...) {
+            callback->error = std::current_exception();
+            *should_continue_out = false;
+
+            return 0;
+        }
+    }
+
+    template <typename Sink>
+    std::uint64_t
+    vformat(Sink &sink, const char *const fmt, va_list list) {
+        callback_info<Sink> info{ sink, nullptr };
+        const std::uint64_t result =
+            parse_printf_format64(write_ch_callback<Sink>,
+                                  &info,
+                                  write_string_callback<Sink>,
+                                  &info,
+                                  fmt,
+                                  list);
+
+        if (info.error != nullptr) {
+            std::rethrow_exception(info.error);
+        }
+
+        return result;
+    }
+
+    template <typename Container>
+    class append_sink {
+    public:
+        explicit append_sink(Container &out) noexcept : out_(out) {}
+
+        std::size_t write(const char ch, const std::size_t times, bool *) {
+            if constexpr (requires { out_.append(times, ch); }) {
+                out_.append(times, ch);
+            } else {
+                out_.insert(out_.end(), times, ch);
+            }
+
+            return times;
+        }
+
+        std::size_t
+        write(const char *const string, const std::size_t length, bool *) {
+            if constexpr (requires { out_.append(string, length); }) {
+                out_.append(string, length);
+            } else {
+                out_.insert(out_.end(), string, string + length);
+            }
+
+            return length;
+        }
+
+    private:
+        Container &out_;
+    };
+
+    class span_sink {
+    public:
+        explicit span_sink(const std::span<char> out) noexcept : out_(out) {}
+
+        std::size_t
+        write(const char ch, std::size_t times, bool *const should_continue_out)
+        {
+            times = fit(times, should_continue_out);
+            std::fill_n(out_.data() + used_, times, ch);
+
+            used_ += times;
+            return times;
+        }
+
+        std::size_t
+        write(const char *const string,
+              std::size_t length,
+              bool *const should_continue_out)
+        {
+            length = fit(length, should_continue_out);
+            std::copy_n(string, length, out_.data() + used_);
+
+            used_ += length;
+            return length;
+        }
+
+        std::size_t used() const noexcept { return used_; }
+        bool truncated() const noexcept { return truncated_; }
+
+    private:
+        std::size_t
+        fit(const std::size_t length, bool *const should_continue_out) noexcept
+        {
+            const std::size_t room = out_.size() - used_;
+            if (length <= room) {
+                return length;
+            }
+
+            truncated_ = true;
+            *should_continue_out = false;
+
+            return room;
+        }
+
+        std::span<char> out_;
+        std::size_t used_ = 0;
+        bool truncated_ = false;
+    };
+
+    /*
+     * Collects output into a batch, and copies whole batches to the iterator,
+     * so the iterator isn't called for every small piece. Strings at least as
+     * long as a batch are copied directly.
+     */
+
+    template <typename OutputIt>
+    class iterator_sink {
+    public:
+        explicit iterator_sink(OutputIt out) : out_(std::move(out)) {}
+
+        std::size_t write(const char ch, std::size_t times, bool *) {
+            const std::size_t result = times;
+            while (times != 0) {
+                const std::size_t amount =
+                    std::min(times, sizeof(batch_) - used_);
+
+                std::memset(batch_ + used_, ch, amount);
+                used_ += amount;
+                times -= amount;
+
+                if (used_ == sizeof(batch_)) {
+                    flush();
+                }
+            }
+
+            return result;
+        }
+
+        std::size_t
+        write(const char *const string, const std::size_t length, bool *) {
+            if (length > sizeof(batch_) - used_) {
+                flush();
+                if (length >= sizeof(batch_)) {
+                    out_ = std::copy(string, string + length, out_);
+                    return length;
+                }
+            }
+
+            std::memcpy(batch_ + used_, string, length);
+            used_ += length;
+
+            return length;
+        }
+
+        OutputIt finish() {
+            flush();
+            return std::move(out_);
+        }
+
+    private:
+        void flush() {
+            out_ = std::copy(batch_, batch_ + used_, out_);
+            used_ = 0;
+        }
+
+        OutputIt out_;
+        std::size_t used_ = 0;
+        char batch_[256];
+    };
+
+} // namespace detail
+
+/*
+ * A guess at the length of fmt's output: its literal text, plus
+ * estimated_conversion_length for each conversion. It's cheap, and usually
+ * close for log lines, but isn't a bound.
+ */
+
+inline constexpr std::size_t estimated_conversion_length = 16;
+
+inline std::size_t estimate_length(const char *fmt) noexcept {
+    std::size_t length = 0;
+    for (; *fmt != '\0'; fmt++) {
+        length += *fmt != '%' ? 1 : estimated_conversion_length;
+    }
+
+    return length;
+}
+
+/*
+ * Append to out, a container of char with reserve(), like std::string or
+ * std::vector<char>. Room for estimate_length(fmt) more is reserved first,
+ * growing capacity at least twofold, so that repeated appends are amortized
+ * even for containers whose reserve() allocates exactly what it's asked for.
+ */
+
+template <typename Container>
+std::uint64_t
+append_vformat(Container &out, const char *const fmt, va_list list) {
+    const std::size_t wanted = out.size() + estimate_length(fmt);
+    if (wanted > out.capacity()) {
+        out.reserve(std::max(wanted, 2 * out.capacity()));
+    }
+
+    detail::append_sink<Container> sink(out);
+    return detail::vformat(sink, fmt, list);
+}
+
+template <typename Container>
+__attribute__((format(printf, 2, 3)))
+std::uint64_t append_format(Container &out, const char *const fmt, ...) {
+    va_list list;
+    va_start(list, fmt);
+
+    const std::uint64_t result = append_vformat(out, fmt, list);
+
+    va_end(list);
+    return result;
+}
+
+// Builds a string with Allocator, by appending formatted text.
+template <typename Allocator = std::allocator<char>>
+class basic_builder {
+public:
+    using string_type =
+        std::basic_string<char, std::char_traits<char>, Allocator>;
+
+    basic_builder() = default;
+    explicit basic_builder(const Allocator &allocator) : text_(allocator) {}
+
+    __attribute__((format(printf, 2, 3)))
+    std::uint64_t format(const char *const fmt, ...) {
+        va_list list;
+        va_start(list, fmt);
+
+        const std::uint64_t result = vformat(fmt, list);
+
+        va_end(list);
+        return result;
+    }
+
+    std::uint64_t vformat(const char *const fmt, va_list list) {
+        return append_vformat(text_, fmt, list);
+    }
+
+    std::string_view view() const noexcept { return text_; }
+    const string_type &str() const & noexcept { return text_; }
+    string_type str() && noexcept { return std::move(text_); }
+
+    // Keeps the capacity, for building the next string.
+    void clear() noexcept { text_.clear(); }
+
+private:
+    string_type text_;
+};
+
+using builder = basic_builder<>;
+
+namespace pmr {
+    using builder = basic_builder<std::pmr::polymorphic_allocator<char>>;
+} // namespace pmr
+
+struct format_to_span_result {
+    // The number of characters written to the span.
+    std::size_t size;
+
+    // Set if the output didn't fit, and was cut off at the end of the span.
+    bool truncated;
+};
+
+inline format_to_span_result
+vformat_to_span(const std::span<char> out, const char *const fmt, va_list list)
+{
+    detail::span_sink sink(out);
+    detail::vformat(sink, fmt, list);
+
+    return format_to_span_result{ sink.used(), sink.truncated() };
+}
+
+__attribute__((format(printf, 2, 3)))
+inline format_to_span_result
+format_to_span(const std::span<char> out, const char *const fmt, ...) {
+    va_list list;
+    va_start(list, fmt);
+
+    const format_to_span_result result = vformat_to_span(out, fmt, list);
+
+    va_end(list);
+    return result;
+}
+
+// Returns the iterator past the output, like std::format_to().
+template <typename OutputIt>
+OutputIt vformat_to(OutputIt out, const char *const fmt, va_list list) {
+    detail::iterator_sink<OutputIt> sink(std::move(out));
+    detail::vformat(sink, fmt, list);
+
+    return sink.finish();
+}
+
+template <typename OutputIt>
+__attribute__((format(printf, 2, 3)))
+OutputIt format_to(OutputIt out, const char *const fmt, ...) {
+    va_list list;
+    va_start(list, fmt);
+
+    OutputIt result = vformat_to(std::move(out), fmt, list);
+
+    va_end(list);
+    return result;
+}
+
+} // namespace embedded_printf
@@ -0,0 +1,340 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "printf_source.h"
+
+/******* PRIVATE FUNCTIONS *******/
+
+static inline bool is_ident_char(const char ch) {
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z')
+        || (ch >= '0' && ch <= '9') || ch == '_';
+}
+
+// Skip whitespace, comments and line continuations.
+static const char *skip_space(const char *iter) {
+    while (true) {
+        if (*iter == ' ' || *iter == '\t' || *iter == '\n' || *iter == '\r'
+            || *iter == '\\')
+        {
+            iter++;
+        } else if (iter[0] == '/' && iter[1] == '/') {
+            while (*iter != '\0' && *iter != '\n') {
+                iter++;
+            }
+        } else if (iter[0] == '/' && iter[1] == '*') {
+            const char *const end = strstr(iter + 2, "*/");
+            iter = end != NULL ? end + 2 : iter + strlen(iter);
+        } else {
+            return iter;
+        }
+    }
+}
+
+// Skip a string or character literal, with iter pointing at the quote.
+static const char *skip_literal(const char *iter) {
+    const char quote = *iter++;
+    while (*iter != '\0' && *iter != quote) {
+        if (*iter == '\\' && iter[1] != '\0') {
+            iter++;
+        }
+
+        iter++;
+    }
+
+    return *iter == quote ? iter + 1 : iter;
+}
+
+static inline int hex_value(const char ch) {
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+
+    if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    }
+
+    if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+
+    return -1;
+}
+
+/*
+ * Append the contents of the string literal at iter to out, undoing escapes.
+ * Returns NULL if the literal isn't terminated.
+ */
+
+static const char *
+read_literal(const char *iter, char *const out, uint32_t *const length) {
+    iter++;
+    while (*iter != '"') {
+        if (*iter == '\0' || *iter == '\n') {
+            return NULL;
+        }
+
+        if (*iter != '\\') {
+            out[(*length)++] = *iter++;
+            continue;
+        }
+
+        iter++;
+        char ch = *iter++;
+
+        switch (ch) {
+            case 'n': ch = '\n'; break;
+            case 't': ch = '\t'; break;
+            case 'r': ch = '\r'; break;
+            case 'a': ch = '\a'; break;
+            case 'b': ch = '\b'; break;
+            case 'f': ch = '\f'; break;
+            case 'v': ch = '\v'; break;
+            case 'x': {
+                int value = 0;
+                while (hex_value(*iter) != -1) {
+                    value = value * 16 + hex_value(*iter++);
+                }
+
+                ch = (char)value;
+                break;
+            }
+            default:
+                if (ch >= '0' && ch <= '7') {
+                    int value = ch - '0';
+                    for (int i = 0; i != 2 && *iter >= '0' && *iter <= '7';
+                         i++)
+                    {
+                        value = value * 8 + (*iter++ - '0');
+                    }
+
+                    ch = (char)value;
+                }
+
+                // Otherwise, it's one of \\, \", \' or \?.
+                break;
+        }
+
+        out[(*length)++] = ch;
+    }
+
+    return iter + 1;
+}
+
+/*
+ * Parse the arguments of a call, with iter pointing right past the '('.
+ * Passes the format to callback if it's made up of string literals.
+ */
+
+static const char *
+scan_call_args(const char *iter,
+               const uint32_t format_index,
+               const printf_source_format_callback_t callback,
+               void *const info,
+               bool *const failed_out)
+{
+    uint32_t arg_index = 0;
+    uint32_t depth = 0;
+
+    iter = skip_space(iter);
+    while (*iter != '\0') {
+        if (depth == 0 && arg_index == format_index && *iter == '"') {
+            char *const format = malloc(strlen(iter) + 1);
+            uint32_t length = 0;
+
+            if (format == NULL) {
+                *failed_out = true;
+                return iter;
+            }
+
+            // Adjacent literals are concatenated.
+            const char *literal_end = iter;
+            while (*literal_end == '"') {
+                literal_end = read_literal(literal_end, format, &length);
+                if (literal_end == NULL) {
+                    free(format);
+                    return iter + 1;
+                }
+
+                literal_end = skip_space(literal_end);
+            }
+
+            if (*literal_end != ',' && *literal_end != ')') {
+                free(format);
+                iter = literal_end;
+                continue;
+            }
+
+            if (!callback(info, format, length)) {
+                *failed_out = true;
+            }
+
+            iter = literal_end;
+            continue;
+        }
+
+        switch (*iter) {
+            case '"':
+            case '\'':
+                iter = skip_space(skip_literal(iter));
+                continue;
+            case '(':
+            case '[':
+            case '{':
+                depth++;
+                break;
+            case ')':
+                if (depth == 0) {
+                    return iter + 1;
+                }
+
+                depth--;
+                break;
+            case ']':
+            case '}':
+                if (depth != 0) {
+                    depth--;
+                }
+
+                break;
+            case ',':
+                if (depth == 0) {
+                    arg_index++;
+                    iter = skip_space(iter + 1);
+                    continue;
+                }
+
+                break;
+        }
+
+        iter++;
+    }
+
+    return iter;
+}
+
+/******* PUBLIC FUNCTIONS *******/
+
+char *
+printf_source_read_file(const char *const path, size_t *const length_out) {
+    FILE *const file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    size_t capacity = 4096;
+    size_t length = 0;
+    char *data = malloc(capacity + 1);
+
+    while (data != NULL) {
+        length += fread(data + length, 1, capacity - length, file);
+        if (length != capacity) {
+            break;
+        }
+
+        capacity *= 2;
+
+        char *const grown = realloc(data, capacity + 1);
+        if (grown == NULL) {
+            free(data);
+        }
+
+        data = grown;
+    }
+
+    fclose(file);
+    if (data != NULL) {
+        data[length] = '\0';
+        *length_out = length;
+    }
+
+    return data;
+}
+
+bool
+printf_source_scan(const char *const source,
+                   const struct printf_source_call *const calls,
+                   const uint32_t call_count,
+                   const printf_source_format_callback_t callback,
+                   void *const info)
+{
+    bool failed = false;
+    const char *iter = source;
+
+    while (*iter != '\0' && !failed) {
+        if (*iter == '"' || *iter == '\'') {
+            iter = skip_literal(iter);
+            continue;
+        }
+
+        if ((iter[0] == '/' && (iter[1] == '/' || iter[1] == '*'))) {
+            iter = skip_space(iter);
+            continue;
+        }
+
+        if (!is_ident_char(*iter)) {
+            iter++;
+            continue;
+        }
+
+        const char *const ident = iter;
+        while (is_ident_char(*iter)) {
+            iter++;
+        }
+
+        const size_t ident_length = (size_t)(iter - ident);
+        for (uint32_t i = 0; i != call_count; i++) {
+            const struct printf_source_call *const call = &calls[i];
+            if (strlen(call->name) != ident_length
+                || memcmp(call->name, ident, ident_length) != 0)
+            {
+                continue;
+            }
+
+            const char *const paren = skip_space(iter);
+            if (*paren == '(') {
+                iter = scan_call_args(paren + 1,
+                                      call->format_index,
+                                      callback,
+                                      info,
+                                      &failed);
+            }
+
+            break;
+        }
+    }
+
+    return !failed;
+}
+
+void
+printf_source_write_c_string(const char *const string, const uint32_t length) {
+    putchar('"');
+    for (uint32_t i = 0; i != length; i++) {
+        const unsigned char ch = (unsigned char)string[i];
+        switch (ch) {
+            case '\n':
+                fputs("\\n", stdout);
+                break;
+            case '\t':
+                fputs("\\t", stdout);
+                break;
+            case '"':
+            case '\\':
+                putchar('\\');
+                putchar(ch);
+                break;
+            default:
+                if (ch < 0x20 || ch >= 0x7f) {
+                    // Octal escapes stop after 3 digits, unlike hex ones.
+                    printf("\\%03o", ch);
+                } else {
+                    putchar(ch);
+                }
+
+                break;
+        }
+    }
+
+    putchar('"');
+}
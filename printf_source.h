@@ -0,0 +1,68 @@
+/*
+Copyright (c) 2023 Suhas Pai
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Helpers for the host tools that extract format strings from C sources
+ * (printf_tokenize and printf_precompile).
+ */
+
+// A function or macro whose format argument is extracted.
+struct printf_source_call {
+    const char *name;
+
+    // Index of the format-string argument.
+    uint32_t format_index;
+};
+
+/*
+ * Receives each format that's made up of string literals, with escapes undone
+ * and adjacent literals concatenated. format is allocated with malloc(), and
+ * is owned by the callback. Returns false to stop scanning.
+ */
+
+typedef bool
+(*printf_source_format_callback_t)(void *info, char *format, uint32_t length);
+
+// Returns a null-terminated copy of the file, or NULL on failure.
+char *printf_source_read_file(const char *path, size_t *length_out);
+
+/*
+ * Find the calls to the functions or macros in calls, and pass their literal
+ * formats to callback. Returns false if callback failed.
+ */
+
+bool
+printf_source_scan(const char *source,
+                   const struct printf_source_call *calls,
+                   uint32_t call_count,
+                   printf_source_format_callback_t callback,
+                   void *info);
+
+// Write string to stdout as a C string literal.
+void printf_source_write_c_string(const char *string, uint32_t length);
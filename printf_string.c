@@ -0,0 +1,177 @@
+#include <stdint.h>
+
+#include "printf_string.h"
+
+/******* PRIVATE FUNCTIONS *******/
+
+typedef uintptr_t __attribute__((may_alias)) swar_word;
+
+#define SWAR_WORD_SIZE sizeof(swar_word)
+#define SWAR_WORD_BYTES(byte) ((UINTPTR_MAX / 0xff) * (uint8_t)(byte))
+
+/*
+ * The byte loops that handle the unaligned ends must not be turned back into
+ * calls to memset() or memcpy(), which may be these very functions.
+ */
+
+#if defined(__GNUC__) && !defined(__clang__)
+    #define SWAR_NO_LIBCALLS \
+        __attribute__((optimize("no-tree-loop-distribute-patterns")))
+#else
+    #define SWAR_NO_LIBCALLS
+#endif
+
+/*
+ * Sets the high bit of each zero byte in word, and clears every other bit.
+ * Unlike the shorter (word - 0x01..) & ~word & 0x80.. form, a zero byte
+ * doesn't also mark the byte after it, so the first marked byte is exact in
+ * either byte order.
+ */
+
+static inline uintptr_t zero_byte_mask(const uintptr_t word) {
+    const uintptr_t low_bits = SWAR_WORD_BYTES(0x7f);
+    return ~(((word & low_bits) + low_bits) | word | low_bits);
+}
+
+// The index, in memory order, of the first byte marked in a non-zero mask.
+static inline size_t first_marked_byte(const uintptr_t mask) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    #if UINTPTR_MAX == UINT64_MAX
+        return (size_t)__builtin_clzll(mask) / 8;
+    #else
+        return (size_t)__builtin_clz(mask) / 8;
+    #endif
+#else
+    #if UINTPTR_MAX == UINT64_MAX
+        return (size_t)__builtin_ctzll(mask) / 8;
+    #else
+        return (size_t)__builtin_ctz(mask) / 8;
+    #endif
+#endif
+}
+
+// A mask of the bytes of a word at or after offset, in memory order.
+static inline uintptr_t bytes_from(const size_t offset) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return UINTPTR_MAX >> (offset * 8);
+#else
+    return UINTPTR_MAX << (offset * 8);
+#endif
+}
+
+/******* PUBLIC FUNCTIONS *******/
+
+__attribute__((no_sanitize_address))
+size_t swar_strlen(const char *const str) {
+    // Start at the aligned word holding str, ignoring the bytes before it.
+    const size_t offset = (uintptr_t)str % SWAR_WORD_SIZE;
+    const swar_word *word = (const swar_word *)(const void *)(str - offset);
+
+    uintptr_t mask = zero_byte_mask(*word) & bytes_from(offset);
+    while (mask == 0) {
+        word++;
+        mask = zero_byte_mask(*word);
+    }
+
+    return (size_t)((const char *)word - str) + first_marked_byte(mask);
+}
+
+__attribute__((no_sanitize_address))
+size_t swar_strnlen(const char *const str, const size_t max) {
+    if (max == 0) {
+        return 0;
+    }
+
+    const size_t offset = (uintptr_t)str % SWAR_WORD_SIZE;
+    const swar_word *word = (const swar_word *)(const void *)(str - offset);
+
+    // Only read a word if it holds at least one of the first max bytes.
+    uintptr_t mask = zero_byte_mask(*word) & bytes_from(offset);
+    size_t scanned = SWAR_WORD_SIZE - offset;
+
+    while (mask == 0) {
+        if (scanned >= max) {
+            return max;
+        }
+
+        word++;
+        mask = zero_byte_mask(*word);
+        scanned += SWAR_WORD_SIZE;
+    }
+
+    const size_t length = scanned - SWAR_WORD_SIZE + first_marked_byte(mask);
+    return length < max ? length : max;
+}
+
+__attribute__((no_sanitize_address))
+const char *swar_find_percent(const char *const str) {
+    const size_t offset = (uintptr_t)str % SWAR_WORD_SIZE;
+    const swar_word *word = (const swar_word *)(const void *)(str - offset);
+
+    uintptr_t value = *word;
+    uintptr_t mask =
+        (zero_byte_mask(value) | zero_byte_mask(value ^ SWAR_WORD_BYTES('%')))
+        & bytes_from(offset);
+
+    while (mask == 0) {
+        word++;
+        value = *word;
+        mask = zero_byte_mask(value)
+             | zero_byte_mask(value ^ SWAR_WORD_BYTES('%'));
+    }
+
+    const char *const found = (const char *)word + first_marked_byte(mask);
+    return *found == '%' ? found : NULL;
+}
+
+SWAR_NO_LIBCALLS
+void swar_memset(void *const dst, const int ch, const size_t length) {
+    unsigned char *iter = dst;
+    unsigned char *const end = iter + length;
+
+    if (length >= SWAR_WORD_SIZE) {
+        for (; (uintptr_t)iter % SWAR_WORD_SIZE != 0; iter++) {
+            *iter = (unsigned char)ch;
+        }
+
+        const uintptr_t value = SWAR_WORD_BYTES(ch);
+        for (; (size_t)(end - iter) >= SWAR_WORD_SIZE;
+             iter += SWAR_WORD_SIZE)
+        {
+            *(swar_word *)(void *)iter = value;
+        }
+    }
+
+    for (; iter != end; iter++) {
+        *iter = (unsigned char)ch;
+    }
+}
+
+SWAR_NO_LIBCALLS
+void
+swar_memcpy(void *const dst, const void *const src, const size_t length) {
+    unsigned char *iter = dst;
+    unsigned char *const end = iter + length;
+    const unsigned char *src_iter = src;
+
+    if (length >= SWAR_WORD_SIZE) {
+        for (; (uintptr_t)iter % SWAR_WORD_SIZE != 0; iter++, src_iter++) {
+            *iter = *src_iter;
+        }
+
+        // Stores are aligned. Loads may not be, so let the compiler pick the
+        // load that's safe for the target.
+        for (; (size_t)(end - iter) >= SWAR_WORD_SIZE;
+             iter += SWAR_WORD_SIZE, src_iter += SWAR_WORD_SIZE)
+        {
+            uintptr_t value;
+            __builtin_memcpy(&value, src_iter, SWAR_WORD_SIZE);
+
+            *(swar_word *)(void *)iter = value;
+        }
+    }
+
+    for (; iter != end; iter++, src_iter++) {
+        *iter = *src_iter;
+    }
+}
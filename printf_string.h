@@ -0,0 +1,71 @@
+/*
+Copyright (c) 2023 Suhas Pai
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <stddef.h>
+
+#include "printf_config.h"
+
+/*
+ * Word-at-a-time (SWAR) versions of the string and memory functions the
+ * engine needs, for freestanding builds without a libc to provide them.
+ *
+ * Strings are scanned a whole aligned word at a time. An aligned word never
+ * crosses a page, so reading the bytes past the terminator that share its
+ * word is safe, though it isn't valid C, and is hidden from AddressSanitizer.
+ */
+
+size_t swar_strlen(const char *str);
+size_t swar_strnlen(const char *str, size_t max);
+
+/*
+ * Same as strchr(str, '%'): returns the first '%' in str, or NULL if the
+ * terminator comes first.
+ */
+
+const char *swar_find_percent(const char *str);
+
+void swar_memset(void *dst, int ch, size_t length);
+void swar_memcpy(void *dst, const void *src, size_t length);
+
+/*
+ * The primitives the engine calls: libc's in hosted builds, as those are
+ * usually vectorized, and the ones above otherwise.
+ */
+
+#if PRINTF_FREESTANDING
+    #define printf_strlen(str) swar_strlen(str)
+    #define printf_strnlen(str, max) swar_strnlen(str, max)
+    #define printf_find_percent(str) swar_find_percent(str)
+    #define printf_memset(dst, ch, length) swar_memset(dst, ch, length)
+    #define printf_memcpy(dst, src, length) swar_memcpy(dst, src, length)
+#else
+    #include <string.h>
+
+    #define printf_strlen(str) strlen(str)
+    #define printf_strnlen(str, max) strnlen(str, max)
+    #define printf_find_percent(str) strchr(str, '%')
+    #define printf_memset(dst, ch, length) memset(dst, ch, length)
+    #define printf_memcpy(dst, src, length) memcpy(dst, src, length)
+#endif /* PRINTF_FREESTANDING */
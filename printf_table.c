@@ -0,0 +1,261 @@
+#include "printf_table.h"
+
+static size_t
+measure_ch_callback(struct printf_spec_info *const spec_info,
+                    void *const info,
+                    const char ch,
+                    const size_t times,
+                    bool *const should_continue_out)
+{
+    (void)spec_info;
+    (void)info;
+    (void)ch;
+    (void)should_continue_out;
+
+    return times;
+}
+
+static size_t
+measure_string_callback(struct printf_spec_info *const spec_info,
+                        void *const info,
+                        const char *const string,
+                        const size_t length,
+                        bool *const should_continue_out)
+{
+    (void)spec_info;
+    (void)info;
+    (void)string;
+    (void)should_continue_out;
+
+    return length;
+}
+
+/*
+ * Each row is formatted with its own call, so the callbacks are wrapped to
+ * notice when the sink declines more output, and stop at that row.
+ */
+
+struct render_sink {
+    printf_write_char_callback_t write_char_cb;
+    void *char_cb_info;
+    printf_write_string_callback_t write_string_cb;
+    void *string_cb_info;
+
+    bool stopped;
+};
+
+struct render_sink64 {
+    printf_write_char_callback64_t write_char_cb;
+    void *char_cb_info;
+    printf_write_string_callback64_t write_string_cb;
+    void *string_cb_info;
+
+    bool stopped;
+};
+
+static uint32_t
+render_ch_callback(struct printf_spec_info *const spec_info,
+                   void *const info,
+                   const char ch,
+                   const uint32_t times,
+                   bool *const should_continue_out)
+{
+    struct render_sink *const sink = (struct render_sink *)info;
+    const uint32_t result = sink->write_char_cb(spec_info,
+                                                sink->char_cb_info,
+                                                ch,
+                                                times,
+                                                should_continue_out);
+
+    sink->stopped = !*should_continue_out;
+    return result;
+}
+
+static uint32_t
+render_string_callback(struct printf_spec_info *const spec_info,
+                       void *const info,
+                       const char *const string,
+                       const uint32_t length,
+                       bool *const should_continue_out)
+{
+    struct render_sink *const sink = (struct render_sink *)info;
+    const uint32_t result = sink->write_string_cb(spec_info,
+                                                  sink->string_cb_info,
+                                                  string,
+                                                  length,
+                                                  should_continue_out);
+
+    sink->stopped = !*should_continue_out;
+    return result;
+}
+
+static size_t
+render_ch_callback64(struct printf_spec_info *const spec_info,
+                     void *const info,
+                     const char ch,
+                     const size_t times,
+                     bool *const should_continue_out)
+{
+    struct render_sink64 *const sink = (struct render_sink64 *)info;
+    const size_t result = sink->write_char_cb(spec_info,
+                                              sink->char_cb_info,
+                                              ch,
+                                              times,
+                                              should_continue_out);
+
+    sink->stopped = !*should_continue_out;
+    return result;
+}
+
+static size_t
+render_string_callback64(struct printf_spec_info *const spec_info,
+                         void *const info,
+                         const char *const string,
+                         const size_t length,
+                         bool *const should_continue_out)
+{
+    struct render_sink64 *const sink = (struct render_sink64 *)info;
+    const size_t result = sink->write_string_cb(spec_info,
+                                                sink->string_cb_info,
+                                                string,
+                                                length,
+                                                should_continue_out);
+
+    sink->stopped = !*should_continue_out;
+    return result;
+}
+
+/*
+ * The table's format, pointing to its own specs, so a table still works after
+ * being copied by value.
+ */
+
+static inline struct printf_compiled_format
+table_format(const struct printf_table *const table) {
+    struct printf_compiled_format compiled = table->compiled;
+    compiled.specs = table->specs;
+
+    return compiled;
+}
+
+bool
+printf_table_init(struct printf_table *const table,
+                  const char *const row_format)
+{
+    struct printf_arg_table arg_table;
+    if (!printf_arg_table_scan(&arg_table, row_format)) {
+        return false;
+    }
+
+    if (!printf_compile_format(&table->compiled,
+                               table->specs,
+                               PRINTF_TABLE_MAX_COLUMNS,
+                               row_format))
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i != PRINTF_TABLE_MAX_COLUMNS; i++) {
+        table->widths[i] = 0;
+    }
+
+    table->arg_count = arg_table.count;
+    return true;
+}
+
+void
+printf_table_measure(struct printf_table *const table,
+                     const uint64_t *const rows,
+                     const uint32_t row_count)
+{
+    const struct printf_compiled_format compiled = table_format(table);
+    const uint32_t column_count = compiled.spec_count;
+
+    for (uint32_t row = 0; row != row_count; row++) {
+        uint32_t lengths[PRINTF_TABLE_MAX_COLUMNS];
+        parse_printf_compiled_with_args64(measure_ch_callback,
+                                          /*char_cb_info=*/NULL,
+                                          measure_string_callback,
+                                          /*sv_cb_info=*/NULL,
+                                          &compiled,
+                                          /*widths=*/NULL,
+                                          lengths,
+                                          rows + row * table->arg_count);
+
+        for (uint32_t column = 0; column != column_count; column++) {
+            if (table->widths[column] < lengths[column]) {
+                table->widths[column] = lengths[column];
+            }
+        }
+    }
+}
+
+uint32_t
+printf_table_render(const struct printf_table *const table,
+                    const printf_write_char_callback_t write_char_cb,
+                    void *const char_cb_info,
+                    const printf_write_string_callback_t write_string_cb,
+                    void *const string_cb_info,
+                    const uint64_t *const rows,
+                    const uint32_t row_count)
+{
+    struct render_sink sink = {
+        .write_char_cb = write_char_cb,
+        .char_cb_info = char_cb_info,
+        .write_string_cb = write_string_cb,
+        .string_cb_info = string_cb_info,
+        .stopped = false
+    };
+
+    const struct printf_compiled_format compiled = table_format(table);
+
+    uint32_t written_out = 0;
+    for (uint32_t row = 0; row != row_count && !sink.stopped; row++) {
+        written_out +=
+            parse_printf_compiled_with_args(render_ch_callback,
+                                            &sink,
+                                            render_string_callback,
+                                            &sink,
+                                            &compiled,
+                                            table->widths,
+                                            /*lengths=*/NULL,
+                                            rows + row * table->arg_count);
+    }
+
+    return written_out;
+}
+
+uint64_t
+printf_table_render64(const struct printf_table *const table,
+                      const printf_write_char_callback64_t write_char_cb,
+                      void *const char_cb_info,
+                      const printf_write_string_callback64_t write_string_cb,
+                      void *const string_cb_info,
+                      const uint64_t *const rows,
+                      const uint32_t row_count)
+{
+    struct render_sink64 sink = {
+        .write_char_cb = write_char_cb,
+        .char_cb_info = char_cb_info,
+        .write_string_cb = write_string_cb,
+        .string_cb_info = string_cb_info,
+        .stopped = false
+    };
+
+    const struct printf_compiled_format compiled = table_format(table);
+
+    uint64_t written_out = 0;
+    for (uint32_t row = 0; row != row_count && !sink.stopped; row++) {
+        written_out +=
+            parse_printf_compiled_with_args64(render_ch_callback64,
+                                              &sink,
+                                              render_string_callback64,
+                                              &sink,
+                                              &compiled,
+                                              table->widths,
+                                              /*lengths=*/NULL,
+                                              rows + row * table->arg_count);
+    }
+
+    return written_out;
+}
@@ -0,0 +1,98 @@
+/*
+Copyright (c) 2023 Suhas Pai
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "parse_printf.h"
+
+/*
+ * Renders an aligned table, whose rows are all formatted with one format,
+ * e.g. "%-s  %u  %'d\n". Each conversion is a column, and is padded to the
+ * width of the column's widest cell, so cells don't need to be formatted into
+ * scratch strings first, or given hardcoded widths.
+ *
+ * printf_table_measure() runs the engine once per cell, counting lengths
+ * without writing anything, and printf_table_render() then writes the rows
+ * through the callbacks in one pass, as if each conversion had its column's
+ * width. Columns are right-justified, unless their conversion has the '-'
+ * flag, and a conversion's own width is kept as a minimum.
+ *
+ * Rows hold their arguments already decoded, as for
+ * parse_printf_format_with_args(): row r's arguments start at
+ * rows[r * table->arg_count]. Integers are sign- or zero-extended to 64 bits,
+ * and strings and pointers are stored as uintptr_t.
+ */
+
+#define PRINTF_TABLE_MAX_COLUMNS 16
+
+struct printf_table {
+    struct printf_compiled_format compiled;
+    struct printf_compiled_spec specs[PRINTF_TABLE_MAX_COLUMNS];
+
+    // The widest cell of each column measured so far.
+    uint32_t widths[PRINTF_TABLE_MAX_COLUMNS];
+
+    // The number of arguments in each row, including '*' widths and
+    // precisions.
+    uint32_t arg_count;
+};
+
+/*
+ * row_format must outlive the table, and any copies of it. Returns false if
+ * row_format has more than PRINTF_TABLE_MAX_COLUMNS conversions, ends in an
+ * incomplete conversion, or uses positional arguments.
+ */
+
+bool printf_table_init(struct printf_table *table, const char *row_format);
+
+/*
+ * Widen the columns to fit rows. Can be called more than once, e.g. for rows
+ * that come in batches, before rendering them all.
+ */
+
+void
+printf_table_measure(struct printf_table *table,
+                     const uint64_t *rows,
+                     uint32_t row_count);
+
+uint32_t
+printf_table_render(const struct printf_table *table,
+                    printf_write_char_callback_t write_char_cb,
+                    void *char_cb_info,
+                    printf_write_string_callback_t write_string_cb,
+                    void *string_cb_info,
+                    const uint64_t *rows,
+                    uint32_t row_count);
+
+uint64_t
+printf_table_render64(const struct printf_table *table,
+                      printf_write_char_callback64_t write_char_cb,
+                      void *char_cb_info,
+                      printf_write_string_callback64_t write_string_cb,
+                      void *string_cb_info,
+                      const uint64_t *rows,
+                      uint32_t row_count);
@@ -0,0 +1,246 @@
+#include <string.h>
+
+#include "printf_token.h"
+
+/******* PRIVATE FUNCTIONS *******/
+
+static inline uint64_t zigzag_encode(const int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t zigzag_decode(const uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// Returns the new end of the record, or NULL if the value doesn't fit.
+static uint8_t *
+write_varint(uint8_t *out, const uint8_t *const end, uint64_t value) {
+    do {
+        if (out == end) {
+            return NULL;
+        }
+
+        const uint8_t byte = (uint8_t)(value & 0x7f);
+        value >>= 7;
+
+        *out++ = value != 0 ? (byte | 0x80) : byte;
+    } while (value != 0);
+
+    return out;
+}
+
+static const uint8_t *
+read_varint(const uint8_t *in,
+            const uint8_t *const end,
+            uint64_t *const value_out)
+{
+    uint64_t value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+        if (in == end) {
+            return NULL;
+        }
+
+        const uint8_t byte = *in++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+
+        if ((byte & 0x80) == 0) {
+            *value_out = value;
+            return in;
+        }
+    }
+
+    return NULL;
+}
+
+static inline uint32_t read_u32_le(const uint8_t *const in) {
+    return (uint32_t)in[0]
+        | (uint32_t)in[1] << 8
+        | (uint32_t)in[2] << 16
+        | (uint32_t)in[3] << 24;
+}
+
+/******* PUBLIC FUNCTIONS *******/
+
+uint32_t
+printf_tokenize_to_buffer(uint8_t *const buffer,
+                          const uint32_t size,
+                          const uint32_t token,
+                          const uint32_t arg_types,
+                          ...)
+{
+    va_list list;
+    va_start(list, arg_types);
+
+    const uint32_t result =
+        printf_vtokenize_to_buffer(buffer, size, token, arg_types, list);
+
+    va_end(list);
+    return result;
+}
+
+uint32_t
+printf_vtokenize_to_buffer(uint8_t *const buffer,
+                           const uint32_t size,
+                           const uint32_t token,
+                           const uint32_t arg_types,
+                           va_list list)
+{
+    if (size < 4) {
+        return 0;
+    }
+
+    buffer[0] = (uint8_t)token;
+    buffer[1] = (uint8_t)(token >> 8);
+    buffer[2] = (uint8_t)(token >> 16);
+    buffer[3] = (uint8_t)(token >> 24);
+
+    const uint8_t *const end = buffer + size;
+    uint8_t *out = buffer + 4;
+
+    const uint32_t count = arg_types & 0xf;
+    for (uint32_t i = 0; i != count; i++) {
+        const uint32_t type = (arg_types >> (4 + 2 * i)) & 0x3;
+
+        switch ((enum printf_token_arg_type)type) {
+            case PRINTF_TOKEN_ARG_INT:
+                out = write_varint(out, end, zigzag_encode(va_arg(list, int)));
+                break;
+            case PRINTF_TOKEN_ARG_INT64:
+                out = write_varint(out,
+                                   end,
+                                   zigzag_encode(va_arg(list, long long)));
+                break;
+            case PRINTF_TOKEN_ARG_STRING: {
+                const char *string = va_arg(list, const char *);
+                if (string == NULL) {
+                    string = "(null)";
+                }
+
+                const uint32_t length = (uint32_t)strlen(string);
+
+                out = write_varint(out, end, length);
+                if (out == NULL || (uint32_t)(end - out) < length) {
+                    return 0;
+                }
+
+                memcpy(out, string, length);
+                out += length;
+
+                break;
+            }
+        }
+
+        if (out == NULL) {
+            return 0;
+        }
+    }
+
+    return (uint32_t)(out - buffer);
+}
+
+uint32_t printf_token_hash(const char *const format, const uint32_t length) {
+    uint32_t hash = length;
+    uint32_t coefficient = PRINTF_TOKEN_P1;
+
+    const uint32_t hashed_length =
+        length < PRINTF_TOKEN_HASH_LENGTH ? length : PRINTF_TOKEN_HASH_LENGTH;
+
+    for (uint32_t i = 0; i != hashed_length; i++) {
+        hash += coefficient * (uint8_t)format[i];
+        coefficient *= PRINTF_TOKEN_P1;
+    }
+
+    return hash;
+}
+
+const char *
+printf_token_lookup(const struct printf_token_entry *const database,
+                    const uint32_t database_length,
+                    const uint32_t token)
+{
+    for (uint32_t i = 0; i != database_length; i++) {
+        if (database[i].token == token) {
+            return database[i].format;
+        }
+    }
+
+    return NULL;
+}
+
+int64_t
+printf_detokenize(const printf_write_char_callback_t write_char_cb,
+                  void *const char_cb_info,
+                  const printf_write_string_callback_t write_string_cb,
+                  void *const string_cb_info,
+                  const struct printf_token_entry *const database,
+                  const uint32_t database_length,
+                  const uint8_t *const record,
+                  const uint32_t record_length)
+{
+    if (record_length < 4 || record_length > PRINTF_TOKEN_MAX_RECORD_SIZE) {
+        return -1;
+    }
+
+    const char *const format =
+        printf_token_lookup(database, database_length, read_u32_le(record));
+
+    if (format == NULL) {
+        return -1;
+    }
+
+    struct printf_arg_table table;
+    if (!printf_arg_table_scan(&table, format)) {
+        return -1;
+    }
+
+    // Strings are copied out of the record, to terminate them.
+    char strings[PRINTF_TOKEN_MAX_RECORD_SIZE];
+    uint32_t strings_used = 0;
+
+    uint64_t args[PRINTF_MAX_POSITIONAL_ARGS];
+
+    const uint8_t *const end = record + record_length;
+    const uint8_t *in = record + 4;
+
+    for (uint8_t i = 0; i != table.count; i++) {
+        uint64_t value = 0;
+
+        in = read_varint(in, end, &value);
+        if (in == NULL) {
+            return -1;
+        }
+
+        switch ((enum printf_arg_type)table.types[i]) {
+            case PRINTF_ARG_TYPE_STRING:
+                if (value > (uint64_t)(end - in)) {
+                    return -1;
+                }
+
+                memcpy(strings + strings_used, in, value);
+                args[i] = (uint64_t)(uintptr_t)(strings + strings_used);
+
+                strings_used += (uint32_t)value + 1;
+                strings[strings_used - 1] = '\0';
+
+                in += value;
+                break;
+            case PRINTF_ARG_TYPE_WRITE_BACK:
+                // There's nothing to write the count back to.
+                return -1;
+            default:
+                args[i] = (uint64_t)zigzag_decode(value);
+                break;
+        }
+    }
+
+    if (in != end) {
+        return -1;
+    }
+
+    return parse_printf_format_with_args(write_char_cb,
+                                         char_cb_info,
+                                         write_string_cb,
+                                         string_cb_info,
+                                         format,
+                                         args);
+}
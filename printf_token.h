@@ -0,0 +1,217 @@
+/*
+Copyright (c) 2023 Suhas Pai
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "parse_printf.h"
+
+/*
+ * Tokenized logging: instead of formatting on the device, send a 32-bit token
+ * identifying the format string, followed by the arguments, and format on the
+ * host.
+ *
+ * The token is a hash of the format string that PRINTF_TOKEN() computes at
+ * compile time, so when optimizing, format strings used only through
+ * PRINTF_TOKEN() or PRINTF_TOKENIZE_TO_BUFFER() don't end up in the binary.
+ * The printf_tokenize tool extracts the format strings from the sources into a
+ * database for the host, and printf_detokenize() renders records back to text
+ * through parse_printf_format_with_args().
+ *
+ * A record is the token as 4 little-endian bytes, followed by each argument:
+ * integers as zigzag-encoded varints, and strings as a varint length and the
+ * bytes. Floating-point arguments aren't supported, like in the formatter.
+ */
+
+#define PRINTF_TOKEN_MAX_ARGS 14
+#define PRINTF_TOKEN_MAX_RECORD_SIZE 256
+
+/*
+ * Only the first PRINTF_TOKEN_HASH_LENGTH characters, and the total length,
+ * are hashed.
+ */
+
+#define PRINTF_TOKEN_HASH_LENGTH 128
+
+/*
+ * The token is length + sum(format[i] * 65599^(i + 1)), modulo 2^32. The
+ * macros below sum blocks of characters, with the block hashes combined as
+ * H(i, 2n) = H(i, n) + 65599^n * H(i + n, n).
+ */
+
+#define PRINTF_TOKEN_P1 65599u
+#define PRINTF_TOKEN_P2 ((uint32_t)PRINTF_TOKEN_P1 * PRINTF_TOKEN_P1)
+#define PRINTF_TOKEN_P4 ((uint32_t)PRINTF_TOKEN_P2 * PRINTF_TOKEN_P2)
+#define PRINTF_TOKEN_P8 ((uint32_t)PRINTF_TOKEN_P4 * PRINTF_TOKEN_P4)
+#define PRINTF_TOKEN_P16 ((uint32_t)PRINTF_TOKEN_P8 * PRINTF_TOKEN_P8)
+#define PRINTF_TOKEN_P32 ((uint32_t)PRINTF_TOKEN_P16 * PRINTF_TOKEN_P16)
+#define PRINTF_TOKEN_P64 ((uint32_t)PRINTF_TOKEN_P32 * PRINTF_TOKEN_P32)
+
+#define PRINTF_TOKEN_CHAR(s, i) \
+    ((i) < sizeof(s) - 1 ? \
+        (uint32_t)(uint8_t)(s)[(i) < sizeof(s) ? (i) : 0] : 0u)
+
+#define PRINTF_TOKEN_H2(s, i) \
+    (PRINTF_TOKEN_CHAR(s, i) + PRINTF_TOKEN_P1 * PRINTF_TOKEN_CHAR(s, (i) + 1))
+#define PRINTF_TOKEN_H4(s, i) \
+    (PRINTF_TOKEN_H2(s, i) + PRINTF_TOKEN_P2 * PRINTF_TOKEN_H2(s, (i) + 2))
+#define PRINTF_TOKEN_H8(s, i) \
+    (PRINTF_TOKEN_H4(s, i) + PRINTF_TOKEN_P4 * PRINTF_TOKEN_H4(s, (i) + 4))
+#define PRINTF_TOKEN_H16(s, i) \
+    (PRINTF_TOKEN_H8(s, i) + PRINTF_TOKEN_P8 * PRINTF_TOKEN_H8(s, (i) + 8))
+#define PRINTF_TOKEN_H32(s, i) \
+    (PRINTF_TOKEN_H16(s, i) + PRINTF_TOKEN_P16 * PRINTF_TOKEN_H16(s, (i) + 16))
+#define PRINTF_TOKEN_H64(s, i) \
+    (PRINTF_TOKEN_H32(s, i) + PRINTF_TOKEN_P32 * PRINTF_TOKEN_H32(s, (i) + 32))
+#define PRINTF_TOKEN_H128(s, i) \
+    (PRINTF_TOKEN_H64(s, i) + PRINTF_TOKEN_P64 * PRINTF_TOKEN_H64(s, (i) + 64))
+
+// format must be a string literal.
+#define PRINTF_TOKEN(format) \
+    ((uint32_t)(sizeof(format) - 1) + \
+        PRINTF_TOKEN_P1 * (uint32_t)PRINTF_TOKEN_H128(format, 0))
+
+/*
+ * The argument types of a record are packed into 32 bits: the argument count
+ * in the low 4 bits, then 2 bits per argument.
+ */
+
+enum printf_token_arg_type {
+    PRINTF_TOKEN_ARG_INT,
+    PRINTF_TOKEN_ARG_INT64,
+    PRINTF_TOKEN_ARG_STRING,
+};
+
+#define PRINTF_TOKEN_ARG_TYPE(arg) \
+    _Generic((arg), \
+        char *: PRINTF_TOKEN_ARG_STRING, \
+        const char *: PRINTF_TOKEN_ARG_STRING, \
+        default: (sizeof(arg) <= sizeof(int) ? \
+                    PRINTF_TOKEN_ARG_INT : PRINTF_TOKEN_ARG_INT64))
+
+#define PRINTF_TOKEN_COUNT_ARGS(...) \
+    PRINTF_TOKEN_COUNT_ARGS_(_, ##__VA_ARGS__, \
+                             14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define PRINTF_TOKEN_COUNT_ARGS_(_, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, \
+                                 a11, a12, a13, a14, count, ...) count
+
+#define PRINTF_TOKEN_CONCAT(a, b) PRINTF_TOKEN_CONCAT_(a, b)
+#define PRINTF_TOKEN_CONCAT_(a, b) a##b
+
+#define PRINTF_TOKEN_TYPES_0() 0u
+#define PRINTF_TOKEN_TYPES_1(a) ((uint32_t)PRINTF_TOKEN_ARG_TYPE(a))
+#define PRINTF_TOKEN_TYPES_2(a, ...) \
+    (PRINTF_TOKEN_TYPES_1(a) | PRINTF_TOKEN_TYPES_1(__VA_ARGS__) << 2)
+#define PRINTF_TOKEN_TYPES_3(a, ...) \
+    (PRINTF_TOKEN_TYPES_1(a) | PRINTF_TOKEN_TYPES_2(__VA_ARGS__) << 2)
+#define PRINTF_TOKEN_TYPES_4(a, ...) \
+    (PRINTF_TOKEN_TYPES_1(a) | PRINTF_TOKEN_TYPES_3(__VA_ARGS__) << 2)
+#define PRINTF_TOKEN_TYPES_5(a, ...) \
+    (PRINTF_TOKEN_TYPES_1(a) | PRINTF_TOKEN_TYPES_4(__VA_ARGS__) << 2)
+#define PRINTF_TOKEN_TYPES_6(a, ...) \
+    (PRINTF_TOKEN_TYPES_1(a) | PRINTF_TOKEN_TYPES_5(__VA_ARGS__) << 2)
+#define PRINTF_TOKEN_TYPES_7(a, ...) \
+    (PRINTF_TOKEN_TYPES_1(a) | PRINTF_TOKEN_TYPES_6(__VA_ARGS__) << 2)
+#define PRINTF_TOKEN_TYPES_8(a, ...) \
+    (PRINTF_TOKEN_TYPES_1(a) | PRINTF_TOKEN_TYPES_7(__VA_ARGS__) << 2)
+#define PRINTF_TOKEN_TYPES_9(a, ...) \
+    (PRINTF_TOKEN_TYPES_1(a) | PRINTF_TOKEN_TYPES_8(__VA_ARGS__) << 2)
+#define PRINTF_TOKEN_TYPES_10(a, ...) \
+    (PRINTF_TOKEN_TYPES_1(a) | PRINTF_TOKEN_TYPES_9(__VA_ARGS__) << 2)
+#define PRINTF_TOKEN_TYPES_11(a, ...) \
+    (PRINTF_TOKEN_TYPES_1(a) | PRINTF_TOKEN_TYPES_10(__VA_ARGS__) << 2)
+#define PRINTF_TOKEN_TYPES_12(a, ...) \
+    (PRINTF_TOKEN_TYPES_1(a) | PRINTF_TOKEN_TYPES_11(__VA_ARGS__) << 2)
+#define PRINTF_TOKEN_TYPES_13(a, ...) \
+    (PRINTF_TOKEN_TYPES_1(a) | PRINTF_TOKEN_TYPES_12(__VA_ARGS__) << 2)
+#define PRINTF_TOKEN_TYPES_14(a, ...) \
+    (PRINTF_TOKEN_TYPES_1(a) | PRINTF_TOKEN_TYPES_13(__VA_ARGS__) << 2)
+
+#define PRINTF_TOKEN_ARG_TYPES(...) \
+    ((uint32_t)PRINTF_TOKEN_COUNT_ARGS(__VA_ARGS__) | \
+        PRINTF_TOKEN_CONCAT(PRINTF_TOKEN_TYPES_, \
+                            PRINTF_TOKEN_COUNT_ARGS(__VA_ARGS__))(__VA_ARGS__) \
+            << 4)
+
+/*
+ * Encode a record for format and its arguments into buffer. Returns the length
+ * of the record, or 0 if it doesn't fit.
+ */
+
+#define PRINTF_TOKENIZE_TO_BUFFER(buffer, size, format, ...) \
+    printf_tokenize_to_buffer(buffer, \
+                              size, \
+                              PRINTF_TOKEN(format), \
+                              PRINTF_TOKEN_ARG_TYPES(__VA_ARGS__), \
+                              ##__VA_ARGS__)
+
+uint32_t
+printf_tokenize_to_buffer(uint8_t *buffer,
+                          uint32_t size,
+                          uint32_t token,
+                          uint32_t arg_types,
+                          ...);
+
+uint32_t
+printf_vtokenize_to_buffer(uint8_t *buffer,
+                           uint32_t size,
+                           uint32_t token,
+                           uint32_t arg_types,
+                           va_list list);
+
+// The same hash as PRINTF_TOKEN(), at runtime.
+uint32_t printf_token_hash(const char *format, uint32_t length);
+
+/*
+ * Host side.
+ *
+ * The database is an array of entries, as generated by printf_tokenize.
+ */
+
+struct printf_token_entry {
+    uint32_t token;
+    const char *format;
+};
+
+const char *
+printf_token_lookup(const struct printf_token_entry *database,
+                    uint32_t database_length,
+                    uint32_t token);
+
+/*
+ * Render a record through the callbacks. Returns the formatted length, or -1
+ * if the token is unknown or the record doesn't match its format.
+ */
+
+int64_t
+printf_detokenize(printf_write_char_callback_t write_char_cb,
+                  void *char_cb_info,
+                  printf_write_string_callback_t write_string_cb,
+                  void *string_cb_info,
+                  const struct printf_token_entry *database,
+                  uint32_t database_length,
+                  const uint8_t *record,
+                  uint32_t record_length);
@@ -0,0 +1,129 @@
+/*
+ * Extracts the format strings passed to PRINTF_TOKEN() and
+ * PRINTF_TOKENIZE_TO_BUFFER() from C sources, and writes a token database to
+ * stdout as a C source file, for linking into the host-side detokenizer.
+ *
+ * Usage: printf_tokenize file.c [file.c ...] > tokens.c
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "printf_source.h"
+#include "printf_token.h"
+
+static const struct printf_source_call tokenize_macros[] = {
+    { "PRINTF_TOKEN", 0 },
+    { "PRINTF_TOKENIZE_TO_BUFFER", 2 },
+};
+
+struct format_entry {
+    uint32_t token;
+    char *format;
+    uint32_t length;
+};
+
+static struct format_entry *entries;
+static uint32_t entries_used;
+static uint32_t entries_capacity;
+
+static bool
+add_format(void *const info, char *const format, const uint32_t length) {
+    (void)info;
+
+    const uint32_t token = printf_token_hash(format, length);
+
+    for (uint32_t i = 0; i != entries_used; i++) {
+        if (entries[i].token != token) {
+            continue;
+        }
+
+        if (entries[i].length == length
+            && memcmp(entries[i].format, format, length) == 0)
+        {
+            free(format);
+            return true;
+        }
+
+        fprintf(stderr,
+                "printf_tokenize: token %08x is shared by two formats\n",
+                token);
+        return false;
+    }
+
+    if (entries_used == entries_capacity) {
+        entries_capacity = entries_capacity != 0 ? entries_capacity * 2 : 64;
+        entries = realloc(entries, entries_capacity * sizeof(*entries));
+
+        if (entries == NULL) {
+            return false;
+        }
+    }
+
+    entries[entries_used++] = (struct format_entry){
+        .token = token,
+        .format = format,
+        .length = length
+    };
+
+    return true;
+}
+
+static int compare_entries(const void *const lhs, const void *const rhs) {
+    const uint32_t lhs_token = ((const struct format_entry *)lhs)->token;
+    const uint32_t rhs_token = ((const struct format_entry *)rhs)->token;
+
+    return (lhs_token > rhs_token) - (lhs_token < rhs_token);
+}
+
+int main(const int argc, const char *const argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s file.c [file.c ...] > tokens.c\n", argv[0]);
+        return 1;
+    }
+
+    for (int i = 1; i != argc; i++) {
+        size_t length = 0;
+        char *const source = printf_source_read_file(argv[i], &length);
+
+        if (source == NULL) {
+            fprintf(stderr, "printf_tokenize: failed to read %s\n", argv[i]);
+            return 1;
+        }
+
+        const bool scanned =
+            printf_source_scan(source,
+                               tokenize_macros,
+                               sizeof(tokenize_macros)
+                                   / sizeof(*tokenize_macros),
+                               add_format,
+                               /*info=*/NULL);
+
+        if (!scanned) {
+            fprintf(stderr, "printf_tokenize: failed on %s\n", argv[i]);
+            return 1;
+        }
+
+        free(source);
+    }
+
+    qsort(entries, entries_used, sizeof(*entries), compare_entries);
+
+    printf("// Generated by printf_tokenize. Do not edit.\n\n");
+    printf("#include \"printf_token.h\"\n\n");
+    printf("const struct printf_token_entry printf_token_database[] = {\n");
+
+    for (uint32_t i = 0; i != entries_used; i++) {
+        printf("    { 0x%08xu, ", entries[i].token);
+        printf_source_write_c_string(entries[i].format, entries[i].length);
+        printf(" },\n");
+    }
+
+    printf("};\n\n");
+    printf("const uint32_t printf_token_database_length = %u;\n", entries_used);
+
+    return 0;
+}
@@ -0,0 +1,244 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ring_sink.h"
+
+_Static_assert(sizeof(struct ring_sink_slot) == RING_SINK_SLOT_SIZE,
+               "ring_sink slots must be exactly RING_SINK_SLOT_SIZE bytes");
+
+/******* PRIVATE FUNCTIONS *******/
+
+static inline uint64_t writing_sequence(const uint64_t ticket) {
+    return ticket * 2 + 1;
+}
+
+static inline uint64_t complete_sequence(const uint64_t ticket) {
+    return ticket * 2 + 2;
+}
+
+// Only uses write(2), so this is async-signal-safe.
+static bool
+write_all(const int fd, const char *data, uint32_t length) {
+    while (length != 0) {
+        const ssize_t result = write(fd, data, length);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return false;
+        }
+
+        data += result;
+        length -= (uint32_t)result;
+    }
+
+    return true;
+}
+
+/******* PUBLIC FUNCTIONS *******/
+
+bool
+ring_sink_init(struct ring_sink *const sink,
+               void *const memory,
+               const uint64_t size)
+{
+    uint64_t slot_count = size / RING_SINK_SLOT_SIZE;
+    if (slot_count == 0) {
+        return false;
+    }
+
+    // Round down to a power of two, so a ticket maps to a slot with a mask.
+    while ((slot_count & (slot_count - 1)) != 0) {
+        slot_count &= slot_count - 1;
+    }
+
+    sink->slots = (struct ring_sink_slot *)memory;
+    sink->slot_mask = slot_count - 1;
+    sink->head = 0;
+    sink->dropped = 0;
+
+    for (uint64_t i = 0; i != slot_count; i++) {
+        sink->slots[i].sequence = 0;
+        sink->slots[i].length = 0;
+    }
+
+    return true;
+}
+
+void
+ring_sink_begin(struct ring_sink *const sink,
+                struct ring_sink_writer *const writer)
+{
+    const uint64_t ticket =
+        __atomic_fetch_add(&sink->head, 1, __ATOMIC_RELAXED);
+
+    struct ring_sink_slot *const slot = &sink->slots[ticket & sink->slot_mask];
+    const uint64_t sequence = writing_sequence(ticket);
+
+    writer->slot = NULL;
+    writer->ticket = ticket;
+    writer->used = 0;
+
+    /*
+     * Only take the slot if it's not being written, and doesn't already hold a
+     * newer message (which happens if this thread was preempted long enough for
+     * the ring to wrap around).
+     */
+
+    uint64_t expected = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+
+    // The exchange acquires, so the previous writer of the slot is done.
+    do {
+        if ((expected & 1) != 0 || expected > sequence) {
+            __atomic_fetch_add(&sink->dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&slot->sequence,
+                                          &expected,
+                                          sequence,
+                                          /*weak=*/true,
+                                          __ATOMIC_ACQUIRE,
+                                          __ATOMIC_RELAXED));
+
+    // Make sure readers see the odd sequence before any of the new text.
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    writer->slot = slot;
+}
+
+void ring_sink_end(struct ring_sink_writer *const writer) {
+    struct ring_sink_slot *const slot = writer->slot;
+    if (slot == NULL) {
+        return;
+    }
+
+    slot->length = writer->used;
+    __atomic_store_n(&slot->sequence,
+                     complete_sequence(writer->ticket),
+                     __ATOMIC_RELEASE);
+
+    writer->slot = NULL;
+}
+
+bool ring_sink_dump(const struct ring_sink *const sink, const int fd) {
+    const uint64_t head = __atomic_load_n(&sink->head, __ATOMIC_ACQUIRE);
+    const uint64_t slot_count = sink->slot_mask + 1;
+
+    uint64_t ticket = head > slot_count ? head - slot_count : 0;
+    for (; ticket != head; ticket++) {
+        const struct ring_sink_slot *const slot =
+            &sink->slots[ticket & sink->slot_mask];
+
+        const uint64_t sequence = complete_sequence(ticket);
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != sequence) {
+            continue;
+        }
+
+        // Copy the text out, then check the slot wasn't reused meanwhile.
+        char text[RING_SINK_TEXT_SIZE];
+        uint32_t length = slot->length;
+
+        if (length > RING_SINK_TEXT_SIZE) {
+            length = RING_SINK_TEXT_SIZE;
+        }
+
+        memcpy(text, slot->text, length);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) != sequence) {
+            continue;
+        }
+
+        if (!write_all(fd, text, length)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint32_t
+ring_sink_write_ch_callback(struct printf_spec_info *const spec_info,
+                            void *const info,
+                            const char ch,
+                            const uint32_t times,
+                            bool *const should_continue_out)
+{
+    (void)spec_info;
+
+    struct ring_sink_writer *const writer = (struct ring_sink_writer *)info;
+    if (writer->slot == NULL) {
+        *should_continue_out = false;
+        return 0;
+    }
+
+    uint32_t amount = times;
+    if (amount >= RING_SINK_TEXT_SIZE - writer->used) {
+        amount = RING_SINK_TEXT_SIZE - writer->used;
+        *should_continue_out = false;
+    }
+
+    memset(writer->slot->text + writer->used, ch, amount);
+    writer->used += amount;
+
+    return amount;
+}
+
+uint32_t
+ring_sink_write_string_callback(struct printf_spec_info *const spec_info,
+                                void *const info,
+                                const char *const string,
+                                const uint32_t length,
+                                bool *const should_continue_out)
+{
+    (void)spec_info;
+
+    struct ring_sink_writer *const writer = (struct ring_sink_writer *)info;
+    if (writer->slot == NULL) {
+        *should_continue_out = false;
+        return 0;
+    }
+
+    uint32_t amount = length;
+    if (amount >= RING_SINK_TEXT_SIZE - writer->used) {
+        amount = RING_SINK_TEXT_SIZE - writer->used;
+        *should_continue_out = false;
+    }
+
+    memcpy(writer->slot->text + writer->used, string, amount);
+    writer->used += amount;
+
+    return amount;
+}
+
+uint32_t
+ring_sink_format(struct ring_sink *const sink, const char *const format, ...) {
+    va_list list;
+    va_start(list, format);
+
+    const uint32_t result = ring_sink_vformat(sink, format, list);
+
+    va_end(list);
+    return result;
+}
+
+uint32_t
+ring_sink_vformat(struct ring_sink *const sink,
+                  const char *const format,
+                  va_list list)
+{
+    struct ring_sink_writer writer;
+    ring_sink_begin(sink, &writer);
+
+    const uint32_t length =
+        parse_printf_format(ring_sink_write_ch_callback,
+                            &writer,
+                            ring_sink_write_string_callback,
+                            &writer,
+                            format,
+                            list);
+
+    ring_sink_end(&writer);
+    return length;
+}
@@ -0,0 +1,116 @@
+/*
+Copyright (c) 2023 Suhas Pai
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "parse_printf.h"
+
+/*
+ * A flight-recorder sink: an in-memory ring that always holds the most recent
+ * messages, overwriting the oldest ones, for dumping after a crash.
+ *
+ * The ring is split into fixed-size slots, one message per slot. Writers claim
+ * a slot with an atomic increment of the head, and stamp it with a sequence
+ * number that's odd while the message is being written, and even once it's
+ * complete, so many threads can write without taking a lock. Messages longer
+ * than RING_SINK_TEXT_SIZE are truncated.
+ *
+ * ring_sink_dump() only uses atomic loads and write(2), so it's safe to call
+ * from a signal handler.
+ */
+
+#define RING_SINK_SLOT_SIZE 128
+#define RING_SINK_TEXT_SIZE (RING_SINK_SLOT_SIZE - 12)
+
+struct ring_sink_slot {
+    // 2 * ticket + 1 while being written, 2 * ticket + 2 once complete.
+    uint64_t sequence;
+    uint32_t length;
+    char text[RING_SINK_TEXT_SIZE];
+};
+
+struct ring_sink {
+    struct ring_sink_slot *slots;
+    uint64_t slot_mask;
+
+    // Ticket of the next message.
+    uint64_t head;
+
+    // Messages dropped because their slot was still being written by a
+    // writer that was lapped by the whole ring.
+    uint64_t dropped;
+};
+
+// A message in progress, used as the info for the callbacks.
+struct ring_sink_writer {
+    struct ring_sink_slot *slot;
+    uint64_t ticket;
+    uint32_t used;
+};
+
+/*
+ * memory must be 8-byte aligned. The number of slots is size /
+ * RING_SINK_SLOT_SIZE, rounded down to a power of two. Returns false if memory
+ * is too small for a single slot.
+ */
+
+bool ring_sink_init(struct ring_sink *sink, void *memory, uint64_t size);
+
+/*
+ * Claim a slot for a new message. Pass the writer to the callbacks as their
+ * info, then call ring_sink_end() to publish the message.
+ */
+
+void ring_sink_begin(struct ring_sink *sink, struct ring_sink_writer *writer);
+void ring_sink_end(struct ring_sink_writer *writer);
+
+/*
+ * Write every complete message still in the ring to fd, oldest first.
+ * Messages being written concurrently are skipped.
+ */
+
+bool ring_sink_dump(const struct ring_sink *sink, int fd);
+
+uint32_t
+ring_sink_write_ch_callback(struct printf_spec_info *spec_info,
+                            void *info,
+                            char ch,
+                            uint32_t times,
+                            bool *should_continue_out);
+
+uint32_t
+ring_sink_write_string_callback(struct printf_spec_info *spec_info,
+                                void *info,
+                                const char *string,
+                                uint32_t length,
+                                bool *should_continue_out);
+
+__attribute__((format(printf, 2, 3)))
+uint32_t ring_sink_format(struct ring_sink *sink, const char *format, ...);
+
+uint32_t
+ring_sink_vformat(struct ring_sink *sink, const char *format, va_list list);
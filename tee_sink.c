@@ -0,0 +1,152 @@
+#include "tee_sink.h"
+
+void tee_sink_init(struct tee_sink *const sink) {
+    sink->count = 0;
+    sink->active_count = 0;
+}
+
+bool
+tee_sink_add(struct tee_sink *const sink,
+             const printf_write_char_callback_t write_char_cb,
+             void *const char_cb_info,
+             const printf_write_string_callback_t write_string_cb,
+             void *const string_cb_info)
+{
+    if (sink->count == TEE_SINK_MAX_DESTINATIONS) {
+        return false;
+    }
+
+    sink->destinations[sink->count] = (struct tee_sink_destination){
+        .write_char_cb = write_char_cb,
+        .char_cb_info = char_cb_info,
+        .write_string_cb = write_string_cb,
+        .string_cb_info = string_cb_info,
+        .active = true
+    };
+
+    sink->count++;
+    sink->active_count++;
+
+    return true;
+}
+
+void tee_sink_reset(struct tee_sink *const sink) {
+    for (uint32_t i = 0; i != sink->count; i++) {
+        sink->destinations[i].active = true;
+    }
+
+    sink->active_count = sink->count;
+}
+
+uint32_t
+tee_sink_write_ch_callback(struct printf_spec_info *const spec_info,
+                           void *const info,
+                           const char ch,
+                           const uint32_t times,
+                           bool *const should_continue_out)
+{
+    struct tee_sink *const sink = (struct tee_sink *)info;
+    uint32_t most_written = 0;
+
+    for (uint32_t i = 0; i != sink->count; i++) {
+        struct tee_sink_destination *const dest = &sink->destinations[i];
+        if (!dest->active) {
+            continue;
+        }
+
+        bool should_continue = true;
+        const uint32_t written =
+            dest->write_char_cb(spec_info,
+                                dest->char_cb_info,
+                                ch,
+                                times,
+                                &should_continue);
+
+        if (written > most_written) {
+            most_written = written;
+        }
+
+        if (!should_continue) {
+            dest->active = false;
+            sink->active_count--;
+        }
+    }
+
+    if (sink->active_count == 0) {
+        *should_continue_out = false;
+    }
+
+    return most_written;
+}
+
+uint32_t
+tee_sink_write_string_callback(struct printf_spec_info *const spec_info,
+                               void *const info,
+                               const char *const string,
+                               const uint32_t length,
+                               bool *const should_continue_out)
+{
+    struct tee_sink *const sink = (struct tee_sink *)info;
+    uint32_t most_written = 0;
+
+    for (uint32_t i = 0; i != sink->count; i++) {
+        struct tee_sink_destination *const dest = &sink->destinations[i];
+        if (!dest->active) {
+            continue;
+        }
+
+        bool should_continue = true;
+        const uint32_t written =
+            dest->write_string_cb(spec_info,
+                                  dest->string_cb_info,
+                                  string,
+                                  length,
+                                  &should_continue);
+
+        if (written > most_written) {
+            most_written = written;
+        }
+
+        if (!should_continue) {
+            dest->active = false;
+            sink->active_count--;
+        }
+    }
+
+    if (sink->active_count == 0) {
+        *should_continue_out = false;
+    }
+
+    return most_written;
+}
+
+uint32_t
+tee_sink_format(struct tee_sink *const sink, const char *const format, ...) {
+    va_list list;
+    va_start(list, format);
+
+    const uint32_t result = tee_sink_vformat(sink, format, list);
+
+    va_end(list);
+    return result;
+}
+
+uint32_t
+tee_sink_vformat(struct tee_sink *const sink,
+                 const char *const format,
+                 va_list list)
+{
+    tee_sink_reset(sink);
+    if (sink->count == 0) {
+        return 0;
+    }
+
+    const uint32_t length =
+        parse_printf_format(tee_sink_write_ch_callback,
+                            sink,
+                            tee_sink_write_string_callback,
+                            sink,
+                            format,
+                            list);
+    return length;
+}
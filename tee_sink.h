@@ -0,0 +1,104 @@
+/*
+Copyright (c) 2023 Suhas Pai
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "parse_printf.h"
+
+/*
+ * A sink that forwards every fragment to several downstream sinks, so the
+ * arguments are converted only once.
+ *
+ * Each destination keeps its own should_continue state. A destination that
+ * declines more output (e.g. a full fixed-size buffer) is skipped for the rest
+ * of the message, and formatting only stops once every destination has
+ * declined.
+ */
+
+#define TEE_SINK_MAX_DESTINATIONS 8
+
+struct tee_sink_destination {
+    printf_write_char_callback_t write_char_cb;
+    void *char_cb_info;
+    printf_write_string_callback_t write_string_cb;
+    void *string_cb_info;
+
+    bool active;
+};
+
+struct tee_sink {
+    struct tee_sink_destination destinations[TEE_SINK_MAX_DESTINATIONS];
+    uint32_t count;
+    uint32_t active_count;
+};
+
+void tee_sink_init(struct tee_sink *sink);
+
+/*
+ * Returns false if the sink already has TEE_SINK_MAX_DESTINATIONS
+ * destinations.
+ */
+
+bool
+tee_sink_add(struct tee_sink *sink,
+             printf_write_char_callback_t write_char_cb,
+             void *char_cb_info,
+             printf_write_string_callback_t write_string_cb,
+             void *string_cb_info);
+
+/*
+ * Re-enable every destination. tee_sink_format() does this before each
+ * message; call it yourself before a message when passing the callbacks to
+ * parse_printf_format() directly.
+ */
+
+void tee_sink_reset(struct tee_sink *sink);
+
+/*
+ * The callbacks return the most any destination accepted, so a message is
+ * only reported as truncated if every destination truncated it.
+ */
+
+uint32_t
+tee_sink_write_ch_callback(struct printf_spec_info *spec_info,
+                           void *info,
+                           char ch,
+                           uint32_t times,
+                           bool *should_continue_out);
+
+uint32_t
+tee_sink_write_string_callback(struct printf_spec_info *spec_info,
+                               void *info,
+                               const char *string,
+                               uint32_t length,
+                               bool *should_continue_out);
+
+__attribute__((format(printf, 2, 3)))
+uint32_t tee_sink_format(struct tee_sink *sink, const char *format, ...);
+
+uint32_t
+tee_sink_vformat(struct tee_sink *sink, const char *format, va_list list);
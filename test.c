@@ -1,10 +1,35 @@
 #include <assert.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
+#include "dedup_sink.h"
 #include "example.h"
+#include "fd_sink.h"
+#include "lz4_sink.h"
+#include "mmap_sink.h"
+#include "parse_printf.h"
+#include "parse_scanf.h"
+#include "ring_sink.h"
+#include "pingpong_sink.h"
+// The tests above call the engine directly; compiled tables are tested below.
+#define PRINTF_COMPILED_NO_ROUTING
+#include "printf_compiled.h"
+#include "printf_string.h"
+#include "printf_table.h"
+#include "printf_token.h"
+#include "tee_sink.h"
+#include "uring_sink.h"
 
 #define check_strings(buffer, expected)                                        \
     do {                                                                       \
@@ -45,6 +70,290 @@
         memset(buffer, '\0', sizeof(buffer));                                  \
     } while (false)
 
+// For output that may contain NUL bytes.
+#define test_format_binary(expected, str, ...)                                 \
+    do {                                                                       \
+        const uint32_t length =                                                \
+            format_to_buffer(buffer, sizeof(buffer), str, ##__VA_ARGS__);      \
+                                                                               \
+        assert(length == (sizeof(expected) - 1));                              \
+        assert(memcmp(buffer, expected, length) == 0);                         \
+        memset(buffer, '\0', sizeof(buffer));                                  \
+    } while (false)
+
+/*
+ * A sink that appends into a fixed buffer, used to capture the output of sink
+ * stages. Output past the capacity is dropped, and the sink then declines
+ * more output.
+ */
+
+struct memory_sink {
+    uint8_t *data;
+    uint64_t used;
+    uint64_t capacity;
+};
+
+static uint32_t
+memory_sink_write_ch_callback(struct printf_spec_info *const spec_info,
+                              void *const info,
+                              const char ch,
+                              const uint32_t times,
+                              bool *const should_continue_out)
+{
+    (void)spec_info;
+
+    struct memory_sink *const sink = (struct memory_sink *)info;
+    uint32_t amount = times;
+
+    if (sink->capacity - sink->used < amount) {
+        amount = (uint32_t)(sink->capacity - sink->used);
+        *should_continue_out = false;
+    }
+
+    memset(sink->data + sink->used, ch, amount);
+    sink->used += amount;
+
+    return amount;
+}
+
+static uint32_t
+memory_sink_write_string_callback(struct printf_spec_info *const spec_info,
+                                  void *const info,
+                                  const char *const string,
+                                  const uint32_t length,
+                                  bool *const should_continue_out)
+{
+    (void)spec_info;
+
+    struct memory_sink *const sink = (struct memory_sink *)info;
+    uint32_t amount = length;
+
+    if (sink->capacity - sink->used < amount) {
+        amount = (uint32_t)(sink->capacity - sink->used);
+        *should_continue_out = false;
+    }
+
+    memcpy(sink->data + sink->used, string, amount);
+    sink->used += amount;
+
+    return amount;
+}
+
+// Counts the callbacks made for a conversion.
+struct counting_sink {
+    struct memory_sink memory;
+    uint32_t calls;
+};
+
+static uint32_t
+counting_sink_write_ch_callback(struct printf_spec_info *const spec_info,
+                                void *const info,
+                                const char ch,
+                                const uint32_t times,
+                                bool *const should_continue_out)
+{
+    struct counting_sink *const sink = (struct counting_sink *)info;
+    sink->calls++;
+
+    return memory_sink_write_ch_callback(spec_info,
+                                         &sink->memory,
+                                         ch,
+                                         times,
+                                         should_continue_out);
+}
+
+static uint32_t
+counting_sink_write_string_callback(struct printf_spec_info *const spec_info,
+                                    void *const info,
+                                    const char *const string,
+                                    const uint32_t length,
+                                    bool *const should_continue_out)
+{
+    struct counting_sink *const sink = (struct counting_sink *)info;
+    sink->calls++;
+
+    return memory_sink_write_string_callback(spec_info,
+                                             &sink->memory,
+                                             string,
+                                             length,
+                                             should_continue_out);
+}
+
+static void
+format_to_counting_sink(struct counting_sink *const sink,
+                        const char *const fmt,
+                        ...)
+{
+    va_list list;
+    va_start(list, fmt);
+
+    parse_printf_format(counting_sink_write_ch_callback,
+                        sink,
+                        counting_sink_write_string_callback,
+                        sink,
+                        fmt,
+                        list);
+
+    va_end(list);
+}
+
+static uint64_t
+format_with_context(struct printf_context *const context,
+                    const char *const fmt,
+                    ...)
+{
+    va_list list;
+    va_start(list, fmt);
+
+    const uint64_t result =
+        parse_printf_format_with_context(context, fmt, list);
+
+    va_end(list);
+    return result;
+}
+
+#define test_callback_count(expected, call_count, fmt, ...)                    \
+    do {                                                                       \
+        uint8_t data[64] = {0};                                                \
+        struct counting_sink sink = {                                          \
+            .memory = { .data = data, .capacity = sizeof(data) - 1 },          \
+        };                                                                     \
+                                                                               \
+        format_to_counting_sink(&sink, fmt, ##__VA_ARGS__);                    \
+        assert(strcmp((const char *)data, expected) == 0);                     \
+        assert(sink.calls == (call_count));                                    \
+    } while (false)
+
+// Formats from a table built by printf_compile_format(), and by parsing fmt,
+// and requires the same output.
+#define test_compiled_format(fmt, ...)                                         \
+    do {                                                                       \
+        struct printf_compiled_spec specs[8];                                  \
+        struct printf_compiled_format compiled;                                \
+                                                                               \
+        assert(printf_compile_format(&compiled, specs, 8, fmt));               \
+                                                                               \
+        char compiled_out[64];                                                 \
+        char parsed_out[64];                                                   \
+                                                                               \
+        const uint32_t compiled_length =                                       \
+            format_to_buffer_compiled(compiled_out,                            \
+                                      sizeof(compiled_out),                    \
+                                      &compiled,                               \
+                                      fmt,                                     \
+                                      ##__VA_ARGS__);                          \
+        const uint32_t parsed_length =                                         \
+            format_to_buffer_compiled(parsed_out,                              \
+                                      sizeof(parsed_out),                      \
+                                      /*compiled=*/NULL,                       \
+                                      fmt,                                     \
+                                      ##__VA_ARGS__);                          \
+                                                                               \
+        assert(compiled_length == parsed_length);                              \
+        assert(strcmp(compiled_out, parsed_out) == 0);                         \
+    } while (false)
+
+/*
+ * Stands in for a DMA controller: a thread that "transmits" each half handed
+ * to it into a memory_sink, then signals completion like an interrupt would.
+ */
+
+struct fake_transmitter {
+    struct pingpong_sink *sink;
+    struct memory_sink capture;
+
+    const char *pending;
+    uint32_t pending_length;
+    bool stop;
+};
+
+static void
+fake_transmitter_start(void *const info,
+                       const char *const data,
+                       const uint32_t length)
+{
+    struct fake_transmitter *const transmitter =
+        (struct fake_transmitter *)info;
+
+    assert(__atomic_load_n(&transmitter->pending, __ATOMIC_ACQUIRE) == NULL);
+
+    transmitter->pending_length = length;
+    __atomic_store_n(&transmitter->pending, data, __ATOMIC_RELEASE);
+}
+
+static void *fake_transmitter_thread(void *const info) {
+    struct fake_transmitter *const transmitter =
+        (struct fake_transmitter *)info;
+
+    while (true) {
+        const char *const data =
+            __atomic_load_n(&transmitter->pending, __ATOMIC_ACQUIRE);
+
+        if (data == NULL) {
+            if (__atomic_load_n(&transmitter->stop, __ATOMIC_ACQUIRE)) {
+                return NULL;
+            }
+
+            sched_yield();
+            continue;
+        }
+
+        bool should_continue = true;
+        memory_sink_write_string_callback(NULL,
+                                          &transmitter->capture,
+                                          data,
+                                          transmitter->pending_length,
+                                          &should_continue);
+
+        __atomic_store_n(&transmitter->pending, NULL, __ATOMIC_RELEASE);
+        pingpong_sink_transmit_done(transmitter->sink);
+    }
+}
+
+static void
+test_detokenize(const struct printf_token_entry *const database,
+                const uint32_t database_length,
+                const uint8_t *const record,
+                const uint32_t record_length,
+                const char *const expected)
+{
+    uint8_t rendered_data[128];
+    struct memory_sink rendered = {
+        .data = rendered_data,
+        .used = 0,
+        .capacity = sizeof(rendered_data)
+    };
+
+    const int64_t length =
+        printf_detokenize(memory_sink_write_ch_callback,
+                          &rendered,
+                          memory_sink_write_string_callback,
+                          &rendered,
+                          database,
+                          database_length,
+                          record,
+                          record_length);
+
+    assert(length == (int64_t)strlen(expected));
+    assert(rendered.used == (uint64_t)length);
+    assert(memcmp(rendered_data, expected, rendered.used) == 0);
+}
+
+#define RING_TEST_THREADS 4
+#define RING_TEST_MESSAGES 2000
+
+static void *ring_sink_test_thread(void *const info) {
+    struct ring_sink *const sink = (struct ring_sink *)info;
+    static uint32_t next_id;
+
+    const uint32_t id = __atomic_fetch_add(&next_id, 1, __ATOMIC_RELAXED);
+    for (uint32_t i = 0; i != RING_TEST_MESSAGES; i++) {
+        ring_sink_format(sink, "thread %u message %u\n", id, i);
+    }
+
+    return NULL;
+}
+
 int main(const int argc, const char *const argv[]) {
     (void)argc;
     (void)argv;
@@ -192,6 +501,197 @@ int main(const int argc, const char *const argv[]) {
     test_format_to_buffer(sizeof(buffer), "Hel", "%.*s", 3, "Hello");
     test_format_to_buffer(sizeof(buffer), " Hel", " %.*s", 3, "Hello");
 
+    // Edge cases where we match glibc.
+    test_format_to_buffer(sizeof(buffer), "255 -56", "%hhu %hhd", -1, 200);
+    test_format_to_buffer(sizeof(buffer), "65535 4464", "%hu %hd", -1, 70000);
+    test_format_to_buffer(sizeof(buffer), "0 0 0", "%#x %#o %#.0o", 0, 0, 0);
+    test_format_to_buffer(sizeof(buffer), "00010", "%#.5o", 8);
+    test_format_to_buffer(sizeof(buffer), " 0042", "% 05d", 42);
+    test_format_to_buffer(sizeof(buffer), " 42  ", "%- 5d", 42);
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wformat"
+        test_format_to_buffer(sizeof(buffer), "5", "% u", 5);
+    #pragma GCC diagnostic pop "-Wformat"
+    test_format_to_buffer(sizeof(buffer), "  +", "%+3.0d", 0);
+    test_format_to_buffer(sizeof(buffer), "7   |", "%*d|", -4, 7);
+    test_format_to_buffer(sizeof(buffer), "7", "%.*d", -2, 7);
+    test_format_to_buffer(sizeof(buffer), "0xabc", "%p", (void *)0xabc);
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wformat-overflow"
+        test_format_to_buffer(sizeof(buffer), "|", "%.3s|", (char *)NULL);
+    #pragma GCC diagnostic pop
+
+    test_format_to_buffer(sizeof(buffer), "1000000000", "%u", 1000000000u);
+    test_format_to_buffer(sizeof(buffer), "4294967295", "%u", 4294967295u);
+    test_format_to_buffer(sizeof(buffer),
+                          "4294967296",
+                          "%llu",
+                          4294967296ull);
+    test_format_to_buffer(sizeof(buffer),
+                          "1000000000000000000",
+                          "%llu",
+                          1000000000000000000ull);
+    test_format_to_buffer(sizeof(buffer),
+                          "18446744073709551615",
+                          "%llu",
+                          18446744073709551615ull);
+    test_format_to_buffer(sizeof(buffer),
+                          "-9223372036854775808",
+                          "%lld",
+                          (long long)(-9223372036854775807ll - 1));
+    test_format_to_buffer(sizeof(buffer),
+                          "-1000000000000000001",
+                          "%lld",
+                          -1000000000000000001ll);
+    test_format_to_buffer(sizeof(buffer),
+                          "ffffffffffffffff",
+                          "%llx",
+                          18446744073709551615ull);
+    test_format_to_buffer(sizeof(buffer),
+                          "1777777777777777777777",
+                          "%llo",
+                          18446744073709551615ull);
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat"
+#pragma GCC diagnostic ignored "-Wformat-extra-args"
+    // Fixed-point arguments are the value, then the number of fraction bits.
+    test_format_to_buffer(sizeof(buffer), "1.500000", "%k", 0x18000, 16);
+    test_format_to_buffer(sizeof(buffer), "-1.500000", "%k", -0x18000, 16);
+    test_format_to_buffer(sizeof(buffer), "3.14", "%.2k", 205887, 16);
+    test_format_to_buffer(sizeof(buffer), "0.12", "%.2k", 0x2000, 16);
+    test_format_to_buffer(sizeof(buffer), "0.38", "%.2k", 0x6000, 16);
+    test_format_to_buffer(sizeof(buffer), "2", "%.0k", 0x18000, 16);
+    test_format_to_buffer(sizeof(buffer), "2", "%.0k", 0x28000, 16);
+    test_format_to_buffer(sizeof(buffer), "0", "%.0k", 0, 16);
+    test_format_to_buffer(sizeof(buffer), "1.", "%#.0k", 0x10000, 16);
+    test_format_to_buffer(sizeof(buffer), "10.0", "%.1k", 0x9FFFF, 16);
+    test_format_to_buffer(sizeof(buffer), "-1.000000", "%k", -32768, 15);
+    test_format_to_buffer(sizeof(buffer), "-001.500", "%08.3k", -0x18000, 16);
+    test_format_to_buffer(sizeof(buffer), "+0.000000", "%+k", 0, 16);
+    test_format_to_buffer(sizeof(buffer), " 0.250000", "% k", 1, 2);
+    test_format_to_buffer(sizeof(buffer), "1.2     ", "%-8.1k", 5, 2);
+    test_format_to_buffer(sizeof(buffer), "42.000000", "%k", 42, 0);
+    test_format_to_buffer(sizeof(buffer),
+                          "0.0000152588",
+                          "%.10k",
+                          1,
+                          16);
+    test_format_to_buffer(sizeof(buffer),
+                          "0.06250000000000000000",
+                          "%.20k",
+                          1,
+                          4);
+    test_format_to_buffer(sizeof(buffer), "  0.25000000", "%12.8k", 1, 2);
+    test_format_to_buffer(sizeof(buffer), "000.25000000", "%012.8k", 1, 2);
+    test_format_to_buffer(sizeof(buffer),
+                          "3.500000",
+                          "%llk",
+                          (3ll << 32) + (1ll << 31),
+                          32);
+    test_format_to_buffer(sizeof(buffer), "1.000", "%.3K", 0xFFFFFFFFu, 32);
+    test_format_to_buffer(sizeof(buffer), "65535.5", "%.1K", 0xFFFF8000u, 16);
+
+    // An invalid fraction-bit count stops formatting.
+    test_format_to_buffer_no_count(sizeof(buffer), "[", "[%k]%d", 1, 33, 5);
+    test_format_to_buffer_no_count(sizeof(buffer), "", "%K|%d", 1u, -1, 5);
+
+    // Timestamps are nanoseconds since the epoch.
+    test_format_to_buffer(sizeof(buffer),
+                          "1970-01-01T00:00:00.000000Z",
+                          "%T",
+                          (int64_t)0);
+
+    // A length modifier on %T stops formatting, rather than misreading every
+    // later argument.
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wformat"
+        test_format_to_buffer_no_count(sizeof(buffer),
+                                       "[",
+                                       "[%llT] %s",
+                                       (int64_t)0,
+                                       "x");
+        test_format_to_buffer_no_count(sizeof(buffer), "", "%hT%d", 1, 2);
+    #pragma GCC diagnostic pop
+    test_format_to_buffer(sizeof(buffer),
+                          "2023-11-14T22:13:20.123456789Z",
+                          "%.9T",
+                          (int64_t)1700000000123456789);
+    test_format_to_buffer(sizeof(buffer),
+                          "2023-11-14T22:13:20.123Z",
+                          "%.3T",
+                          (int64_t)1700000000123456789);
+    test_format_to_buffer(sizeof(buffer),
+                          "2023-11-14T22:14:19Z",
+                          "%.0T",
+                          (int64_t)1700000059999999999);
+    test_format_to_buffer(sizeof(buffer),
+                          "2023-11-14T22:14:20Z",
+                          "%.0T",
+                          (int64_t)1700000060000000000);
+    test_format_to_buffer(sizeof(buffer),
+                          "2023-11-14T22:13:59Z",
+                          "%.0T",
+                          (int64_t)1700000039000000000);
+    test_format_to_buffer(sizeof(buffer),
+                          "2000-02-29T00:00:00.5Z",
+                          "%.1T",
+                          (int64_t)951782400500000000);
+    test_format_to_buffer(sizeof(buffer),
+                          "1969-12-31T23:59:59.999999999Z",
+                          "%.9T",
+                          (int64_t)-1);
+    test_format_to_buffer(sizeof(buffer),
+                          "1969-12-31T23:59:00.500Z",
+                          "%.3T",
+                          (int64_t)-59500000000);
+    test_format_to_buffer(sizeof(buffer),
+                          "  1970-01-01T00:00:00Z",
+                          "%22.0T",
+                          (int64_t)0);
+    test_format_to_buffer(sizeof(buffer),
+                          "[1970-01-01T00:00:01Z] x",
+                          "[%.0T] %s",
+                          (int64_t)1000000000,
+                          "x");
+
+    // Binary fields: raw little/big-endian bytes, and LEB128 varints.
+    test_format_binary("\x04\x03\x02\x01", "%r", 0x01020304);
+    test_format_binary("\x01\x02\x03\x04", "%R", 0x01020304);
+    test_format_binary("\x34\x12", "%hr", 0x1234);
+    test_format_binary("\xff", "%hhR", -1);
+    test_format_binary("\x04\x03\x02", "%3r", 0x01020304);
+    test_format_binary("\x00\x00\x00\x00\x00\x00\x01\x02",
+                       "%llR",
+                       0x0102ull);
+    test_format_binary("\x00", "%.0hhr", 0);
+    test_format_binary("\x00", "%v", 0);
+    test_format_binary("\x7f", "%v", 127);
+    test_format_binary("\xe5\x8e\x26", "%v", 624485);
+    test_format_binary("\xff\xff\xff\xff\x0f", "%v", -1);
+    test_format_binary("\xff\x01", "%hhv", -1);
+    test_format_binary("\xff\xff\xff\xff\xff\xff\xff\xff\xff\x01",
+                       "%llv",
+                       ~0ull);
+    test_format_binary("\x7f", "%V", -1);
+    test_format_binary("\xc0\xbb\x78", "%V", -123456);
+    test_format_binary("\x80\x7f", "%hhV", -128);
+    test_format_binary("\x3f", "%V", 63);
+    test_format_binary("\xc0\x00", "%V", 64);
+
+    // Varint widths pad with redundant bytes, so fields can be patched.
+    test_format_binary("\x85\x80\x80\x00", "%4v", 5);
+    test_format_binary("\xff\xff\x7f", "%3V", -1);
+
+    // Binary and text fields mix in one frame.
+    test_format_binary("\xaa\x55\x05\x00id=7\x0b",
+                       "%hR%hr%s%hhr",
+                       0xaa55,
+                       5,
+                       "id=7",
+                       11);
+#pragma GCC diagnostic pop
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wformat"
 #pragma GCC diagnostic ignored "-Wformat-extra-args"
@@ -217,6 +717,1304 @@ int main(const int argc, const char *const argv[]) {
     test_format_to_buffer_no_count(sizeof(buffer), "", "%*.0", 0, "");
 #pragma GCC diagnostic pop
 
+    // Digit-grouping
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat"
+    test_format_to_buffer(sizeof(buffer), "1,234,567", "%'d", 1234567);
+    test_format_to_buffer(sizeof(buffer), "-1,234,567", "%'d", -1234567);
+    test_format_to_buffer(sizeof(buffer), "123", "%'d", 123);
+    test_format_to_buffer(sizeof(buffer), "1,000", "%'i", 1000);
+    test_format_to_buffer(sizeof(buffer), "0", "%'d", 0);
+    test_format_to_buffer(sizeof(buffer), "+1,000", "%'+d", 1000);
+    test_format_to_buffer(sizeof(buffer),
+                          "4,294,967,295",
+                          "%'u",
+                          4294967295u);
+    test_format_to_buffer(sizeof(buffer),
+                          "18,446,744,073,709,551,615",
+                          "%'llu",
+                          18446744073709551615ull);
+    test_format_to_buffer(sizeof(buffer),
+                          "-9,223,372,036,854,775,808",
+                          "%'lld",
+                          (long long)(-9223372036854775807ll - 1));
+    test_format_to_buffer(sizeof(buffer),
+                          "1,000,000,000,000",
+                          "%'llu",
+                          1000000000000ull);
+
+    // Like glibc, padding zeros aren't grouped, but separators count towards
+    // both width and precision.
+    test_format_to_buffer(sizeof(buffer), "   1,234,567", "%'12d", 1234567);
+    test_format_to_buffer(sizeof(buffer), "1,234,567   ", "%'-12d", 1234567);
+    test_format_to_buffer(sizeof(buffer), "0001,234,567", "%'012d", 1234567);
+    test_format_to_buffer(sizeof(buffer), "-001,234,567", "%'012d", -1234567);
+    test_format_to_buffer(sizeof(buffer), "01,234,567", "%'.10d", 1234567);
+    test_format_to_buffer(sizeof(buffer), "12345", "%'x", 0x12345);
+
+    printf_set_digit_grouping('.', 4);
+    test_format_to_buffer(sizeof(buffer), "1.2345.6789", "%'d", 123456789);
+    printf_set_digit_grouping(' ', 1);
+    test_format_to_buffer(sizeof(buffer), "1 2 3", "%'d", 123);
+    printf_set_digit_grouping(',', 0);
+    test_format_to_buffer(sizeof(buffer), "123456", "%'d", 123456);
+    printf_set_digit_grouping(',', 3);
+#pragma GCC diagnostic pop
+
+    // Positional arguments
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat"
+#pragma GCC diagnostic ignored "-Wformat-extra-args"
+    test_format_to_buffer_no_count(sizeof(buffer),
+                                   "World Hello",
+                                   "%2$s %1$s",
+                                   "Hello",
+                                   "World");
+    test_format_to_buffer_no_count(sizeof(buffer),
+                                   "Hi Hi 5",
+                                   "%1$s %1$s %2$d",
+                                   "Hi",
+                                   5);
+    test_format_to_buffer_no_count(sizeof(buffer),
+                                   "   42",
+                                   "%1$*2$d",
+                                   42,
+                                   5);
+    test_format_to_buffer_no_count(sizeof(buffer),
+                                   "Hel",
+                                   "%2$.*1$s",
+                                   3,
+                                   "Hello");
+    test_format_to_buffer_no_count(sizeof(buffer),
+                                   "-9000000000 7 x",
+                                   "%3$lld %1$d %2$s",
+                                   7,
+                                   "x",
+                                   -9000000000ll);
+    test_format_to_buffer_no_count(sizeof(buffer),
+                                   "100% 1",
+                                   "%2$d%% %1$d",
+                                   1,
+                                   100);
+    test_format_to_buffer_no_count(sizeof(buffer),
+                                   "1.50",
+                                   "%1$.2k",
+                                   0x18000,
+                                   16);
+#pragma GCC diagnostic pop
+    {
+        int count = 0;
+        format_to_buffer(buffer, sizeof(buffer), "%2$s%1$n", &count, "Hey");
+        assert(strcmp(buffer, "Hey") == 0);
+        assert(count == 3);
+    }
+    {
+        // Skipping an argument is invalid, so nothing is written.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat"
+        const uint32_t length =
+            format_to_buffer(buffer, sizeof(buffer), "%1$d %3$d", 1, 2, 3);
+#pragma GCC diagnostic pop
+
+        assert(length == 0);
+        assert(strcmp(buffer, "") == 0);
+    }
+    {
+        // So is an index of 0, or past PRINTF_MAX_POSITIONAL_ARGS, wherever it
+        // is in the format.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat"
+        assert(format_to_buffer(buffer, sizeof(buffer), "%33$d|%1$d", 1, 2, 3)
+               == 0);
+        assert(strcmp(buffer, "") == 0);
+
+        assert(format_to_buffer(buffer, sizeof(buffer), "%1$d|%33$d", 1, 2, 3)
+               == 0);
+        assert(strcmp(buffer, "") == 0);
+
+        assert(format_to_buffer(buffer, sizeof(buffer), "%0$d|%1$d", 1, 2)
+               == 0);
+        assert(strcmp(buffer, "") == 0);
+#pragma GCC diagnostic pop
+    }
+    {
+        struct printf_arg_table table;
+        assert(printf_arg_table_init(&table, "%2$s=%1$#x"));
+        assert(table.count == 2);
+
+        for (int i = 0; i != 3; i++) {
+            format_to_buffer_with_arg_table(buffer,
+                                            sizeof(buffer),
+                                            &table,
+                                            "%2$s=%1$#x",
+                                            255,
+                                            "key");
+            assert(strcmp(buffer, "key=0xff") == 0);
+        }
+
+        assert(printf_arg_table_init(&table, "%s %d"));
+        assert(table.count == 0);
+        assert(!printf_arg_table_init(&table, "%1$s %1$d"));
+    }
+
+    // fd sink
+    {
+        int fds[2];
+        assert(pipe(fds) == 0);
+
+        char sink_buffer[16];
+        struct fd_sink sink;
+
+        fd_sink_init(&sink,
+                     fds[1],
+                     sink_buffer,
+                     sizeof(sink_buffer),
+                     FD_SINK_FLUSH_ON_NEWLINE);
+
+        fd_sink_format(&sink, "a=%d ", 1);
+        assert(sink.syscall_count == 0);
+
+        fd_sink_format(&sink, "b=%d\n", 2);
+        assert(sink.syscall_count == 1);
+
+        // Strings that don't fit go out with the buffered data in one writev.
+        fd_sink_format(&sink, "c=%s", "0123456789abcdefghij");
+        assert(sink.syscall_count == 2);
+        assert(sink.buffer_used == 0);
+
+        fd_sink_format(&sink, "%5c", '!');
+        assert(fd_sink_flush(&sink));
+        assert(sink.syscall_count == 3);
+
+        const ssize_t length = read(fds[0], buffer, sizeof(buffer) - 1);
+        buffer[length] = '\0';
+
+        assert(strcmp(buffer, "a=1 b=2\nc=0123456789abcdefghij    !") == 0);
+        memset(buffer, '\0', sizeof(buffer));
+
+        fd_sink_init(&sink,
+                     fds[1],
+                     sink_buffer,
+                     sizeof(sink_buffer),
+                     FD_SINK_FLUSH_ON_FULL);
+
+        // Padding larger than the buffer is written out as the buffer fills.
+        fd_sink_format(&sink, "%20c\n", 'x');
+        assert(sink.syscall_count == 1);
+        assert(sink.buffer_used == 5);
+        assert(fd_sink_flush(&sink));
+
+        fd_sink_init(&sink,
+                     fds[1],
+                     sink_buffer,
+                     sizeof(sink_buffer),
+                     FD_SINK_FLUSH_MANUAL);
+
+        // Manual-flush sinks never write on their own, and truncate instead.
+        const uint32_t written =
+            fd_sink_format(&sink, "%s|%s", "0123456789", "abcdefghij");
+
+        assert(written == 16);
+        assert(sink.syscall_count == 0);
+        assert(fd_sink_flush(&sink));
+
+        const ssize_t length2 = read(fds[0], buffer, sizeof(buffer) - 1);
+        buffer[length2] = '\0';
+
+        assert(strcmp(buffer,
+                      "                   x\n0123456789|abcde") == 0);
+        memset(buffer, '\0', sizeof(buffer));
+
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    // io_uring sink, along with its synchronous fallback.
+    {
+        char dir_template[] = "/tmp/printf-test-XXXXXX";
+        const char *const dir = mkdtemp(dir_template);
+        assert(dir != NULL);
+
+        char path[256];
+        snprintf(path, sizeof(path), "%s/uring.log", dir);
+
+        const enum uring_sink_mode modes[] = {
+            URING_SINK_MODE_AUTO,
+            URING_SINK_MODE_SYNC
+        };
+
+        for (uint32_t m = 0; m != sizeof(modes) / sizeof(modes[0]); m++) {
+            const int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+            assert(fd >= 0);
+
+            // Start past some existing data to check that offsets are kept.
+            assert(write(fd, "head\n", 5) == 5);
+
+            static char uring_buffers[4 * 64];
+            struct uring_sink sink;
+
+            assert(uring_sink_init(&sink, fd, uring_buffers, 64, 4, modes[m]));
+
+            char expected[8192] = "head\n";
+            uint32_t expected_length = 5;
+
+            for (int i = 0; i != 200; i++) {
+                uring_sink_format(&sink, "line %d: %s\n", i, "some payload");
+                expected_length +=
+                    (uint32_t)snprintf(expected + expected_length,
+                                       sizeof(expected) - expected_length,
+                                       "line %d: %s\n",
+                                       i,
+                                       "some payload");
+            }
+
+            assert(uring_sink_destroy(&sink));
+            assert(lseek(fd, 0, SEEK_CUR) == (off_t)expected_length);
+
+            static char contents[8192];
+            const ssize_t length = pread(fd, contents, sizeof(contents), 0);
+
+            assert(length == (ssize_t)expected_length);
+            assert(memcmp(contents, expected, expected_length) == 0);
+
+            close(fd);
+        }
+
+        unlink(path);
+        rmdir(dir);
+    }
+
+    // mmap sink
+    {
+        char dir_template[] = "/tmp/printf-test-XXXXXX";
+        const char *const dir = mkdtemp(dir_template);
+        assert(dir != NULL);
+
+        char path[256];
+        snprintf(path, sizeof(path), "%s/mmap.log", dir);
+
+        static char expected[16384];
+        uint32_t expected_length = 0;
+
+        struct mmap_sink sink;
+        assert(mmap_sink_open(&sink, path, /*chunk_size=*/4096, false));
+
+        // Write past the first chunk, so the file has to grow.
+        for (int i = 0; i != 300; i++) {
+            mmap_sink_format(&sink, "line %d: %s\n", i, "some payload");
+            expected_length +=
+                (uint32_t)snprintf(expected + expected_length,
+                                   sizeof(expected) - expected_length,
+                                   "line %d: %s\n",
+                                   i,
+                                   "some payload");
+        }
+
+        assert(sink.used == expected_length);
+        assert(sink.map_size > MMAP_SINK_HEADER_SIZE + 4096);
+
+        // Output written without committing isn't visible in the header.
+        bool should_continue = true;
+        mmap_sink_write_string_callback(NULL,
+                                        &sink,
+                                        "partial",
+                                        7,
+                                        &should_continue);
+
+        const int read_fd = open(path, O_RDONLY);
+        assert(read_fd >= 0);
+
+        struct mmap_sink_header header;
+        assert(pread(read_fd, &header, sizeof(header), 0) == sizeof(header));
+        assert(header.magic == MMAP_SINK_MAGIC);
+        assert(header.committed_length == expected_length);
+
+        // Drop the partial message, as if we had crashed.
+        sink.used = expected_length;
+        assert(mmap_sink_close(&sink));
+
+        // Reopening appends after the committed data.
+        assert(mmap_sink_open(&sink, path, /*chunk_size=*/4096, true));
+        assert(sink.used == expected_length);
+
+        char large[1024];
+        memset(large, 'x', sizeof(large) - 1);
+        large[sizeof(large) - 1] = '\0';
+
+        mmap_sink_format(&sink, "%s\n", large);
+        expected_length +=
+            (uint32_t)snprintf(expected + expected_length,
+                               sizeof(expected) - expected_length,
+                               "%s\n",
+                               large);
+
+        assert(mmap_sink_sync(&sink));
+        assert(mmap_sink_close(&sink));
+
+        static char contents[16384];
+        const ssize_t length =
+            pread(read_fd, contents, sizeof(contents), MMAP_SINK_HEADER_SIZE);
+
+        assert(length == (ssize_t)expected_length);
+        assert(memcmp(contents, expected, expected_length) == 0);
+
+        close(read_fd);
+        unlink(path);
+
+        // A message that fails to grow the file partway isn't committed, even
+        // by close().
+        assert(mmap_sink_open(&sink, path, /*chunk_size=*/4096, false));
+        mmap_sink_format(&sink, "first\n");
+
+        struct rlimit old_limit;
+        assert(getrlimit(RLIMIT_FSIZE, &old_limit) == 0);
+
+        struct rlimit limit = old_limit;
+        limit.rlim_cur = MMAP_SINK_HEADER_SIZE + 4096;
+
+        void (*const old_handler)(int) = signal(SIGXFSZ, SIG_IGN);
+        assert(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+
+        memset(large, 'x', sizeof(large) - 1);
+        for (int i = 0; i != 8 && !sink.failed; i++) {
+            mmap_sink_format(&sink, "%s%s\n", large, large);
+        }
+
+        assert(setrlimit(RLIMIT_FSIZE, &old_limit) == 0);
+        signal(SIGXFSZ, old_handler);
+
+        assert(sink.failed);
+        assert(sink.map != NULL);
+
+        const uint64_t committed = sink.committed;
+        assert(committed < sink.used);
+        assert(((struct mmap_sink_header *)sink.map)->committed_length
+               == committed);
+        assert(!mmap_sink_close(&sink));
+
+        struct stat st;
+        assert(stat(path, &st) == 0);
+        assert((uint64_t)st.st_size == MMAP_SINK_HEADER_SIZE + committed);
+
+        unlink(path);
+        rmdir(dir);
+    }
+
+    // LZ4 compression sink
+    {
+        static uint8_t compressed[1 << 18];
+        static uint8_t decompressed[1 << 18];
+        static char expected[1 << 18];
+
+        struct memory_sink downstream = {
+            .data = compressed,
+            .used = 0,
+            .capacity = sizeof(compressed)
+        };
+
+        static struct lz4_sink sink;
+        lz4_sink_init(&sink, memory_sink_write_string_callback, &downstream);
+
+        uint32_t expected_length = 0;
+        for (int i = 0; i != 2000; i++) {
+            const char *const path = (i % 3) == 0 ? "/api/items" : "/health";
+            lz4_sink_format(&sink,
+                            "INFO id=%d path=%s status=%d\n",
+                            i,
+                            path,
+                            200);
+
+            expected_length +=
+                (uint32_t)snprintf(expected + expected_length,
+                                   sizeof(expected) - expected_length,
+                                   "INFO id=%d path=%s status=%d\n",
+                                   i,
+                                   path,
+                                   200);
+        }
+
+        // A long run of one character compresses to overlapping matches.
+        lz4_sink_format(&sink, "%5000c", '!');
+        memset(expected + expected_length, ' ', 4999);
+        expected[expected_length + 4999] = '!';
+        expected_length += 5000;
+
+        // Pseudo-random text doesn't compress, and is stored as raw blocks.
+        uint32_t state = 1;
+        for (int i = 0; i != 20000; i++) {
+            state = state * 1103515245 + 12345;
+
+            const char ch = (char)('!' + ((state >> 16) % 90));
+            lz4_sink_format(&sink, "%c", ch);
+            expected[expected_length++] = ch;
+        }
+
+        assert(lz4_sink_flush(&sink));
+        assert(sink.bytes_in == expected_length);
+        assert(sink.bytes_out == downstream.used);
+
+        const int64_t decoded_length =
+            lz4_sink_decode(compressed,
+                            downstream.used,
+                            decompressed,
+                            sizeof(decompressed));
+
+        assert(decoded_length == expected_length);
+        assert(memcmp(decompressed, expected, expected_length) == 0);
+
+        // Truncated streams are rejected.
+        assert(lz4_sink_decode(compressed,
+                               downstream.used - 1,
+                               decompressed,
+                               sizeof(decompressed)) == -1);
+
+        // Tiny inputs round-trip too.
+        downstream.used = 0;
+        lz4_sink_format(&sink, "%s", "hi");
+
+        assert(lz4_sink_flush(&sink));
+        assert(lz4_sink_decode(compressed,
+                               downstream.used,
+                               decompressed,
+                               sizeof(decompressed)) == 2);
+        assert(memcmp(decompressed, "hi", 2) == 0);
+    }
+
+    // Ping-pong sink, with a thread standing in for the DMA interrupt.
+    {
+        static char buffer[2 * 64];
+        static uint8_t captured[16384];
+        static char expected[16384];
+
+        struct pingpong_sink sink;
+        struct fake_transmitter transmitter = {
+            .sink = &sink,
+            .capture = {
+                .data = captured,
+                .used = 0,
+                .capacity = sizeof(captured),
+            },
+        };
+
+        pingpong_sink_init(&sink,
+                           buffer,
+                           sizeof(buffer) / 2,
+                           fake_transmitter_start,
+                           NULL,
+                           &transmitter);
+
+        pthread_t thread;
+        assert(pthread_create(&thread,
+                              NULL,
+                              fake_transmitter_thread,
+                              &transmitter) == 0);
+
+        uint32_t expected_length = 0;
+        for (int i = 0; i != 200; i++) {
+            pingpong_sink_format(&sink, "sample %d: %08x\n", i, i * 7919);
+            expected_length +=
+                (uint32_t)snprintf(expected + expected_length,
+                                   sizeof(expected) - expected_length,
+                                   "sample %d: %08x\n",
+                                   i,
+                                   i * 7919);
+        }
+
+        // Padding longer than a whole half.
+        pingpong_sink_format(&sink, "%150c", '#');
+        memset(expected + expected_length, ' ', 149);
+        expected[expected_length + 149] = '#';
+        expected_length += 150;
+
+        pingpong_sink_flush(&sink);
+        pingpong_sink_wait_idle(&sink);
+
+        __atomic_store_n(&transmitter.stop, true, __ATOMIC_RELEASE);
+        assert(pthread_join(thread, NULL) == 0);
+
+        assert(transmitter.capture.used == expected_length);
+        assert(memcmp(captured, expected, expected_length) == 0);
+    }
+
+    // Tee sink
+    {
+        uint8_t large_data[256];
+        uint8_t small_data[8];
+
+        struct memory_sink large = {
+            .data = large_data,
+            .used = 0,
+            .capacity = sizeof(large_data)
+        };
+
+        struct memory_sink small = {
+            .data = small_data,
+            .used = 0,
+            .capacity = sizeof(small_data)
+        };
+
+        struct tee_sink sink;
+        tee_sink_init(&sink);
+
+        assert(tee_sink_add(&sink,
+                            memory_sink_write_ch_callback,
+                            &small,
+                            memory_sink_write_string_callback,
+                            &small));
+        assert(tee_sink_add(&sink,
+                            memory_sink_write_ch_callback,
+                            &large,
+                            memory_sink_write_string_callback,
+                            &large));
+
+        // The small destination truncates without stopping the large one.
+        const char expected[] = "id=42 name=tee   value=0x1f";
+        assert(tee_sink_format(&sink,
+                               "id=%d name=%-5s value=%#x",
+                               42,
+                               "tee",
+                               31) == strlen(expected));
+
+        assert(large.used == strlen(expected));
+        assert(memcmp(large_data, expected, large.used) == 0);
+        assert(small.used == sizeof(small_data));
+        assert(memcmp(small_data, expected, small.used) == 0);
+
+        // Each message starts with every destination enabled again.
+        small.used = 0;
+        large.used = 0;
+
+        tee_sink_format(&sink, "%s", "ok");
+        assert(small.used == 2 && memcmp(small_data, "ok", 2) == 0);
+        assert(large.used == 2 && memcmp(large_data, "ok", 2) == 0);
+
+        // Once every destination declines, formatting stops.
+        small.used = small.capacity;
+        large.used = large.capacity - 4;
+
+        tee_sink_format(&sink, "%s%d", "abcdef", 1);
+        assert(sink.active_count == 0);
+        assert(large.used == large.capacity);
+
+    }
+
+    // Flight-recorder ring sink
+    {
+        static uint64_t memory[(6 * RING_SINK_SLOT_SIZE) / sizeof(uint64_t)];
+        static char dump[64 * RING_SINK_SLOT_SIZE];
+
+        struct ring_sink sink;
+        assert(!ring_sink_init(&sink, memory, RING_SINK_SLOT_SIZE - 1));
+
+        // Rounded down to four slots.
+        assert(ring_sink_init(&sink, memory, sizeof(memory)));
+        assert(sink.slot_mask == 3);
+
+        int fds[2];
+        assert(pipe(fds) == 0);
+
+        // Empty rings dump nothing.
+        assert(ring_sink_dump(&sink, fds[1]));
+
+        for (int i = 0; i != 6; i++) {
+            ring_sink_format(&sink, "line %d\n", i);
+        }
+
+        assert(ring_sink_dump(&sink, fds[1]));
+        ssize_t length = read(fds[0], dump, sizeof(dump) - 1);
+        dump[length] = '\0';
+
+        assert(strcmp(dump, "line 2\nline 3\nline 4\nline 5\n") == 0);
+
+        // Long messages are truncated to a slot.
+        assert(ring_sink_format(&sink, "%200c", 'x') == RING_SINK_TEXT_SIZE);
+        assert(ring_sink_dump(&sink, fds[1]));
+
+        length = read(fds[0], dump, sizeof(dump) - 1);
+        assert(length == 3 * 7 + RING_SINK_TEXT_SIZE);
+        assert(dump[length - 1] == ' ');
+
+        // Many threads writing at once.
+        static uint64_t large_memory[(64 * RING_SINK_SLOT_SIZE) / 8];
+        assert(ring_sink_init(&sink, large_memory, sizeof(large_memory)));
+
+        pthread_t threads[RING_TEST_THREADS];
+        for (int i = 0; i != RING_TEST_THREADS; i++) {
+            assert(pthread_create(&threads[i],
+                                  NULL,
+                                  ring_sink_test_thread,
+                                  &sink) == 0);
+        }
+
+        for (int i = 0; i != RING_TEST_THREADS; i++) {
+            assert(pthread_join(threads[i], NULL) == 0);
+        }
+
+        assert(sink.head == RING_TEST_THREADS * RING_TEST_MESSAGES);
+        assert(ring_sink_dump(&sink, fds[1]));
+
+        close(fds[1]);
+
+        uint32_t dump_length = 0;
+        while ((length = read(fds[0],
+                              dump + dump_length,
+                              sizeof(dump) - 1 - dump_length)) > 0)
+        {
+            dump_length += (uint32_t)length;
+        }
+
+        dump[dump_length] = '\0';
+        close(fds[0]);
+
+        // Every complete message survives whole, one per line.
+        uint32_t lines = 0;
+        for (char *line = dump; *line != '\0'; lines++) {
+            unsigned thread_id = 0;
+            unsigned message = 0;
+
+            assert(sscanf(line,
+                          "thread %u message %u",
+                          &thread_id,
+                          &message) == 2);
+            assert(thread_id < RING_TEST_THREADS);
+            assert(message < RING_TEST_MESSAGES);
+
+            line = strchr(line, '\n') + 1;
+        }
+
+        assert(lines <= 64 && lines + sink.dropped >= 64);
+    }
+
+    // Repeated-message suppression
+    {
+        static uint8_t output_data[4096];
+        struct memory_sink output = {
+            .data = output_data,
+            .used = 0,
+            .capacity = sizeof(output_data)
+        };
+
+        static struct dedup_sink sink;
+        dedup_sink_init(&sink,
+                        memory_sink_write_string_callback,
+                        &output,
+                        /*window_count=*/3,
+                        /*window_ns=*/0);
+
+        dedup_sink_format(&sink, "start\n");
+        for (int i = 0; i != 3; i++) {
+            // Fragments of one line are gathered before comparing.
+            dedup_sink_format(&sink, "error: %s", "timeout");
+            dedup_sink_format(&sink, " after %dms\n", 500);
+        }
+
+        dedup_sink_format(&sink, "done\n");
+
+        // The run ends after three repeats.
+        for (int i = 0; i != 6; i++) {
+            dedup_sink_format(&sink, "%5c\n", 'x');
+        }
+
+        // Summaries for a run in progress are emitted on flush.
+        assert(dedup_sink_flush(&sink));
+
+        const char expected[] =
+            "start\n"
+            "error: timeout after 500ms\n"
+            "last message repeated 2 times\n"
+            "done\n"
+            "    x\n"
+            "last message repeated 3 times\n"
+            "    x\n"
+            "last message repeated 1 times\n";
+
+        assert(output.used == strlen(expected));
+        assert(memcmp(output_data, expected, output.used) == 0);
+        assert(sink.lines_in == 11);
+        assert(sink.lines_suppressed == 6);
+
+        // Over-long lines are passed through, and never suppressed.
+        output.used = 0;
+        for (int i = 0; i != 2; i++) {
+            dedup_sink_format(&sink, "%*c\n", DEDUP_SINK_LINE_SIZE + 10, '!');
+        }
+
+        dedup_sink_format(&sink, "partial");
+        assert(dedup_sink_flush(&sink));
+
+        assert(output.used == 2 * (DEDUP_SINK_LINE_SIZE + 11) + 7);
+        assert(memcmp(output_data + output.used - 9, "!\npartial", 9) == 0);
+
+        // Repeats outside the time window start a new run.
+        output.used = 0;
+        dedup_sink_init(&sink,
+                        memory_sink_write_string_callback,
+                        &output,
+                        /*window_count=*/0,
+                        /*window_ns=*/1000000);
+
+        dedup_sink_format(&sink, "tick\n");
+        dedup_sink_format(&sink, "tick\n");
+
+        const struct timespec pause = { .tv_sec = 0, .tv_nsec = 2000000 };
+        nanosleep(&pause, NULL);
+
+        dedup_sink_format(&sink, "tick\n");
+        assert(dedup_sink_flush(&sink));
+
+        const char expected_timed[] =
+            "tick\nlast message repeated 1 times\ntick\n";
+
+        assert(output.used == strlen(expected_timed));
+        assert(memcmp(output_data, expected_timed, output.used) == 0);
+    }
+
+    // Tokenized records
+    {
+        static const char *const formats[] = {
+            "boot ok",
+            "temp=%d.%02u C sensor=%s",
+            "%2$s took %1$lldus",
+            "rx %zu bytes from %#x, %-6s|%5d",
+            "width %*d",
+            "count%n"
+        };
+
+        struct printf_token_entry database[6];
+        for (uint32_t i = 0; i != 6; i++) {
+            database[i].token =
+                printf_token_hash(formats[i], (uint32_t)strlen(formats[i]));
+            database[i].format = formats[i];
+        }
+
+        // The compile-time and runtime hashes agree.
+        assert(PRINTF_TOKEN("boot ok") == database[0].token);
+        assert(PRINTF_TOKEN("") == printf_token_hash("", 0));
+
+        uint8_t record[PRINTF_TOKEN_MAX_RECORD_SIZE];
+        uint32_t length = PRINTF_TOKENIZE_TO_BUFFER(record,
+                                                    sizeof(record),
+                                                    "boot ok");
+        assert(length == 4);
+        test_detokenize(database, 6, record, length, "boot ok");
+
+        length = PRINTF_TOKENIZE_TO_BUFFER(record,
+                                           sizeof(record),
+                                           "temp=%d.%02u C sensor=%s",
+                                           -12,
+                                           5u,
+                                           "intake");
+
+        // The token, two one-byte varints, and a length-prefixed string.
+        assert(length == 4 + 1 + 1 + 1 + 6);
+        test_detokenize(database,
+                        6,
+                        record,
+                        length,
+                        "temp=-12.05 C sensor=intake");
+
+        length = PRINTF_TOKENIZE_TO_BUFFER(record,
+                                           sizeof(record),
+                                           "%2$s took %1$lldus",
+                                           123456789012ll,
+                                           "flush");
+        test_detokenize(database,
+                        6,
+                        record,
+                        length,
+                        "flush took 123456789012us");
+
+        length = PRINTF_TOKENIZE_TO_BUFFER(record,
+                                           sizeof(record),
+                                           "rx %zu bytes from %#x, %-6s|%5d",
+                                           (size_t)4096,
+                                           0xbeefu,
+                                           "eth0",
+                                           -3);
+        test_detokenize(database,
+                        6,
+                        record,
+                        length,
+                        "rx 4096 bytes from 0xbeef, eth0  |   -3");
+
+        length = PRINTF_TOKENIZE_TO_BUFFER(record,
+                                           sizeof(record),
+                                           "width %*d",
+                                           4,
+                                           7);
+        test_detokenize(database, 6, record, length, "width    7");
+
+        // Records that don't match their format are rejected.
+        uint8_t rendered_data[64];
+        struct memory_sink rendered = {
+            .data = rendered_data,
+            .used = 0,
+            .capacity = sizeof(rendered_data)
+        };
+
+        assert(printf_detokenize(memory_sink_write_ch_callback,
+                                 &rendered,
+                                 memory_sink_write_string_callback,
+                                 &rendered,
+                                 database,
+                                 6,
+                                 record,
+                                 length - 1) == -1);
+
+        // So are unknown tokens, and formats that write back through %n.
+        assert(printf_detokenize(memory_sink_write_ch_callback,
+                                 &rendered,
+                                 memory_sink_write_string_callback,
+                                 &rendered,
+                                 database,
+                                 1,
+                                 record,
+                                 length) == -1);
+
+        int count = 0;
+        length = PRINTF_TOKENIZE_TO_BUFFER(record,
+                                           sizeof(record),
+                                           "count%n",
+                                           &count);
+        assert(printf_detokenize(memory_sink_write_ch_callback,
+                                 &rendered,
+                                 memory_sink_write_string_callback,
+                                 &rendered,
+                                 database,
+                                 6,
+                                 record,
+                                 length) == -1);
+
+        // Records that don't fit aren't written.
+        assert(PRINTF_TOKENIZE_TO_BUFFER(record,
+                                         8,
+                                         "temp=%d.%02u C sensor=%s",
+                                         1,
+                                         2u,
+                                         "intake") == 0);
+    }
+
+    // Scanf-style parsing
+    {
+        // Round-trip a line we formatted.
+        const char line[] = "rx 4096 bytes from 0xbeef, eth0  |   -3";
+
+        size_t bytes = 0;
+        unsigned from = 0;
+        struct scanf_capture name = {0};
+        int value = 0;
+        int consumed = 0;
+
+        assert(parse_scanf_format(line,
+                                  sizeof(line) - 1,
+                                  "rx %zu bytes from %x, %[^ ] |%d%n",
+                                  &bytes,
+                                  &from,
+                                  &name,
+                                  &value,
+                                  &consumed) == 4);
+
+        assert(bytes == 4096 && from == 0xbeef && value == -3);
+        assert(name.length == 4 && memcmp(name.begin, "eth0", 4) == 0);
+        assert(consumed == (int)sizeof(line) - 1);
+
+        // Long digit runs go through the 8-byte path, with any remainder.
+        unsigned long long big = 0;
+        unsigned long long hex = 0;
+        long long negative = 0;
+
+        assert(parse_scanf_format("18446744073709551615 DEADbeef01234567 "
+                                  "-9223372036854775808",
+                                  59,
+                                  "%llu %llx %lld",
+                                  &big,
+                                  &hex,
+                                  &negative) == 3);
+
+        assert(big == UINT64_MAX);
+        assert(hex == 0xdeadbeef01234567ull);
+        assert(negative == INT64_MIN);
+
+        // Overflow fails the conversion.
+        assert(parse_scanf_format("18446744073709551616",
+                                  20,
+                                  "%llu",
+                                  &big) == 0);
+
+        // Widths bound a field, including its sign or prefix.
+        int first = 0;
+        int second = 0;
+
+        assert(parse_scanf_format("12345678901", 11, "%9d%d", &first, &second)
+               == 2);
+        assert(first == 123456789 && second == 1);
+        assert(parse_scanf_format("-0x1f", 5, "%4i", &first) == 1);
+        assert(first == -1);
+        assert(parse_scanf_format("0755 0x10 10", 12, "%i %i %i",
+                                  &first, &second, &value) == 3);
+        assert(first == 0755 && second == 16 && value == 10);
+
+        // Values are truncated to the argument's type.
+        unsigned char small = 0;
+        short medium = 0;
+
+        assert(parse_scanf_format("300 -2", 6, "%hhu %hd", &small, &medium)
+               == 2);
+        assert(small == 44 && medium == -2);
+
+        // The input needn't be null-terminated.
+        assert(parse_scanf_format("42xyz", 2, "%d%n", &first, &consumed)
+               == 1);
+        assert(first == 42 && consumed == 2);
+
+        // Captures, skipped fields and literals.
+        struct scanf_capture word = {0};
+        struct scanf_capture chars = {0};
+
+        assert(parse_scanf_format("  key = value;ab",
+                                  16,
+                                  "%*s = %[a-z];%2c",
+                                  &word,
+                                  &chars) == 2);
+        assert(word.length == 5 && memcmp(word.begin, "value", 5) == 0);
+        assert(chars.length == 2 && memcmp(chars.begin, "ab", 2) == 0);
+
+        assert(parse_scanf_format("100% done", 9, "%d%% %3s", &first, &word)
+               == 2);
+        assert(first == 100 && memcmp(word.begin, "don", word.length) == 0);
+
+        // Matching failures stop at the field, and running out of input
+        // before any field returns -1.
+        assert(parse_scanf_format("a=1 b=x", 7, "a=%d b=%d", &first, &second)
+               == 1);
+        assert(parse_scanf_format("   ", 3, "%d", &first) == -1);
+        assert(parse_scanf_format("", 0, "%s", &word) == -1);
+    }
+
+    // Word-at-a-time primitives, at every alignment and length up to a few
+    // words, against libc.
+    {
+        char text[64];
+        char copy[64];
+
+        for (uint32_t start = 0; start != 16; start++) {
+            for (uint32_t length = 0; start + length < 48; length++) {
+                memset(text, 'a', sizeof(text));
+                text[start + length] = '\0';
+
+                const char *const str = text + start;
+                assert(swar_strlen(str) == length);
+                assert(swar_find_percent(str) == NULL);
+
+                for (size_t max = 0; max != length + 10; max++) {
+                    assert(swar_strnlen(str, max) == strnlen(str, max));
+                }
+
+                if (length != 0) {
+                    text[start + length - 1] = '%';
+                    assert(swar_find_percent(str) == str + length - 1);
+
+                    text[start] = '%';
+                    assert(swar_find_percent(str) == str);
+                }
+
+                // A byte of 0x80 or above must not look like a terminator.
+                memset(text, 0xa5, sizeof(text));
+                text[start + length] = '\0';
+                assert(swar_strlen(str) == length);
+
+                memset(copy, '@', sizeof(copy));
+                swar_memcpy(copy + (length % 8), str, length);
+                assert(memcmp(copy + (length % 8), str, length) == 0);
+                assert(copy[(length % 8) + length] == '@');
+                assert(length % 8 == 0 || copy[(length % 8) - 1] == '@');
+
+                memset(copy, '@', sizeof(copy));
+                swar_memset(copy + start, '#', length);
+                for (uint32_t i = 0; i != sizeof(copy); i++) {
+                    const bool inside = i >= start && i < start + length;
+                    assert(copy[i] == (inside ? '#' : '@'));
+                }
+            }
+        }
+    }
+
+    // An integer's sign, base prefix and zeros are written with its digits,
+    // leaving at most one more callback for padding spaces.
+    {
+        test_callback_count("0x00beef", 1, "%#08x", 0xbeef);
+        test_callback_count("+0042   ", 2, "%-+8.4d", 42);
+        test_callback_count("    0x001f", 2, "%#10.4x", 0x1f);
+        test_callback_count(" 0007   ", 2, "%- 8.4d", 7);
+        test_callback_count("    -007", 2, "%8.3d", -7);
+        test_callback_count("0B101", 1, "%#B", 5);
+        test_callback_count("-00000000000000000000000000001", 1, "%030d", -1);
+        test_callback_count("      ", 1, "%6.0d", 0);
+    }
+
+    // The 64-bit API keeps counting past 4 GiB, and %n sees the full count.
+    {
+        const uint64_t expected = 3 * (uint64_t)INT_MAX + 1;
+
+        long long int count = 0;
+        intmax_t count_max = 0;
+        size_t count_size = 0;
+
+        // gcc knows the total exceeds INT_MAX, which is the point here.
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wformat-overflow"
+            const uint64_t length =
+                get_length_of_printf_format64("%*s%*s%*s%lln!%jn%zn",
+                                              INT_MAX,
+                                              "",
+                                              INT_MAX,
+                                              "",
+                                              INT_MAX,
+                                              "",
+                                              &count,
+                                              &count_max,
+                                              &count_size);
+
+            assert(length == expected);
+            assert((uint64_t)count == expected - 1);
+            assert((uint64_t)count_max == expected);
+            assert((uint64_t)count_size == expected);
+
+            // The 32-bit API returns the count modulo 2^32, as it always has.
+            assert(get_length_of_printf_format("%*s%*s%*s!",
+                                               INT_MAX,
+                                               "",
+                                               INT_MAX,
+                                               "",
+                                               INT_MAX,
+                                               "") == (uint32_t)expected);
+        #pragma GCC diagnostic pop
+
+        int fds[2];
+        assert(pipe(fds) == 0);
+
+        char sink_buffer[16];
+        struct fd_sink sink;
+
+        fd_sink_init(&sink,
+                     fds[1],
+                     sink_buffer,
+                     sizeof(sink_buffer),
+                     FD_SINK_FLUSH_ON_FULL);
+
+        assert(fd_sink_format64(&sink, "%s=%5d", "key", 42) == 9);
+        assert(fd_sink_flush(&sink));
+
+        char read_buffer[16] = {0};
+        assert(read(fds[0], read_buffer, sizeof(read_buffer) - 1) == 9);
+        assert(strcmp(read_buffer, "key=   42") == 0);
+
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    // Compiled formats are written exactly as parsed ones.
+    {
+        test_compiled_format("x=%5d|%-4s|%#x", 42, "ab", 255);
+        test_compiled_format("%*d|%-*d|%.*d|%.*d", -6, 1, 4, 2, -1, 3, 2, 4);
+        test_compiled_format("%%|%hhd|%llu|%zx", 300, ULLONG_MAX, (size_t)0xbe);
+        test_compiled_format("%'d %+.3d % 05d", 1234567, 7, 42);
+        test_compiled_format("%.0d|%#o|%#.0o|%c%3c|%p", 0, 8, 0, 'a', 'b',
+                             (void *)0x1234);
+        test_compiled_format("no conversions");
+
+        // Including conversions that aren't standard, or are undefined.
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wformat"
+        #pragma GCC diagnostic ignored "-Wformat-extra-args"
+        #pragma GCC diagnostic ignored "-Wformat-zero-length"
+            test_compiled_format("%5%|%08.3s", "abcd");
+            test_compiled_format("a%qb%-#10B|%.2k", 5, 0x180, 8);
+            test_compiled_format("");
+        #pragma GCC diagnostic pop
+
+        struct printf_compiled_spec specs[2];
+        struct printf_compiled_format compiled;
+
+        // These are left to the runtime parser.
+        assert(!printf_compile_format(&compiled, specs, 2, "%2$s %1$s"));
+        assert(!printf_compile_format(&compiled, specs, 2, "abc%"));
+        assert(!printf_compile_format(&compiled, specs, 2, "%-5.*"));
+        assert(!printf_compile_format(&compiled, specs, 2, "%d%d%d"));
+    }
+
+    // This file's literal formats were compiled by printf_precompile into
+    // test_formats.c, and PRINTF_COMPILED() finds them.
+    {
+        assert(PRINTF_COMPILED("id=%04u %s\n") != NULL);
+        assert(PRINTF_COMPILED("id=%04u %s\n")->spec_count == 2);
+
+        char text[32];
+        assert(format_to_buffer_compiled(text,
+                                         sizeof(text),
+                                         PRINTF_COMPILED("id=%04u %s\n"),
+                                         "id=%04u %s\n",
+                                         7,
+                                         "ok") == 11);
+        assert(strcmp(text, "id=0007 ok\n") == 0);
+
+        const char *const not_literal = "id=%04u %s\n";
+        assert(PRINTF_COMPILED(not_literal) == NULL);
+        assert(format_to_buffer_compiled(text,
+                                         sizeof(text),
+                                         PRINTF_COMPILED(not_literal),
+                                         not_literal,
+                                         8,
+                                         "ok") == 11);
+        assert(strcmp(text, "id=0008 ok\n") == 0);
+
+        // A format that shares a token, but not its text, isn't matched.
+        assert(printf_compiled_lookup(PRINTF_TOKEN("id=%04u %s\n"),
+                                      "id=%04u %s\r",
+                                      11) == NULL);
+        assert(printf_compiled_lookup(PRINTF_TOKEN("not compiled %d"),
+                                      "not compiled %d",
+                                      15) == NULL);
+    }
+
+    // A context is reused across calls, and never shares a cache line.
+    {
+        assert(_Alignof(struct printf_context) == PRINTF_CACHE_LINE_SIZE);
+        assert(sizeof(struct printf_context) % PRINTF_CACHE_LINE_SIZE == 0);
+
+        int fds[2];
+        assert(pipe(fds) == 0);
+
+        char sink_buffer[64];
+        struct fd_sink sink;
+
+        fd_sink_init(&sink,
+                     fds[1],
+                     sink_buffer,
+                     sizeof(sink_buffer),
+                     FD_SINK_FLUSH_ON_FULL);
+
+        static _Thread_local struct printf_context context;
+        printf_context_init(&context,
+                            fd_sink_write_ch_callback64,
+                            &sink,
+                            fd_sink_write_string_callback64,
+                            &sink);
+
+        assert(format_with_context(&context, "%#llx|", ULLONG_MAX) == 19);
+        assert(format_with_context(&context, "%-3d|%s|", 7, "ab") == 7);
+        assert(format_with_context(&context, "%2$s%1$d", 5, "x") == 2);
+        assert(fd_sink_flush(&sink));
+
+        char read_buffer[64] = {0};
+        assert(read(fds[0], read_buffer, sizeof(read_buffer) - 1) == 28);
+        assert(strcmp(read_buffer, "0xffffffffffffffff|7  |ab|x5") == 0);
+
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    // Table columns are as wide as their widest cell.
+    {
+        struct printf_table table;
+        assert(printf_table_init(&table, "%-s | %u | %#x\n"));
+        assert(table.arg_count == 3);
+
+        const uint64_t rows[] = {
+            (uintptr_t)"nginx", 80, 0xff,
+            (uintptr_t)"postgres", 5432, 0x10,
+            (uintptr_t)"redis", 6379, 0x1000,
+        };
+
+        printf_table_measure(&table, rows, 3);
+
+        char data[128] = {0};
+        struct memory_sink sink = {
+            .data = (uint8_t *)data,
+            .capacity = sizeof(data) - 1
+        };
+
+        assert(printf_table_render(&table,
+                                   memory_sink_write_ch_callback,
+                                   &sink,
+                                   memory_sink_write_string_callback,
+                                   &sink,
+                                   rows,
+                                   3) == 75);
+
+        assert(strcmp(data,
+                      "nginx    |   80 |   0xff\n"
+                      "postgres | 5432 |   0x10\n"
+                      "redis    | 6379 | 0x1000\n") == 0);
+
+        // Rendering stops once the sink is full.
+        memset(data, 0, sizeof(data));
+        sink = (struct memory_sink){ .data = (uint8_t *)data, .capacity = 30 };
+
+        assert(printf_table_render(&table,
+                                   memory_sink_write_ch_callback,
+                                   &sink,
+                                   memory_sink_write_string_callback,
+                                   &sink,
+                                   rows,
+                                   3) == 30);
+
+        assert(strcmp(data, "nginx    |   80 |   0xff\npostg") == 0);
+
+        // A copy keeps working after the original is reused.
+        const struct printf_table copy = table;
+        assert(printf_table_init(&table, "%d\n"));
+
+        memset(data, 0, sizeof(data));
+        sink = (struct memory_sink){
+            .data = (uint8_t *)data,
+            .capacity = sizeof(data) - 1
+        };
+
+        assert(printf_table_render(&copy,
+                                   memory_sink_write_ch_callback,
+                                   &sink,
+                                   memory_sink_write_string_callback,
+                                   &sink,
+                                   rows,
+                                   1) == 25);
+
+        assert(strcmp(data, "nginx    |   80 |   0xff\n") == 0);
+
+        // Widths from '*' and the format are kept as minimums, and rows can
+        // be measured in batches.
+        assert(printf_table_init(&table, "%*d|%5s|%%\n"));
+        assert(table.arg_count == 3);
+
+        const uint64_t star_rows[] = {
+            2, 1, (uintptr_t)"a",
+            1, (uint64_t)-300, (uintptr_t)"abcdefg",
+        };
+
+        printf_table_measure(&table, star_rows, 1);
+        printf_table_measure(&table, star_rows + 3, 1);
+
+        memset(data, 0, sizeof(data));
+        sink = (struct memory_sink){
+            .data = (uint8_t *)data,
+            .capacity = sizeof(data) - 1
+        };
+
+        assert(printf_table_render(&table,
+                                   memory_sink_write_ch_callback,
+                                   &sink,
+                                   memory_sink_write_string_callback,
+                                   &sink,
+                                   star_rows,
+                                   2) == 30);
+
+        assert(strcmp(data, "   1|      a|%\n-300|abcdefg|%\n") == 0);
+
+        assert(!printf_table_init(&table, "%2$s %1$s\n"));
+        assert(!printf_table_init(&table,
+                                  "%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d"));
+    }
+
     const char buffer2[] = "Hello, There";
     test_format_to_buffer(sizeof(buffer), "Hel", "%.*s", 3, buffer2);
 
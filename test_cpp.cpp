@@ -0,0 +1,183 @@
+#include <cassert>
+#include <cstdio>
+#include <iterator>
+#include <list>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "printf_sinks.hpp"
+
+// Appends to a vector, and throws once it holds limit characters.
+struct throwing_iterator {
+    using difference_type = std::ptrdiff_t;
+
+    std::vector<char> *out;
+    std::size_t limit;
+
+    throwing_iterator &operator=(const char ch) {
+        if (out->size() == limit) {
+            throw std::length_error("full");
+        }
+
+        out->push_back(ch);
+        return *this;
+    }
+
+    throwing_iterator &operator*() { return *this; }
+    throwing_iterator &operator++() { return *this; }
+    throwing_iterator operator++(int) { return *this; }
+};
+
+int main(const int argc, const char *const argv[]) {
+    (void)argc;
+    (void)argv;
+
+    // Appending keeps what's already there, and grows past the estimate.
+    {
+        std::string text = "log: ";
+        assert(embedded_printf::append_format(text, "%s=%5d|", "key", 42)
+               == 10);
+        assert(text == "log: key=   42|");
+
+        assert(embedded_printf::append_format(text, "%300s", "") == 300);
+        assert(text.size() == 315);
+        assert(text.find_first_not_of(' ', 15) == std::string::npos);
+
+        std::vector<char> vector;
+        assert(embedded_printf::append_format(vector, "%#x", 255) == 4);
+        assert(std::string(vector.begin(), vector.end()) == "0xff");
+
+        assert(embedded_printf::estimate_length("a%db")
+               == 3 + embedded_printf::estimated_conversion_length);
+    }
+
+    // Repeated appends to a vector grow its capacity geometrically.
+    {
+        std::vector<char> vector;
+        std::size_t reallocations = 0;
+
+        for (int i = 0; i != 1000; i++) {
+            const std::size_t capacity = vector.capacity();
+            embedded_printf::append_format(vector, "%d,", i);
+
+            reallocations += vector.capacity() != capacity;
+        }
+
+        assert(vector.size() == 3890);
+        assert(reallocations < 20);
+    }
+
+    // A pmr builder can build entirely from a buffer on the stack.
+    {
+        char storage[1024];
+        std::pmr::monotonic_buffer_resource resource(
+            storage,
+            sizeof(storage),
+            std::pmr::null_memory_resource());
+
+        embedded_printf::pmr::builder builder(&resource);
+        builder.format("id=%04u ", 7);
+        builder.format("%s%c", "ok", '\n');
+
+        assert(builder.view() == "id=0007 ok\n");
+        assert(builder.str().get_allocator().resource() == &resource);
+
+        builder.clear();
+        builder.format("%llu", 18446744073709551615ull);
+        assert(builder.view() == "18446744073709551615");
+
+        embedded_printf::builder plain;
+        plain.format("%-3s|", "a");
+        assert(std::move(plain).str() == "a  |");
+    }
+
+    // Spans are filled up to their size, and never past it.
+    {
+        char storage[8] = { '#', '#', '#', '#', '#', '#', '#', '#' };
+        const std::span<char> span(storage, 6);
+
+        embedded_printf::format_to_span_result result =
+            embedded_printf::format_to_span(span, "%d-%d", 12, 34);
+
+        assert(result.size == 5 && !result.truncated);
+        assert(std::string(storage, 8) == "12-34###");
+
+        result = embedded_printf::format_to_span(span, "%06d", 42);
+        assert(result.size == 6 && !result.truncated);
+        assert(std::string(storage, 8) == "000042##");
+
+        result = embedded_printf::format_to_span(span, "%s|%5d", "abcd", 1);
+        assert(result.size == 6 && result.truncated);
+        assert(std::string(storage, 8) == "abcd| ##");
+
+        result = embedded_printf::format_to_span(std::span<char>(), "%d", 1);
+        assert(result.size == 0 && result.truncated);
+    }
+
+    // Output iterators get the whole output, across batches.
+    {
+        std::string text;
+        embedded_printf::format_to(std::back_inserter(text),
+                                   "[%-600s|%*c|%s]",
+                                   "left",
+                                   300,
+                                   'x',
+                                   "end");
+
+        assert(text.size() == 1 + 600 + 1 + 300 + 1 + 3 + 1);
+        assert(text.compare(0, 5, "[left") == 0);
+        assert(text.compare(text.size() - 6, 6, "x|end]") == 0);
+
+        char storage[16] = {0};
+        char *const end =
+            embedded_printf::format_to(storage, "%u+%u", 1u, 2u);
+
+        assert(end == storage + 3);
+        assert(std::string(storage) == "1+2");
+
+        std::list<char> list;
+        embedded_printf::format_to(std::back_inserter(list), "%x", 0xabcu);
+        assert(std::string(list.begin(), list.end()) == "abc");
+    }
+
+    // Exceptions from the container stop formatting, and reach the caller.
+    {
+        char storage[64];
+        std::pmr::monotonic_buffer_resource resource(
+            storage,
+            sizeof(storage),
+            std::pmr::null_memory_resource());
+
+        embedded_printf::pmr::builder builder(&resource);
+
+        bool threw = false;
+        try {
+            builder.format("%s|%500s|%d", "start", "", 1);
+        } catch (const std::bad_alloc &) {
+            threw = true;
+        }
+
+        assert(threw);
+
+        std::vector<char> vector;
+        threw = false;
+
+        try {
+            embedded_printf::format_to(throwing_iterator{ &vector, 10 },
+                                       "%300s%s",
+                                       "",
+                                       "end");
+        } catch (const std::length_error &) {
+            threw = true;
+        }
+
+        assert(threw);
+        assert(vector.size() == 10);
+    }
+
+    std::printf("All tests passed!\n");
+}
@@ -0,0 +1,564 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "uring_sink.h"
+
+#if defined(__linux__) && defined(__has_include)
+    #if __has_include(<linux/io_uring.h>)
+        #define URING_SINK_HAS_IO_URING 1
+    #endif /* __has_include(<linux/io_uring.h>) */
+#endif /* defined(__linux__) && defined(__has_include) */
+
+#if defined(URING_SINK_HAS_IO_URING)
+    #include <linux/io_uring.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <sys/uio.h>
+#endif /* defined(URING_SINK_HAS_IO_URING) */
+
+static inline char *
+uring_sink_buffer_at(const struct uring_sink *const sink, const uint32_t index)
+{
+    return sink->buffers + ((uint64_t)index * sink->buffer_size);
+}
+
+#if defined(URING_SINK_HAS_IO_URING)
+
+/*
+ * We talk to io_uring through its system calls directly, so we don't depend on
+ * liburing.
+ */
+
+static int
+sys_io_uring_setup(const uint32_t entries, struct io_uring_params *const params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int
+sys_io_uring_enter(const int fd,
+                   const uint32_t to_submit,
+                   const uint32_t min_complete,
+                   const uint32_t flags)
+{
+    return (int)syscall(__NR_io_uring_enter,
+                        fd,
+                        to_submit,
+                        min_complete,
+                        flags,
+                        NULL,
+                        0);
+}
+
+static int
+sys_io_uring_register(const int fd,
+                      const uint32_t opcode,
+                      const void *const arg,
+                      const uint32_t nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void ring_teardown(struct uring_sink_ring *const ring) {
+    if (ring->sqes != NULL) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+
+    if (ring->cq_ring != NULL) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+
+    if (ring->sq_ring != NULL) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+
+    close(ring->fd);
+    memset(ring, 0, sizeof(*ring));
+}
+
+static void *
+ring_mmap(const int fd, const uint64_t size, const uint64_t offset) {
+    void *const result =
+        mmap(NULL,
+             size,
+             PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE,
+             fd,
+             (off_t)offset);
+
+    return result != MAP_FAILED ? result : NULL;
+}
+
+/*
+ * IORING_OP_WRITE, and probing for it, were added in Linux 5.6. Older kernels
+ * fail the probe, and can only write registered buffers.
+ */
+
+static bool ring_supports_write(const struct uring_sink_ring *const ring) {
+    _Alignas(struct io_uring_probe) char
+        storage[sizeof(struct io_uring_probe)
+                + (IORING_OP_WRITE + 1) * sizeof(struct io_uring_probe_op)];
+
+    memset(storage, 0, sizeof(storage));
+
+    struct io_uring_probe *const probe = (struct io_uring_probe *)storage;
+    if (sys_io_uring_register(ring->fd,
+                              IORING_REGISTER_PROBE,
+                              probe,
+                              IORING_OP_WRITE + 1) != 0)
+    {
+        return false;
+    }
+
+    return probe->last_op >= IORING_OP_WRITE
+        && (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED) != 0;
+}
+
+static bool ring_setup(struct uring_sink *const sink) {
+    struct uring_sink_ring *const ring = &sink->ring;
+    struct io_uring_params params;
+
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(*ring));
+
+    ring->fd = sys_io_uring_setup(sink->buffer_count, &params);
+    if (ring->fd < 0) {
+        return false;
+    }
+
+    ring->sq_ring_size =
+        params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    ring->cq_ring_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    ring->sq_ring = ring_mmap(ring->fd, ring->sq_ring_size, IORING_OFF_SQ_RING);
+    ring->cq_ring = ring_mmap(ring->fd, ring->cq_ring_size, IORING_OFF_CQ_RING);
+    ring->sqes = ring_mmap(ring->fd, ring->sqes_size, IORING_OFF_SQES);
+
+    if (ring->sq_ring == NULL || ring->cq_ring == NULL || ring->sqes == NULL) {
+        ring_teardown(ring);
+        return false;
+    }
+
+    char *const sq_ring = (char *)ring->sq_ring;
+    char *const cq_ring = (char *)ring->cq_ring;
+
+    ring->sq_head = (uint32_t *)(sq_ring + params.sq_off.head);
+    ring->sq_tail = (uint32_t *)(sq_ring + params.sq_off.tail);
+    ring->sq_mask = (uint32_t *)(sq_ring + params.sq_off.ring_mask);
+    ring->sq_array = (uint32_t *)(sq_ring + params.sq_off.array);
+
+    ring->cq_head = (uint32_t *)(cq_ring + params.cq_off.head);
+    ring->cq_tail = (uint32_t *)(cq_ring + params.cq_off.tail);
+    ring->cq_mask = (uint32_t *)(cq_ring + params.cq_off.ring_mask);
+    ring->cqes = cq_ring + params.cq_off.cqes;
+
+    // Registering buffers can fail if RLIMIT_MEMLOCK is too small, in which
+    // case we use unregistered writes.
+
+    struct iovec iovecs[URING_SINK_MAX_BUFFERS];
+    for (uint32_t i = 0; i != sink->buffer_count; i++) {
+        iovecs[i].iov_base = uring_sink_buffer_at(sink, i);
+        iovecs[i].iov_len = sink->buffer_size;
+    }
+
+    ring->registered_buffers =
+        sys_io_uring_register(ring->fd,
+                              IORING_REGISTER_BUFFERS,
+                              iovecs,
+                              sink->buffer_count) == 0;
+
+    // Without registered buffers we need IORING_OP_WRITE, or we use the
+    // synchronous path.
+    if (!ring->registered_buffers && !ring_supports_write(ring)) {
+        ring_teardown(ring);
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+ring_submit_write(struct uring_sink *const sink, const uint32_t index) {
+    struct uring_sink_ring *const ring = &sink->ring;
+    const struct uring_sink_buffer *const info = &sink->buffer_info[index];
+
+    const uint32_t tail = *ring->sq_tail;
+    const uint32_t sqe_index = tail & *ring->sq_mask;
+
+    struct io_uring_sqe *const sqe =
+        (struct io_uring_sqe *)ring->sqes + sqe_index;
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = sink->fd;
+    sqe->addr =
+        (uint64_t)(uintptr_t)(uring_sink_buffer_at(sink, index)
+                              + info->completed);
+    sqe->len = info->length - info->completed;
+    sqe->off = info->offset + info->completed;
+    sqe->user_data = index;
+
+    if (ring->registered_buffers) {
+        sqe->opcode = IORING_OP_WRITE_FIXED;
+        sqe->buf_index = (uint16_t)index;
+    } else {
+        sqe->opcode = IORING_OP_WRITE;
+    }
+
+    ring->sq_array[sqe_index] = sqe_index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    while (sys_io_uring_enter(ring->fd, 1, 0, 0) < 0) {
+        if (errno == EINTR) {
+            continue;
+        }
+
+        // If the kernel didn't consume the entry, take it back, so it isn't
+        // submitted by a later call after the caller has reused the buffer.
+        if (__atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) != tail) {
+            break;
+        }
+
+        __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+        return false;
+    }
+
+    return true;
+}
+
+static bool ring_wait(struct uring_sink_ring *const ring) {
+    while (sys_io_uring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void
+buffer_write_done(struct uring_sink *const sink, const uint32_t index) {
+    sink->buffer_info[index].in_flight = false;
+    sink->in_flight_count--;
+}
+
+/*
+ * Process every completion in the ring without blocking. Returns false if any
+ * write failed, but every failed buffer is still recycled.
+ */
+
+static bool ring_reap(struct uring_sink *const sink) {
+    struct uring_sink_ring *const ring = &sink->ring;
+
+    uint32_t head = *ring->cq_head;
+    const uint32_t tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+    bool result = true;
+    for (; head != tail; head++) {
+        const struct io_uring_cqe *const cqe =
+            (const struct io_uring_cqe *)ring->cqes + (head & *ring->cq_mask);
+
+        const uint32_t index = (uint32_t)cqe->user_data;
+        struct uring_sink_buffer *const info = &sink->buffer_info[index];
+
+        bool resubmit = false;
+        if (cqe->res < 0) {
+            resubmit = cqe->res == -EINTR || cqe->res == -EAGAIN;
+            result = result && resubmit;
+        } else if (cqe->res != 0) {
+            // Resubmit the rest of the buffer on a short write.
+            info->completed += (uint32_t)cqe->res;
+            resubmit = info->completed < info->length;
+        } else {
+            result = false;
+        }
+
+        if (resubmit && ring_submit_write(sink, index)) {
+            continue;
+        }
+
+        if (resubmit) {
+            result = false;
+        }
+
+        buffer_write_done(sink, index);
+    }
+
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    return result;
+}
+
+#endif /* defined(URING_SINK_HAS_IO_URING) */
+
+static bool
+write_buffer_sync(struct uring_sink *const sink, const uint32_t index) {
+    struct uring_sink_buffer *const info = &sink->buffer_info[index];
+    const char *const buffer = uring_sink_buffer_at(sink, index);
+
+    while (info->completed != info->length) {
+        const ssize_t written =
+            pwrite(sink->fd,
+                   buffer + info->completed,
+                   info->length - info->completed,
+                   (off_t)(info->offset + info->completed));
+
+        if (written <= 0) {
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+
+            return false;
+        }
+
+        info->completed += (uint32_t)written;
+    }
+
+    return true;
+}
+
+/*
+ * Submit the current buffer, and move on to a free buffer, waiting for one to
+ * complete only if every buffer is in flight.
+ */
+
+static bool submit_current_buffer(struct uring_sink *const sink) {
+    if (sink->current_used == 0) {
+        return true;
+    }
+
+    const uint32_t index = sink->current;
+    struct uring_sink_buffer *const info = &sink->buffer_info[index];
+
+    info->offset = sink->file_offset;
+    info->length = sink->current_used;
+    info->completed = 0;
+
+    sink->file_offset += sink->current_used;
+    sink->current_used = 0;
+
+#if defined(URING_SINK_HAS_IO_URING)
+    if (sink->using_uring) {
+        info->in_flight = true;
+        sink->in_flight_count++;
+
+        if (!ring_submit_write(sink, index)) {
+            buffer_write_done(sink, index);
+            return false;
+        }
+
+        // Pick up any completions without blocking, and only wait if every
+        // buffer is still in flight.
+
+        bool result = ring_reap(sink);
+        while (sink->in_flight_count == sink->buffer_count) {
+            if (!ring_wait(&sink->ring)) {
+                return false;
+            }
+
+            result = ring_reap(sink) && result;
+        }
+
+        for (uint32_t i = 0; i != sink->buffer_count; i++) {
+            const uint32_t next = (index + 1 + i) % sink->buffer_count;
+            if (!sink->buffer_info[next].in_flight) {
+                sink->current = next;
+                break;
+            }
+        }
+
+        return result;
+    }
+#endif /* defined(URING_SINK_HAS_IO_URING) */
+
+    return write_buffer_sync(sink, index);
+}
+
+bool
+uring_sink_init(struct uring_sink *const sink,
+                const int fd,
+                char *const buffers,
+                const uint32_t buffer_size,
+                const uint32_t buffer_count,
+                const enum uring_sink_mode mode)
+{
+    memset(sink, 0, sizeof(*sink));
+    if (buffers == NULL
+        || buffer_size == 0
+        || buffer_count == 0
+        || buffer_count > URING_SINK_MAX_BUFFERS)
+    {
+        return false;
+    }
+
+    const off_t offset = lseek(fd, 0, SEEK_CUR);
+    if (offset < 0) {
+        return false;
+    }
+
+    sink->fd = fd;
+    sink->file_offset = (uint64_t)offset;
+    sink->buffers = buffers;
+    sink->buffer_size = buffer_size;
+    sink->buffer_count = buffer_count;
+
+#if defined(URING_SINK_HAS_IO_URING)
+    if (mode == URING_SINK_MODE_AUTO) {
+        sink->using_uring = ring_setup(sink);
+    }
+#else
+    (void)mode;
+#endif /* defined(URING_SINK_HAS_IO_URING) */
+
+    return true;
+}
+
+bool uring_sink_flush(struct uring_sink *const sink) {
+    if (sink->failed) {
+        return false;
+    }
+
+    if (!submit_current_buffer(sink)) {
+        sink->failed = true;
+    }
+
+#if defined(URING_SINK_HAS_IO_URING)
+    if (sink->using_uring) {
+        while (sink->in_flight_count != 0) {
+            if (!ring_wait(&sink->ring)) {
+                sink->failed = true;
+                break;
+            }
+
+            if (!ring_reap(sink)) {
+                sink->failed = true;
+            }
+        }
+    }
+#endif /* defined(URING_SINK_HAS_IO_URING) */
+
+    // Keep the fd's position in sync, as if we had used write().
+    if (!sink->failed) {
+        lseek(sink->fd, (off_t)sink->file_offset, SEEK_SET);
+    }
+
+    return !sink->failed;
+}
+
+bool uring_sink_destroy(struct uring_sink *const sink) {
+    const bool result = uring_sink_flush(sink);
+
+#if defined(URING_SINK_HAS_IO_URING)
+    if (sink->using_uring) {
+        ring_teardown(&sink->ring);
+        sink->using_uring = false;
+    }
+#endif /* defined(URING_SINK_HAS_IO_URING) */
+
+    return result;
+}
+
+uint32_t
+uring_sink_write_ch_callback(struct printf_spec_info *const spec_info,
+                             void *const info,
+                             const char ch,
+                             const uint32_t times,
+                             bool *const should_continue_out)
+{
+    (void)spec_info;
+
+    struct uring_sink *const sink = (struct uring_sink *)info;
+    uint32_t left = times;
+
+    while (left != 0) {
+        if (sink->current_used == sink->buffer_size) {
+            if (!submit_current_buffer(sink)) {
+                sink->failed = true;
+            }
+        }
+
+        if (sink->failed) {
+            *should_continue_out = false;
+            return times - left;
+        }
+
+        const uint32_t room = sink->buffer_size - sink->current_used;
+        const uint32_t amount = left < room ? left : room;
+
+        memset(uring_sink_buffer_at(sink, sink->current) + sink->current_used,
+               ch,
+               amount);
+
+        sink->current_used += amount;
+        left -= amount;
+    }
+
+    return times;
+}
+
+uint32_t
+uring_sink_write_string_callback(struct printf_spec_info *const spec_info,
+                                 void *const info,
+                                 const char *const string,
+                                 const uint32_t length,
+                                 bool *const should_continue_out)
+{
+    (void)spec_info;
+
+    struct uring_sink *const sink = (struct uring_sink *)info;
+    uint32_t done = 0;
+
+    while (done != length) {
+        if (sink->current_used == sink->buffer_size) {
+            if (!submit_current_buffer(sink)) {
+                sink->failed = true;
+            }
+        }
+
+        if (sink->failed) {
+            *should_continue_out = false;
+            return done;
+        }
+
+        const uint32_t room = sink->buffer_size - sink->current_used;
+        const uint32_t left = length - done;
+        const uint32_t amount = left < room ? left : room;
+
+        memcpy(uring_sink_buffer_at(sink, sink->current) + sink->current_used,
+               string + done,
+               amount);
+
+        sink->current_used += amount;
+        done += amount;
+    }
+
+    return length;
+}
+
+uint32_t
+uring_sink_format(struct uring_sink *const sink, const char *const format, ...)
+{
+    va_list list;
+    va_start(list, format);
+
+    const uint32_t result = uring_sink_vformat(sink, format, list);
+
+    va_end(list);
+    return result;
+}
+
+uint32_t
+uring_sink_vformat(struct uring_sink *const sink,
+                   const char *const format,
+                   va_list list)
+{
+    const uint32_t length =
+        parse_printf_format(uring_sink_write_ch_callback,
+                            sink,
+                            uring_sink_write_string_callback,
+                            sink,
+                            format,
+                            list);
+    return length;
+}
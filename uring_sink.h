@@ -0,0 +1,149 @@
+/*
+Copyright (c) 2023 Suhas Pai
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "parse_printf.h"
+
+/*
+ * An asynchronous sink that formats into preallocated buffers, and submits
+ * full buffers to the kernel through io_uring (on Linux), without waiting for
+ * the write to finish.
+ *
+ * At most buffer_count writes are in flight at once. A buffer is recycled
+ * once its write completes, and formatting only blocks when every buffer is
+ * in flight. Buffers are registered with the ring when possible, so writes
+ * skip mapping user memory for every submission.
+ *
+ * When io_uring isn't available (older kernels, seccomp, other platforms),
+ * the sink falls back to writing each full buffer synchronously with pwrite().
+ *
+ * The fd must be a regular file. Writes are issued at explicit offsets
+ * starting at the fd's current position, so out-of-order completions still
+ * land in order.
+ */
+
+#define URING_SINK_MAX_BUFFERS 16
+
+enum uring_sink_mode {
+    URING_SINK_MODE_AUTO,
+    URING_SINK_MODE_SYNC,
+};
+
+struct uring_sink_buffer {
+    uint64_t offset;
+    uint32_t length;
+    uint32_t completed;
+    bool in_flight;
+};
+
+struct uring_sink_ring {
+    int fd;
+    bool registered_buffers;
+
+    void *sq_ring;
+    uint64_t sq_ring_size;
+    void *cq_ring;
+    uint64_t cq_ring_size;
+    void *sqes;
+    uint64_t sqes_size;
+
+    uint32_t *sq_head;
+    uint32_t *sq_tail;
+    uint32_t *sq_mask;
+    uint32_t *sq_array;
+
+    uint32_t *cq_head;
+    uint32_t *cq_tail;
+    uint32_t *cq_mask;
+    void *cqes;
+};
+
+struct uring_sink {
+    int fd;
+    uint64_t file_offset;
+
+    char *buffers;
+    uint32_t buffer_size;
+    uint32_t buffer_count;
+
+    // The buffer being formatted into, and how much of it is used.
+    uint32_t current;
+    uint32_t current_used;
+
+    uint32_t in_flight_count;
+    struct uring_sink_buffer buffer_info[URING_SINK_MAX_BUFFERS];
+
+    bool using_uring;
+    bool failed;
+
+    struct uring_sink_ring ring;
+};
+
+/*
+ * buffers must point to buffer_count * buffer_size bytes, which stay in use
+ * until uring_sink_destroy() is called. Returns false if the arguments are
+ * invalid, or the fd's position can't be found.
+ */
+
+bool
+uring_sink_init(struct uring_sink *sink,
+                int fd,
+                char *buffers,
+                uint32_t buffer_size,
+                uint32_t buffer_count,
+                enum uring_sink_mode mode);
+
+/*
+ * Submit any buffered output, and wait for every in-flight write to complete.
+ * Returns false if any write failed.
+ */
+
+bool uring_sink_flush(struct uring_sink *sink);
+
+// Flush the sink, and tear down the ring. Returns uring_sink_flush()'s result.
+bool uring_sink_destroy(struct uring_sink *sink);
+
+uint32_t
+uring_sink_write_ch_callback(struct printf_spec_info *spec_info,
+                             void *info,
+                             char ch,
+                             uint32_t times,
+                             bool *should_continue_out);
+
+uint32_t
+uring_sink_write_string_callback(struct printf_spec_info *spec_info,
+                                 void *info,
+                                 const char *string,
+                                 uint32_t length,
+                                 bool *should_continue_out);
+
+__attribute__((format(printf, 2, 3)))
+uint32_t uring_sink_format(struct uring_sink *sink, const char *format, ...);
+
+uint32_t
+uring_sink_vformat(struct uring_sink *sink, const char *format, va_list list);